@@ -3,16 +3,39 @@
 void on_run(Editor_State *s)
 {
     const char *src_path = "src/main.c";
-    const char *out_path = "bin/tetris.dylib";
 
+#ifdef __APPLE__
+    const char *out_path = "bin/tetris.dylib";
     const char *cc = "clang";
     const char *cflags = "-I/opt/homebrew/include -Ithird_party -DGL_SILENCE_DEPRECATION -Wall -Werror -Wno-unused-function -Wno-unused-variable";
-    const char *lflags = "-L/opt/homebrew/lib -lglfw -framework OpenGL";
-    char *compile_command = strf("%s -g -dynamiclib %s %s %s -o %s", cc, cflags, lflags, src_path, out_path);
+    const char *lflags = "-dynamiclib -L/opt/homebrew/lib -lglfw -framework OpenGL";
+#else
+    const char *out_path = "bin/tetris.so";
+    const char *cc = "cc";
+    const char *cflags = "-std=gnu11 -fPIC -Ithird_party -Wall -Werror -Wno-unused-function -Wno-unused-variable";
+    const char *lflags = "-shared -lglfw -lGL -lm -lpthread";
+#endif
+    char *compile_command = strf("%s -g %s %s -o %s %s", cc, cflags, src_path, out_path, lflags);
 
     printf("\nCompilation:\n%s\n\n", compile_command);
     int result = system(compile_command);
     printf("\nCompilation finished. Status: %d\n\n", result);
 
     free(compile_command);
+
+    // Headless tools: no GL, no GLFW. See the Makefile for optimized, LTO and PGO builds.
+    const char *tool_cflags = "-std=gnu11 -O2 -Wall -Werror -Wno-unused-function -Wno-unused-variable";
+    // Libraries go after the source: GNU ld drops any that nothing before them needs.
+    const char *tool_libs = "-lm -lpthread";
+    const char *tools[] = {"tuner", "datagen", "bench", "match_runner", "server", "difftest", "perft", "solver"};
+    for (int i = 0; i < (int)(sizeof(tools) / sizeof(tools[0])); i++)
+    {
+        char *tool_command = strf("%s %s src/%s.c -o bin/%s %s", cc, tool_cflags, tools[i], tools[i], tool_libs);
+
+        printf("\nCompilation:\n%s\n\n", tool_command);
+        result = system(tool_command);
+        printf("\nCompilation finished. Status: %d\n\n", result);
+
+        free(tool_command);
+    }
 }
@@ -0,0 +1,428 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ai.h"
+#include "nn.h"
+#include "tetris.h"
+#include "pieces.h"
+#include "trace.h"
+
+static void ai_piece_row_masks(Piece_Kind kind, Piece_Orient orient, uint16_t out[PIECE_MAX_ROWS])
+{
+    const Piece_Spec *spec = piece_spec_get_by_kind(kind);
+    for (int row = 0; row < PIECE_MAX_ROWS; row++) out[row] = (uint16_t)piece_spec_get_row(spec, orient, row);
+}
+
+// Same test as piece_fits, for a piece whose rows are already extracted.
+static bool ai_fits(const uint16_t *board, int cols, int rows, const uint16_t piece[PIECE_MAX_ROWS], int x, int y)
+{
+    for (int row = 0; row < PIECE_MAX_ROWS; row++)
+    {
+        if (!piece[row]) continue;
+        int board_row = y + row;
+        if (board_row < 0 || board_row >= rows) return false;
+        uint16_t shifted;
+        if (!piece_shift_row(piece[row], x, cols, &shifted)) return false;
+        if (board[board_row] & shifted) return false;
+    }
+    return true;
+}
+
+void ai_snapshot_from_state(Game_State *s, Ai_Snapshot *snap)
+{
+    snap->cols = s->tetris_cols;
+    snap->rows = s->tetris_rows;
+    memcpy(snap->row_masks, s->row_masks, sizeof(snap->row_masks[0]) * s->tetris_rows);
+    snap->piece = s->current_piece;
+}
+
+// Board is modified in place: the piece is stamped and full lines removed.
+static void ai_placement_features(uint16_t *board, int cols, int rows, const uint16_t piece[PIECE_MAX_ROWS], int x, int y, float features[AI_FEATURE_COUNT])
+{
+    const uint16_t full = (uint16_t)((1u << cols) - 1);
+
+    int piece_top = -1, piece_bottom = -1;
+    for (int row = 0; row < PIECE_MAX_ROWS; row++)
+    {
+        if (!piece[row]) continue;
+        uint16_t shifted = 0;
+        piece_shift_row(piece[row], x, cols, &shifted);
+        board[y + row] |= shifted;
+        if (piece_top < 0) piece_top = row;
+        piece_bottom = row;
+    }
+
+    int lines = 0;
+    int eroded_piece_cells = 0;
+    int dst = rows - 1;
+    for (int src = rows - 1; src >= 0; src--)
+    {
+        if (board[src] == full)
+        {
+            lines++;
+            int piece_row = src - y;
+            if (piece_row >= 0 && piece_row < PIECE_MAX_ROWS && piece[piece_row])
+            {
+                eroded_piece_cells += __builtin_popcount(piece[piece_row]);
+            }
+            continue;
+        }
+        board[dst--] = board[src];
+    }
+    while (dst >= 0) board[dst--] = 0;
+
+    float landing_height = (float)rows - (float)y - (float)(piece_top + piece_bottom) * 0.5f;
+
+    int row_transitions = 0;
+    for (int row = 0; row < rows; row++)
+    {
+        // Walls count as filled on both sides.
+        uint32_t r = ((uint32_t)board[row] << 1) | 1u | (1u << (cols + 1));
+        row_transitions += __builtin_popcount((r ^ (r >> 1)) & ((1u << (cols + 1)) - 1));
+    }
+
+    // The floor counts as filled, the space above the board doesn't.
+    int col_transitions = 0;
+    int holes = 0;
+    uint16_t covered = 0;
+    for (int row = 0; row < rows; row++)
+    {
+        uint16_t below = (row + 1 < rows) ? board[row + 1] : full;
+        col_transitions += __builtin_popcount((board[row] ^ below) & full);
+        // A hole is an empty cell with something filled anywhere above it.
+        holes += __builtin_popcount(covered & ~board[row] & full);
+        covered |= board[row];
+    }
+
+    int wells = 0;
+    for (int col = 0; col < cols; col++)
+    {
+        int depth = 0;
+        for (int row = 0; row < rows; row++)
+        {
+            bool filled = board[row] & (1u << col);
+            bool left = col == 0 || (board[row] & (1u << (col - 1)));
+            bool right = col == cols - 1 || (board[row] & (1u << (col + 1)));
+            if (!filled && left && right)
+            {
+                depth++;
+                wells += depth;
+            }
+            else
+            {
+                depth = 0;
+            }
+        }
+    }
+
+    features[AI_FEATURE_LANDING_HEIGHT]  = landing_height;
+    features[AI_FEATURE_ERODED_CELLS]    = (float)(lines * eroded_piece_cells);
+    features[AI_FEATURE_ROW_TRANSITIONS] = (float)row_transitions;
+    features[AI_FEATURE_COL_TRANSITIONS] = (float)col_transitions;
+    features[AI_FEATURE_HOLES]           = (float)holes;
+    features[AI_FEATURE_WELLS]           = (float)wells;
+}
+
+static float ai_evaluate_placement(uint16_t *board, int cols, int rows, const uint16_t piece[PIECE_MAX_ROWS], int x, int y, const Ai_Weights *weights)
+{
+    float features[AI_FEATURE_COUNT];
+    ai_placement_features(board, cols, rows, piece, x, y, features);
+
+    float score = 0.0f;
+    for (int i = 0; i < AI_FEATURE_COUNT; i++) score += features[i] * weights->w[i];
+    return score;
+}
+
+/*
+ * Enumerates placements the way the main thread will execute them:
+ * rotate in place, slide one column at a time, then drop.
+ * Returns how many were written to `out`.
+ */
+int ai_enumerate_placements(const Ai_Snapshot *snap, Ai_Candidate out[AI_MAX_CANDIDATES])
+{
+    int count = 0;
+    Piece p = snap->piece;
+
+    // Each orientation is reached the way ai_play_placement will: clockwise turns, kicks included.
+    for (int r = 0; r < PIECE_ORIENT_COUNT; r++)
+    {
+        if (r == 0)
+        {
+            if (!piece_fits(snap->row_masks, snap->cols, snap->rows, p.kind, p.orient, p.x, p.y)) break;
+        }
+        else if (!piece_try_rotate(snap->row_masks, snap->cols, snap->rows, &p, PIECE_ROTATE_CW, &p))
+        {
+            break;
+        }
+
+        uint16_t piece[PIECE_MAX_ROWS];
+        ai_piece_row_masks(p.kind, p.orient, piece);
+
+        for (int dir = -1; dir <= 1; dir += 2)
+        {
+            int x = (dir < 0) ? p.x : p.x + 1;
+            while (ai_fits(snap->row_masks, snap->cols, snap->rows, piece, x, p.y))
+            {
+                int y = p.y;
+                while (ai_fits(snap->row_masks, snap->cols, snap->rows, piece, x, y + 1)) y++;
+                out[count++] = (Ai_Candidate){.x = x, .y = y, .orient = p.orient};
+                x += dir;
+            }
+        }
+    }
+
+    return count;
+}
+
+bool ai_find_best_placement(const Ai_Snapshot *snap, const Ai_Weights *weights, Ai_Placement *out)
+{
+    Ai_Candidate candidates[AI_MAX_CANDIDATES];
+    int count = ai_enumerate_placements(snap, candidates);
+
+    for (int i = 0; i < count; i++)
+    {
+        const Ai_Candidate *c = &candidates[i];
+        uint16_t piece[PIECE_MAX_ROWS];
+        ai_piece_row_masks(snap->piece.kind, c->orient, piece);
+
+        uint16_t board[AI_MAX_ROWS];
+        memcpy(board, snap->row_masks, sizeof(board[0]) * snap->rows);
+        float score = ai_evaluate_placement(board, snap->cols, snap->rows, piece, c->x, c->y, weights);
+        if (i == 0 || score > out->score)
+        {
+            out->x = c->x;
+            out->orient = c->orient;
+            out->score = score;
+        }
+    }
+
+    return count > 0;
+}
+
+/*
+ * Adds the board left by placing the snapshot's piece at `c` and returns
+ * its index in the batch, or -1 if the batch is full.
+ */
+int ai_nn_batch_add(Nn_Batch *b, const Ai_Snapshot *snap, const Ai_Candidate *c)
+{
+    if (b->count >= b->capacity) return -1;
+    int index = b->count++;
+
+    uint16_t piece[PIECE_MAX_ROWS];
+    ai_piece_row_masks(snap->piece.kind, c->orient, piece);
+    uint16_t board[AI_MAX_ROWS];
+    memcpy(board, snap->row_masks, sizeof(board[0]) * snap->rows);
+
+    float features[AI_FEATURE_COUNT];
+    ai_placement_features(board, snap->cols, snap->rows, piece, c->x, c->y, features);
+    for (int f = 0; f < AI_FEATURE_COUNT; f++) *nn_batch_input(b, NN_INPUT_FEATURES + f, index) = features[f];
+
+    // Heights and holes per column, top down: a column's height is set by its first filled cell.
+    int heights[AI_MAX_COLS] = {0}, holes[AI_MAX_COLS] = {0};
+    uint16_t covered = 0;
+    for (int row = 0; row < snap->rows; row++)
+    {
+        for (unsigned int top = board[row] & ~covered; top; top &= top - 1) heights[__builtin_ctz(top)] = snap->rows - row;
+        for (unsigned int gap = covered & ~board[row]; gap; gap &= gap - 1) holes[__builtin_ctz(gap)]++;
+        covered |= board[row];
+    }
+    for (int col = 0; col < AI_MAX_COLS; col++)
+    {
+        *nn_batch_input(b, NN_INPUT_HEIGHTS + col, index) = (float)heights[col];
+        *nn_batch_input(b, NN_INPUT_HOLES + col, index) = (float)holes[col];
+    }
+    return index;
+}
+
+// ai_find_best_placement with the network scoring all of the piece's placements in one batch.
+bool ai_find_best_placement_nn(const Nn_Model *m, Nn_Batch *b, const Ai_Snapshot *snap, Ai_Placement *out)
+{
+    Ai_Candidate candidates[AI_MAX_CANDIDATES];
+    int count = ai_enumerate_placements(snap, candidates);
+
+    b->count = 0;
+    for (int i = 0; i < count; i++) ai_nn_batch_add(b, snap, &candidates[i]);
+    const float *scores = nn_forward(m, b);
+
+    for (int i = 0; i < b->count; i++)
+    {
+        if (i == 0 || scores[i] > out->score)
+        {
+            out->x = candidates[i].x;
+            out->orient = candidates[i].orient;
+            out->score = scores[i];
+        }
+    }
+    return b->count > 0;
+}
+
+// --------------------------------------------------------------------
+
+static void *ai_worker_main(void *arg)
+{
+    Ai_Worker *ai = arg;
+    trace_thread_name("ai");
+    while (atomic_load_explicit(&ai->running, memory_order_relaxed))
+    {
+        if (!ai_mailbox_acquire(&ai->to_worker.middle, &ai->to_worker.front))
+        {
+            nanosleep(&(struct timespec){.tv_nsec = 500 * 1000}, NULL);
+            continue;
+        }
+
+        const Ai_Snapshot *snap = &ai->to_worker.slots[ai->to_worker.front];
+        Ai_Move *move = &ai->to_main.slots[ai->to_main.back];
+        move->serial = snap->serial;
+        move->piece_id = snap->piece.id;
+        trace_begin("ai_search");
+        move->valid = ai->nn ? ai_find_best_placement_nn(ai->nn, ai->nn_batch, snap, &move->placement)
+                             : ai_find_best_placement(snap, &ai->weights, &move->placement);
+        trace_end("ai_search");
+        ai_mailbox_publish(&ai->to_main.middle, &ai->to_main.back);
+    }
+    return NULL;
+}
+
+static void ai_worker_free_batch(Ai_Worker *ai)
+{
+    if (!ai->nn_batch) return;
+    nn_batch_free(ai->nn_batch);
+    mem_free(ai->nn_batch);
+}
+
+Ai_Worker *ai_worker_start(Ai_Weights weights, const Nn_Model *nn)
+{
+    Ai_Worker *ai = mem_calloc(1, sizeof(*ai));
+    ai->weights = weights;
+    if (nn)
+    {
+        ai->nn_batch = mem_calloc(1, sizeof(*ai->nn_batch));
+        if (nn_batch_init(ai->nn_batch, AI_MAX_CANDIDATES)) ai->nn = nn;
+    }
+    ai->posted_piece_id = -1;
+    ai->issued_input = -1;
+    ai_mailbox_init(&ai->to_worker.middle, &ai->to_worker.back, &ai->to_worker.front);
+    ai_mailbox_init(&ai->to_main.middle, &ai->to_main.back, &ai->to_main.front);
+    atomic_store(&ai->running, true);
+    if (pthread_create(&ai->thread, NULL, ai_worker_main, ai) != 0)
+    {
+        ai_worker_free_batch(ai);
+        mem_free(ai);
+        return NULL;
+    }
+    return ai;
+}
+
+void ai_worker_stop(Ai_Worker *ai)
+{
+    atomic_store(&ai->running, false);
+    pthread_join(ai->thread, NULL);
+    ai_worker_free_batch(ai);
+    mem_free(ai);
+}
+
+static void ai_post_snapshot(Ai_Worker *ai, Game_State *s)
+{
+    Ai_Snapshot *snap = &ai->to_worker.slots[ai->to_worker.back];
+    ai_snapshot_from_state(s, snap);
+    snap->serial = ai->next_serial++;
+    ai_mailbox_publish(&ai->to_worker.middle, &ai->to_worker.back);
+    ai->posted_piece_id = s->current_piece.id;
+    ai->plan.valid = false;
+}
+
+/*
+ * Called once per frame on the main thread. Queues at most one step of the
+ * current plan as simulation input, the same way the keyboard does.
+ */
+void ai_drive(Ai_Worker *ai, Game_State *s)
+{
+    if (s->is_game_over) return;
+
+    if (ai->posted_piece_id != s->current_piece.id) ai_post_snapshot(ai, s);
+
+    if (ai_mailbox_acquire(&ai->to_main.middle, &ai->to_main.front))
+    {
+        const Ai_Move *move = &ai->to_main.slots[ai->to_main.front];
+        if (move->piece_id == s->current_piece.id && move->serial == ai->next_serial - 1)
+        {
+            ai->plan = *move;
+        }
+    }
+
+    // The previous input hasn't reached the simulation yet.
+    if (!ai->plan.valid || sim_has_pending_input(&s->sim)) return;
+
+    const Piece *p = &s->current_piece;
+    const Ai_Placement *target = &ai->plan.placement;
+    Sim_Input input;
+    if (p->orient != target->orient)  input = SIM_INPUT_ROTATE_CW;
+    else if (p->x < target->x)        input = SIM_INPUT_RIGHT;
+    else if (p->x > target->x)        input = SIM_INPUT_LEFT;
+    else                              input = SIM_INPUT_HARD_DROP;
+
+    // Same input for the same piece in the same place: it was blocked last time.
+    // Gravity moved the piece into something the plan didn't account for, so think again.
+    if (ai->issued_input == (int)input && ai->issued_for.id == p->id &&
+        ai->issued_for.x == p->x && ai->issued_for.orient == p->orient)
+    {
+        ai->issued_input = -1;
+        ai_post_snapshot(ai, s);
+        return;
+    }
+
+    // Tapped, not held, so one tick gives exactly one step and DAS never kicks in.
+    sim_queue_input(&s->sim, input, true);
+    sim_queue_input(&s->sim, input, false);
+    ai->issued_input = (int)input;
+    ai->issued_for = *p;
+}
+
+// --------------------------------------------------------------------
+
+/*
+ * Headless counterpart of ai_drive: executes a whole placement at once
+ * through the same entry points and locks the piece. Returns lines cleared.
+ */
+int ai_play_placement(Game_State *s, const Ai_Placement *placement)
+{
+    for (int i = 0; i < PIECE_ORIENT_COUNT && s->current_piece.orient != placement->orient; i++)
+    {
+        if (!rotate_current_piece(s, PIECE_ROTATE_CW)) break;
+    }
+    while (s->current_piece.x != placement->x)
+    {
+        if (!slide_current_piece(s, (placement->x > s->current_piece.x) ? +1 : -1)) break;
+    }
+    while (move_current_piece_down(s)) {}
+    return lock_current_piece(s);
+}
+
+// Picks and plays one placement. Returns lines cleared, or -1 if there was nowhere to go.
+int ai_play_step(Game_State *s, const Ai_Weights *weights)
+{
+    Ai_Snapshot snap;
+    Ai_Placement placement;
+    ai_snapshot_from_state(s, &snap);
+    if (!ai_find_best_placement(&snap, weights, &placement))
+    {
+        s->is_game_over = true;
+        return -1;
+    }
+    return ai_play_placement(s, &placement);
+}
+
+// ai_play_step with the network. The batch needs room for AI_MAX_CANDIDATES boards.
+int ai_play_step_nn(Game_State *s, const Nn_Model *m, Nn_Batch *b)
+{
+    Ai_Snapshot snap;
+    Ai_Placement placement;
+    ai_snapshot_from_state(s, &snap);
+    if (!ai_find_best_placement_nn(m, b, &snap, &placement))
+    {
+        s->is_game_over = true;
+        return -1;
+    }
+    return ai_play_placement(s, &placement);
+}
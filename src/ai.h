@@ -0,0 +1,147 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "pieces.h"
+
+#define AI_MAX_ROWS 32
+#define AI_MAX_COLS 16
+
+/*
+ * Board features the heuristic evaluator looks at (Dellacherie's set).
+ * Weights are stored as a flat vector so they can be tuned offline.
+ */
+typedef enum {
+    AI_FEATURE_LANDING_HEIGHT,
+    AI_FEATURE_ERODED_CELLS,
+    AI_FEATURE_ROW_TRANSITIONS,
+    AI_FEATURE_COL_TRANSITIONS,
+    AI_FEATURE_HOLES,
+    AI_FEATURE_WELLS,
+    AI_FEATURE_COUNT
+} Ai_Feature;
+
+typedef struct {
+    float w[AI_FEATURE_COUNT];
+} Ai_Weights;
+
+/*
+ * Immutable copy of what the bot needs to see.
+ * rows[0] is the top row, bit N of a row is column N.
+ */
+typedef struct {
+    uint32_t serial;
+    int cols, rows;
+    uint16_t row_masks[AI_MAX_ROWS];
+    Piece piece;
+} Ai_Snapshot;
+
+typedef struct {
+    int x;
+    Piece_Orient orient;
+    float score;
+} Ai_Placement;
+
+// Where a piece can end up: column, orientation and the row it lands on.
+typedef struct {
+    int x, y;
+    Piece_Orient orient;
+} Ai_Candidate;
+
+#define AI_MAX_CANDIDATES (PIECE_ORIENT_COUNT * AI_MAX_COLS)
+
+typedef struct {
+    uint32_t serial;
+    int piece_id;
+    bool valid;
+    Ai_Placement placement;
+} Ai_Move;
+
+/*
+ * Single producer / single consumer triple buffer.
+ * The producer owns `back`, the consumer owns `front`, and the two swap
+ * through `middle`. AI_SLOT_FRESH is set on `middle` when it holds
+ * something the consumer hasn't seen yet.
+ */
+#define AI_SLOT_FRESH 0x4u
+#define AI_SLOT_INDEX 0x3u
+
+typedef struct {
+    Ai_Snapshot slots[3];
+    _Atomic unsigned int middle;
+    int back, front;
+} Ai_Snapshot_Mailbox;
+
+typedef struct {
+    Ai_Move slots[3];
+    _Atomic unsigned int middle;
+    int back, front;
+} Ai_Move_Mailbox;
+
+// See nn.h.
+struct Nn_Model;
+struct Nn_Batch;
+
+typedef struct {
+    // Everything ai_worker_stop touches comes first and stays put, so a build
+    // can stop a worker that another build started (see on_reload).
+    pthread_t thread;
+    _Atomic bool running;
+    struct Nn_Batch *nn_batch;
+
+    Ai_Weights weights;
+    // When set, placements are scored by the network instead of the weights. Not owned.
+    const struct Nn_Model *nn;
+
+    Ai_Snapshot_Mailbox to_worker;
+    Ai_Move_Mailbox to_main;
+
+    // Main thread only.
+    uint32_t next_serial;
+    int posted_piece_id;
+    Ai_Move plan;
+
+    // Last input sent to the simulation and the piece it was sent for.
+    int issued_input;
+    Piece issued_for;
+} Ai_Worker;
+
+static inline void ai_mailbox_init(_Atomic unsigned int *middle, int *back, int *front)
+{
+    *back = 0;
+    atomic_store_explicit(middle, 1, memory_order_relaxed);
+    *front = 2;
+}
+
+// Producer: hand the back slot over and get a new one to write into.
+static inline void ai_mailbox_publish(_Atomic unsigned int *middle, int *back)
+{
+    unsigned int prev = atomic_exchange_explicit(middle, (unsigned int)*back | AI_SLOT_FRESH, memory_order_acq_rel);
+    *back = (int)(prev & AI_SLOT_INDEX);
+}
+
+// Consumer: returns true and swaps in the newest slot if one was published.
+static inline bool ai_mailbox_acquire(_Atomic unsigned int *middle, int *front)
+{
+    if (!(atomic_load_explicit(middle, memory_order_relaxed) & AI_SLOT_FRESH)) return false;
+    unsigned int prev = atomic_exchange_explicit(middle, (unsigned int)*front, memory_order_acq_rel);
+    *front = (int)(prev & AI_SLOT_INDEX);
+    return true;
+}
+
+static inline Ai_Weights ai_default_weights()
+{
+    // El-Tetris weights for the Dellacherie feature set.
+    Ai_Weights w = {{
+        [AI_FEATURE_LANDING_HEIGHT]  = -4.500158825f,
+        [AI_FEATURE_ERODED_CELLS]    =  3.418126810f,
+        [AI_FEATURE_ROW_TRANSITIONS] = -3.217888287f,
+        [AI_FEATURE_COL_TRANSITIONS] = -9.348695305f,
+        [AI_FEATURE_HOLES]           = -7.899265427f,
+        [AI_FEATURE_WELLS]           = -3.385597225f,
+    }};
+    return w;
+}
@@ -0,0 +1,499 @@
+/*
+ * Batch simulator: plays bot games on the headless core as fast as it can.
+ * Doubles as the training run for profile-guided builds (make pgo).
+ *
+ *   bin/bench [--games N] [--max-pieces N] [--threads N] [--seed N] [--trace FILE]
+ *   bin/bench --lockstep [--games N] [--seed N]
+ *   bin/bench --nn weights.mlp [--games N] [--max-pieces N] [--threads N] [--seed N]
+ *   bin/bench --write-nn weights.mlp
+ *   bin/bench --particles [--seed N]
+ *
+ * --lockstep times random-placement rollouts, the Monte Carlo workload, on
+ * one core: a Game_State per game against the lockstep engine.
+ *
+ * --nn plays the games with a network (see nn.h) instead of the heuristic,
+ * after timing full batches of boards through it with each kernel.
+ * --write-nn saves a network that scores exactly like the default weights.
+ *
+ * --particles fills the particle pool (particles.h), checks that the
+ * vector update moves it just like the scalar one, then times both.
+ *
+ * --trace run.json records the games as a Chrome trace (see trace.h).
+ */
+
+#define TETRIS_HEADLESS
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tetris.h"
+#include "ai.h"
+#include "particles.h"
+
+#include "tetris_core.c"
+#include "nn.c"
+#include "ai.c"
+#include "lockstep.c"
+#include "trace.c"
+
+typedef struct {
+    int games;
+    int max_pieces;
+    int threads;
+    uint64_t base_seed;
+    Ai_Weights weights;
+    const Nn_Model *nn;
+
+    _Atomic int next_game;
+    _Atomic long pieces;
+    _Atomic long lines;
+    _Atomic int topped_out;
+    _Atomic unsigned long long score;
+    _Atomic long tetrises;
+    _Atomic int max_level;
+    _Atomic int max_height;
+} Bench_Job;
+
+static double bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void bench_atomic_max(_Atomic int *dst, int v)
+{
+    int cur = atomic_load_explicit(dst, memory_order_relaxed);
+    while (v > cur && !atomic_compare_exchange_weak_explicit(dst, &cur, v, memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+static void *bench_worker(void *arg)
+{
+    Bench_Job *job = arg;
+    Game_State s = {0};
+    long alloc_mark = -1;
+    Nn_Batch batch = {0};
+    if (job->nn && !nn_batch_init(&batch, AI_MAX_CANDIDATES)) return NULL;
+    trace_thread_name("bench");
+
+    for (;;)
+    {
+        int game = atomic_fetch_add_explicit(&job->next_game, 1, memory_order_relaxed);
+        if (game >= job->games) break;
+
+        uint64_t seed_rng = job->base_seed + (uint64_t)game;
+        s.tetris_cols = TETRIS_COLS;
+        s.tetris_rows = TETRIS_ROWS;
+        initialize_game_with_seed(&s, rng_next(&seed_rng));
+
+        trace_begin("game");
+        while (!s.is_game_over && s.stats.pieces < job->max_pieces)
+        {
+            int lines = job->nn ? ai_play_step_nn(&s, job->nn, &batch) : ai_play_step(&s, &job->weights);
+            if (lines < 0) break;
+        }
+        trace_end("game");
+
+        // Everything reported comes straight from the game's own counters.
+        const Game_Stats *st = &s.stats;
+        atomic_fetch_add_explicit(&job->pieces, st->pieces, memory_order_relaxed);
+        atomic_fetch_add_explicit(&job->lines, st->lines, memory_order_relaxed);
+        if (s.is_game_over) atomic_fetch_add_explicit(&job->topped_out, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&job->score, st->score, memory_order_relaxed);
+        atomic_fetch_add_explicit(&job->tetrises, st->clears[3], memory_order_relaxed);
+        bench_atomic_max(&job->max_level, st->level);
+        bench_atomic_max(&job->max_height, st->max_height);
+
+        // The first game sets up the arena; every later one reuses it.
+        if (alloc_mark < 0) alloc_mark = mem_alloc_count();
+        MEM_ASSERT_NO_ALLOCS_SINCE(alloc_mark);
+    }
+
+    free_game(&s);
+    nn_batch_free(&batch);
+    return NULL;
+}
+
+// --------------------------------------------------------------------
+
+#define BENCH_ROLLOUT_STEPS 20000
+
+typedef struct {
+    long games, pieces, lines;
+    double elapsed;
+} Bench_Rollouts;
+
+static void bench_rollout_seeds(uint64_t base_seed, long index, uint64_t *game_seed, uint64_t *policy_seed)
+{
+    uint64_t seed_rng = base_seed + (uint64_t)index;
+    *game_seed = rng_next(&seed_rng);
+    *policy_seed = rng_next(&seed_rng);
+}
+
+static void bench_rollout_place(Game_State *s, uint64_t *policy_rng)
+{
+    Piece placed;
+    lockstep_pick_pose(policy_rng, s->tetris_cols, &s->current_piece, &placed);
+    set_current_piece(s, placed);
+}
+
+static void bench_rollout_start(Game_State *s, uint64_t *policy_rng, uint64_t base_seed, long index)
+{
+    uint64_t game_seed;
+    bench_rollout_seeds(base_seed, index, &game_seed, policy_rng);
+    initialize_game_with_seed(s, game_seed);
+    bench_rollout_place(s, policy_rng);
+}
+
+// Games that top out are replaced from the next seed, so both runs play the same sequence of games.
+static Bench_Rollouts bench_rollouts_scalar(int games, uint64_t base_seed)
+{
+    Bench_Rollouts r = {0};
+    Game_State *states = calloc((size_t)games, sizeof(states[0]));
+    uint64_t *policy_rng = calloc((size_t)games, sizeof(policy_rng[0]));
+
+    double start = bench_now();
+    for (int g = 0; g < games; g++)
+    {
+        states[g].tetris_cols = TETRIS_COLS;
+        states[g].tetris_rows = TETRIS_ROWS;
+        bench_rollout_start(&states[g], &policy_rng[g], base_seed, r.games++);
+    }
+    for (int step = 0; step < BENCH_ROLLOUT_STEPS; step++)
+    {
+        for (int g = 0; g < games; g++)
+        {
+            Game_State *s = &states[g];
+            if (move_current_piece_down(s)) continue;
+            lock_current_piece(s);
+            if (!s->is_game_over)
+            {
+                bench_rollout_place(s, &policy_rng[g]);
+                continue;
+            }
+            r.pieces += s->stats.pieces;
+            r.lines += s->stats.lines;
+            bench_rollout_start(s, &policy_rng[g], base_seed, r.games++);
+        }
+    }
+    r.elapsed = bench_now() - start;
+
+    for (int g = 0; g < games; g++)
+    {
+        r.pieces += states[g].stats.pieces;
+        r.lines += states[g].stats.lines;
+        free_game(&states[g]);
+    }
+    free(states);
+    free(policy_rng);
+    return r;
+}
+
+static Bench_Rollouts bench_rollouts_lockstep(int games, uint64_t base_seed)
+{
+    Bench_Rollouts r = {0};
+    Lockstep_Engine L;
+    if (!lockstep_init(&L, games, TETRIS_COLS, TETRIS_ROWS)) return r;
+
+    double start = bench_now();
+    for (int g = 0; g < games; g++)
+    {
+        uint64_t game_seed, policy_seed;
+        bench_rollout_seeds(base_seed, r.games++, &game_seed, &policy_seed);
+        lockstep_start(&L, g, game_seed, policy_seed);
+    }
+    for (int step = 0; step < BENCH_ROLLOUT_STEPS; step++)
+    {
+        lockstep_step(&L);
+        for (int g = 0; g < games; g++)
+        {
+            if (L.playing[g]) continue;
+            r.pieces += L.pieces[g];
+            r.lines += L.lines[g];
+            uint64_t game_seed, policy_seed;
+            bench_rollout_seeds(base_seed, r.games++, &game_seed, &policy_seed);
+            lockstep_start(&L, g, game_seed, policy_seed);
+        }
+    }
+    r.elapsed = bench_now() - start;
+
+    for (int g = 0; g < games; g++)
+    {
+        r.pieces += L.pieces[g];
+        r.lines += L.lines[g];
+    }
+    lockstep_free(&L);
+    return r;
+}
+
+static void bench_rollouts(int games, uint64_t base_seed)
+{
+    double game_steps = (double)games * BENCH_ROLLOUT_STEPS;
+    Bench_Rollouts scalar = bench_rollouts_scalar(games, base_seed);
+    Bench_Rollouts lockstep = bench_rollouts_lockstep(games, base_seed);
+
+    printf("%d games side by side, %d steps each, on one core\n", games, BENCH_ROLLOUT_STEPS);
+    printf("Game_State: %ld games, %ld pieces, %ld lines in %.2fs: %.0f game-steps/s\n",
+        scalar.games, scalar.pieces, scalar.lines, scalar.elapsed, game_steps / scalar.elapsed);
+    printf("lockstep:   %ld games, %ld pieces, %ld lines in %.2fs: %.0f game-steps/s (%d lanes), %.1fx\n",
+        lockstep.games, lockstep.pieces, lockstep.lines, lockstep.elapsed, game_steps / lockstep.elapsed,
+        LOCKSTEP_LANES, scalar.elapsed / lockstep.elapsed);
+}
+
+// --------------------------------------------------------------------
+
+#define BENCH_NN_BATCHES 2000
+
+// Fills a batch with every placement along a heuristic game, restarting it whenever it tops out.
+static void bench_nn_fill(Nn_Batch *b, uint64_t seed)
+{
+    Game_State s = {.tetris_cols = TETRIS_COLS, .tetris_rows = TETRIS_ROWS};
+    Ai_Weights weights = ai_default_weights();
+    initialize_game_with_seed(&s, seed);
+
+    b->count = 0;
+    while (b->count < b->capacity)
+    {
+        Ai_Snapshot snap;
+        Ai_Candidate candidates[AI_MAX_CANDIDATES];
+        ai_snapshot_from_state(&s, &snap);
+        int count = ai_enumerate_placements(&snap, candidates);
+        for (int i = 0; i < count && b->count < b->capacity; i++) ai_nn_batch_add(b, &snap, &candidates[i]);
+        if (ai_play_step(&s, &weights) < 0) initialize_game_with_seed(&s, ++seed);
+    }
+    free_game(&s);
+}
+
+static double bench_nn_time(const Nn_Model *m, Nn_Batch *b, Nn_Layer_Fn *layer)
+{
+    double start = bench_now();
+    for (int i = 0; i < BENCH_NN_BATCHES; i++) nn_forward_with(m, b, layer);
+    return (bench_now() - start) / BENCH_NN_BATCHES;
+}
+
+static void bench_nn_batches(const Nn_Model *m, uint64_t seed)
+{
+    Nn_Batch b;
+    if (!nn_batch_init(&b, NN_BATCH_MAX)) return;
+    bench_nn_fill(&b, seed);
+
+    printf("network");
+    for (int l = 0; l <= m->layer_count; l++) printf("%s%d", l ? "-" : " ", m->sizes[l]);
+    printf(", batches of %d boards:\n", b.count);
+
+    // The kernels must agree up to rounding: FMA rounds once where the scalar loop rounds twice.
+    float scalar[NN_BATCH_MAX];
+    memcpy(scalar, nn_forward_with(m, &b, nn_layer_scalar), sizeof(scalar[0]) * (size_t)b.count);
+    const float *best = nn_forward(m, &b);
+    float max_diff = 0.0f;
+    for (int i = 0; i < b.count; i++)
+    {
+        float d = fabsf(best[i] - scalar[i]) / fmaxf(1.0f, fabsf(scalar[i]));
+        if (d > max_diff) max_diff = d;
+    }
+
+    double scalar_time = bench_nn_time(m, &b, nn_layer_scalar);
+    printf("  %-9s %8.1f us per batch, %.0f boards/s\n", "scalar", scalar_time * 1e6, b.count / scalar_time);
+    if (nn_layer_best() != nn_layer_scalar)
+    {
+        double best_time = bench_nn_time(m, &b, nn_layer_best());
+        printf("  %-9s %8.1f us per batch, %.0f boards/s, %.1fx, max relative difference %g\n",
+            nn_layer_name(nn_layer_best()), best_time * 1e6, b.count / best_time, scalar_time / best_time, max_diff);
+    }
+    nn_batch_free(&b);
+}
+
+// --------------------------------------------------------------------
+
+// Updates per timed run: short enough that no particle in a full pool fades before the last one.
+#define BENCH_PARTICLE_STEPS 30
+#define BENCH_PARTICLE_RUNS 40
+#define BENCH_PARTICLE_DT (1.0f / 60.0f)
+
+static void bench_particles_copy(Particle_Pool *dst, const Particle_Pool *src)
+{
+    dst->count = src->count;
+    dst->rng = src->rng;
+    float *const dst_fields[PARTICLE_FIELDS] = {dst->x, dst->y, dst->vx, dst->vy, dst->r, dst->g, dst->b, dst->life, dst->fade};
+    const float *const src_fields[PARTICLE_FIELDS] = {src->x, src->y, src->vx, src->vy, src->r, src->g, src->b, src->life, src->fade};
+    for (int i = 0; i < PARTICLE_FIELDS; i++) memcpy(dst_fields[i], src_fields[i], sizeof(float) * (size_t)src->count);
+}
+
+// Line-clear bursts from random cells until the pool is full.
+static void bench_particles_fill(Particle_Pool *p, uint64_t seed)
+{
+    p->rng = seed;
+    while (p->count < PARTICLE_MAX)
+    {
+        int col = (int)(rng_next(&p->rng) % TETRIS_COLS);
+        int row = (int)(rng_next(&p->rng) % TETRIS_ROWS);
+        Col_3f color = piece_colors_get_by_kind((Piece_Kind)(rng_next(&p->rng) % PIECE_KIND_COUNT))->normal.inner;
+        particles_emit_cell(p, col, row, color, PARTICLE_CLEAR_COUNT, PARTICLE_CLEAR_SPEED, PARTICLE_CLEAR_LIFETIME);
+    }
+}
+
+// Seconds per update of a full pool, over runs that each start again from `full`.
+static double bench_particles_time(Particle_Pool *p, const Particle_Pool *full, void (*update)(Particle_Pool *, float))
+{
+    double elapsed = 0.0;
+    for (int run = 0; run < BENCH_PARTICLE_RUNS; run++)
+    {
+        bench_particles_copy(p, full);
+        double start = bench_now();
+        for (int i = 0; i < BENCH_PARTICLE_STEPS; i++) update(p, BENCH_PARTICLE_DT);
+        elapsed += bench_now() - start;
+    }
+    return elapsed / (BENCH_PARTICLE_RUNS * BENCH_PARTICLE_STEPS);
+}
+
+static bool bench_particles(uint64_t seed)
+{
+    Particle_Pool *full = particle_pool_make();
+    Particle_Pool *vector = particle_pool_make();
+    Particle_Pool *scalar = particle_pool_make();
+    if (!full || !vector || !scalar)
+    {
+        fprintf(stderr, "Bench: out of memory for particle pools\n");
+        particle_pool_free(full);
+        particle_pool_free(vector);
+        particle_pool_free(scalar);
+        return false;
+    }
+    bench_particles_fill(full, seed);
+    printf("%d particles, %d lanes, updates of %.4fs:\n", full->count, PARTICLE_LANES, BENCH_PARTICLE_DT);
+
+    // Both paths, run until every particle has faded. Positions must agree up to rounding
+    // (the compiler may fuse a multiply-add in one and not the other), and the same ones must fade.
+    bench_particles_copy(vector, full);
+    bench_particles_copy(scalar, full);
+    float max_diff = 0.0f;
+    int steps = 0;
+    bool counts_agree = true;
+    while (scalar->count > 0 && counts_agree)
+    {
+        particles_update(vector, BENCH_PARTICLE_DT);
+        particles_update_scalar(scalar, BENCH_PARTICLE_DT);
+        counts_agree = vector->count == scalar->count;
+        for (int i = 0; i < scalar->count && counts_agree; i++)
+        {
+            float d = fmaxf(fabsf(vector->x[i] - scalar->x[i]), fabsf(vector->y[i] - scalar->y[i]));
+            if (d > max_diff) max_diff = d;
+        }
+        steps++;
+    }
+    bool ok = counts_agree && max_diff < 1e-3f;
+    if (!counts_agree) printf("  live counts differ after %d updates: vector %d, scalar %d\n", steps, vector->count, scalar->count);
+    else printf("  %d updates until all faded, max position difference %g cells\n", steps, max_diff);
+
+    double scalar_time = bench_particles_time(scalar, full, particles_update_scalar);
+    double vector_time = bench_particles_time(vector, full, particles_update);
+    printf("  %-7s %8.1f us per update, %.0fM particles/s\n", "scalar", scalar_time * 1e6, full->count / scalar_time * 1e-6);
+    printf("  %-7s %8.1f us per update, %.0fM particles/s, %.1fx\n", "vector", vector_time * 1e6, full->count / vector_time * 1e-6,
+        scalar_time / vector_time);
+
+    particle_pool_free(full);
+    particle_pool_free(vector);
+    particle_pool_free(scalar);
+    return ok;
+}
+
+static void bench_usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [--games N] [--max-pieces N] [--threads N] [--seed N] [--trace FILE]\n"
+        "       %s --lockstep [--games N] [--seed N]\n"
+        "       %s --nn weights.mlp [--games N] [--max-pieces N] [--threads N] [--seed N]\n"
+        "       %s --write-nn weights.mlp\n"
+        "       %s --particles [--seed N]\n", argv0, argv0, argv0, argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    Bench_Job job = {
+        .games = 64,
+        .max_pieces = 2000,
+        .threads = cpus > 0 ? (int)cpus : 1,
+        .base_seed = 1,
+        .weights = ai_default_weights(),
+    };
+    bool lockstep = false;
+    bool particles = false;
+    const char *nn_path = NULL;
+    const char *write_nn_path = NULL;
+    const char *trace_path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "--lockstep"))  { lockstep = true; continue; }
+        if (!strcmp(arg, "--particles")) { particles = true; continue; }
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!val) { bench_usage(argv[0]); return 1; }
+
+        if      (!strcmp(arg, "--games"))      job.games = atoi(val);
+        else if (!strcmp(arg, "--max-pieces")) job.max_pieces = atoi(val);
+        else if (!strcmp(arg, "--threads"))    job.threads = atoi(val);
+        else if (!strcmp(arg, "--seed"))       job.base_seed = strtoull(val, NULL, 10);
+        else if (!strcmp(arg, "--nn"))         nn_path = val;
+        else if (!strcmp(arg, "--write-nn"))   write_nn_path = val;
+        else if (!strcmp(arg, "--trace"))      trace_path = val;
+        else { bench_usage(argv[0]); return 1; }
+        i++;
+    }
+
+    if (job.games < 1 || job.max_pieces < 1 || job.threads < 1)
+    {
+        bench_usage(argv[0]);
+        return 1;
+    }
+
+    if (lockstep)
+    {
+        bench_rollouts(job.games, job.base_seed);
+        return 0;
+    }
+
+    if (particles) return bench_particles(job.base_seed) ? 0 : 1;
+
+    if (write_nn_path)
+    {
+        Nn_Model *m = nn_model_from_weights(&job.weights);
+        bool ok = m && nn_model_save(m, write_nn_path);
+        nn_model_free(m);
+        return ok ? 0 : 1;
+    }
+
+    Nn_Model *nn = NULL;
+    if (nn_path)
+    {
+        nn = nn_model_load(nn_path);
+        if (!nn) return 1;
+        bench_nn_batches(nn, job.base_seed);
+        job.nn = nn;
+    }
+
+    if (trace_path && !trace_start(trace_path)) return 1;
+    double start = bench_now();
+    pthread_t threads[256];
+    int thread_count = job.threads < 256 ? job.threads : 256;
+    for (int i = 0; i < thread_count; i++) pthread_create(&threads[i], NULL, bench_worker, &job);
+    for (int i = 0; i < thread_count; i++) pthread_join(threads[i], NULL);
+    double elapsed = bench_now() - start;
+    trace_stop();
+
+    long pieces = atomic_load(&job.pieces);
+    printf("%d games on %d threads: %ld pieces, %ld lines, %d topped out\n",
+        job.games, thread_count, pieces, atomic_load(&job.lines), atomic_load(&job.topped_out));
+    printf("score %llu (%.0f per game), %ld tetrises, reached level %d, max height %d\n",
+        (unsigned long long)atomic_load(&job.score), (double)atomic_load(&job.score) / job.games,
+        atomic_load(&job.tetrises), atomic_load(&job.max_level), atomic_load(&job.max_height));
+    printf("%.2fs: %.1f games/s, %.0f pieces/s\n", elapsed, (double)job.games / elapsed, (double)pieces / elapsed);
+    nn_model_free(nn);
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "capture.h"
+#include "gl_glue.h"
+
+// PNG encoding: stored (uncompressed) deflate blocks, so no zlib dependency.
+
+static uint32_t png_crc_table[256];
+
+static void png_crc_init()
+{
+    if (png_crc_table[1]) return;
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        png_crc_table[n] = c;
+    }
+}
+
+static uint32_t png_crc(uint32_t crc, const unsigned char *data, size_t size)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) crc = png_crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void png_put_u32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static void png_write_chunk(FILE *f, const char *type, const unsigned char *data, uint32_t size)
+{
+    unsigned char header[8];
+    png_put_u32(header, size);
+    memcpy(header + 4, type, 4);
+    fwrite(header, 1, 8, f);
+    if (size) fwrite(data, 1, size, f);
+
+    unsigned char crc[4];
+    png_put_u32(crc, png_crc(png_crc(0, (const unsigned char *)type, 4), data, size));
+    fwrite(crc, 1, 4, f);
+}
+
+// `pixels` is bottom row first, the way glReadPixels returns it.
+bool png_write_rgba(const char *path, int w, int h, const unsigned char *pixels)
+{
+    png_crc_init();
+
+    const size_t stride = (size_t)w * 4;
+    const size_t raw_size = (stride + 1) * (size_t)h;
+    const size_t block_max = 65535;
+    const size_t block_count = (raw_size + block_max - 1) / block_max;
+    const size_t z_size = 2 + raw_size + block_count * 5 + 4;
+
+    unsigned char *z = mem_alloc(z_size);
+    if (!z) return false;
+
+    unsigned char *out = z;
+    *out++ = 0x78;
+    *out++ = 0x01;
+
+    uint32_t adler_a = 1, adler_b = 0;
+    size_t block_left = 0;
+    size_t raw_left = raw_size;
+    for (int y = h - 1; y >= 0; y--)
+    {
+        const unsigned char *row = pixels + (size_t)y * stride;
+        for (size_t i = 0; i <= stride; i++)
+        {
+            if (block_left == 0)
+            {
+                block_left = raw_left < block_max ? raw_left : block_max;
+                *out++ = (raw_left == block_left) ? 1 : 0;
+                *out++ = (unsigned char)(block_left & 0xFF);
+                *out++ = (unsigned char)(block_left >> 8);
+                *out++ = (unsigned char)(~block_left & 0xFF);
+                *out++ = (unsigned char)((~block_left >> 8) & 0xFF);
+            }
+            // Filter byte 0 (none) in front of each scanline.
+            unsigned char byte = (i == 0) ? 0 : row[i - 1];
+            *out++ = byte;
+            adler_a = (adler_a + byte) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+            block_left--;
+            raw_left--;
+        }
+    }
+    png_put_u32(out, (adler_b << 16) | adler_a);
+    out += 4;
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        mem_free(z);
+        return false;
+    }
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    fwrite(signature, 1, sizeof(signature), f);
+
+    unsigned char ihdr[13];
+    png_put_u32(ihdr, (uint32_t)w);
+    png_put_u32(ihdr + 4, (uint32_t)h);
+    ihdr[8] = 8;   // bit depth
+    ihdr[9] = 6;   // RGBA
+    ihdr[10] = 0;  // deflate
+    ihdr[11] = 0;  // adaptive filtering
+    ihdr[12] = 0;  // no interlace
+    png_write_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+    png_write_chunk(f, "IDAT", z, (uint32_t)(out - z));
+    png_write_chunk(f, "IEND", NULL, 0);
+
+    mem_free(z);
+    return fclose(f) == 0;
+}
+
+// --------------------------------------------------------------------
+
+bool capture_begin(Frame_Capture *cap, Capture_Format format, const char *path, int w, int h)
+{
+    memset(cap, 0, sizeof(*cap));
+    cap->format = format;
+    cap->w = w;
+    cap->h = h;
+    cap->name_prefix = "frame";
+    snprintf(cap->path, sizeof(cap->path), "%s", path);
+
+    if (format == CAPTURE_FORMAT_RAW)
+    {
+        cap->raw = fopen(path, "wb");
+        if (!cap->raw)
+        {
+            fprintf(stderr, "Capture: couldn't open %s\n", path);
+            return false;
+        }
+    }
+    else
+    {
+        mkdir(path, 0755);
+    }
+
+    glGenBuffers(CAPTURE_RING, cap->pbo);
+    for (int i = 0; i < CAPTURE_RING; i++)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, cap->pbo[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)w * h * 4, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+static void capture_write_frame(Frame_Capture *cap, const unsigned char *pixels, int frame_number)
+{
+    if (cap->format == CAPTURE_FORMAT_RAW)
+    {
+        // Flip here too so the raw stream is top row first like every video tool expects.
+        size_t stride = (size_t)cap->w * 4;
+        for (int y = cap->h - 1; y >= 0; y--) fwrite(pixels + (size_t)y * stride, 1, stride, cap->raw);
+    }
+    else
+    {
+        char file_path[640];
+        snprintf(file_path, sizeof(file_path), "%s/%s_%05d.png", cap->path, cap->name_prefix, frame_number);
+        if (!png_write_rgba(file_path, cap->w, cap->h, pixels))
+        {
+            fprintf(stderr, "Capture: couldn't write %s\n", file_path);
+        }
+    }
+    cap->frames_written++;
+}
+
+// Maps and writes the oldest pending frame. Without `wait`, gives up if the GPU isn't done yet.
+static bool capture_retire_oldest(Frame_Capture *cap, bool wait)
+{
+    if (cap->in_flight == 0) return false;
+
+    int slot = (cap->head - cap->in_flight + CAPTURE_RING) % CAPTURE_RING;
+    GLuint64 timeout = wait ? 1000000000ull : 0;
+    GLenum status = glClientWaitSync(cap->fence[slot], GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (status == GL_TIMEOUT_EXPIRED && !wait) return false;
+
+    glDeleteSync(cap->fence[slot]);
+    cap->fence[slot] = 0;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, cap->pbo[slot]);
+    const unsigned char *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)cap->w * cap->h * 4, GL_MAP_READ_BIT);
+    if (pixels)
+    {
+        capture_write_frame(cap, pixels, cap->frame_number[slot]);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    cap->in_flight--;
+    return true;
+}
+
+// Queues a readback of the color attachment of `fbo` (0 for the default framebuffer).
+void capture_frame(Frame_Capture *cap, GLuint fbo)
+{
+    if (cap->in_flight == CAPTURE_RING) capture_retire_oldest(cap, true);
+
+    int slot = cap->head;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, cap->pbo[slot]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, cap->w, cap->h, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    cap->fence[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    cap->frame_number[slot] = cap->frames_issued++;
+    cap->head = (cap->head + 1) % CAPTURE_RING;
+    cap->in_flight++;
+
+    // Write out whatever has already landed, without blocking.
+    while (capture_retire_oldest(cap, false)) {}
+}
+
+void capture_end(Frame_Capture *cap)
+{
+    while (capture_retire_oldest(cap, true)) {}
+    glDeleteBuffers(CAPTURE_RING, cap->pbo);
+    if (cap->raw) fclose(cap->raw);
+    cap->raw = NULL;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "gl_glue.h"
+
+/*
+ * Frame capture with asynchronous readback.
+ *
+ * Each captured frame is read into one of CAPTURE_RING pixel pack buffers
+ * and fenced. A buffer is only mapped once its fence has signalled (or
+ * when the ring is full), so glReadPixels never waits on the GPU.
+ */
+
+#define CAPTURE_RING 3
+
+typedef enum {
+    CAPTURE_FORMAT_PNG,  // One file per frame in a directory.
+    CAPTURE_FORMAT_RAW,  // All frames appended to one file, RGBA8, top row first.
+} Capture_Format;
+
+typedef struct {
+    Capture_Format format;
+    int w, h;
+    char path[512];
+    const char *name_prefix;
+    FILE *raw;
+
+    GLuint pbo[CAPTURE_RING];
+    GLsync fence[CAPTURE_RING];
+    int frame_number[CAPTURE_RING];
+    int head;
+    int in_flight;
+
+    int frames_issued;
+    int frames_written;
+} Frame_Capture;
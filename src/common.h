@@ -14,6 +14,10 @@ typedef struct {
     float x, y, z;
 } Vec_3;
 
+typedef struct {
+    float r, g, b;
+} Col_3f;
+
 /*
  * OpenGL expects column-major.
  * m[column][row]
@@ -48,6 +52,15 @@ typedef enum {
     DIR_DOWN
 } Cardinal_Direction;
 
+// splitmix64: small, seedable from anything, good enough for piece draws.
+static inline uint64_t rng_next(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
 static inline Vec_2 vec2_sub(Vec_2 a, Vec_2 b)
 {
     return (Vec_2){a.x - b.x, a.y - b.y};
@@ -0,0 +1,14 @@
+// Single translation unit for libtetris_core.a.
+
+#include "tetris_core.h"
+
+#include "tetris_core.c"
+#include "sim.c"
+#include "nn.c"
+#include "ai.c"
+#include "versus.c"
+#include "dataset.c"
+#include "lockstep.c"
+#include "movegen.c"
+#include "puzzle.c"
+#include "trace.c"
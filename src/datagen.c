@@ -0,0 +1,206 @@
+/*
+ * Plays bot games on all cores and dumps every placement as a Dataset_Record.
+ *
+ *   bin/datagen --out games.ttrs [--games N] [--max-pieces N] [--threads N] [--seed N]
+ *   bin/datagen --read games.ttrs
+ */
+
+#define TETRIS_HEADLESS
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tetris.h"
+#include "ai.h"
+#include "dataset.h"
+
+#include "tetris_core.c"
+#include "nn.c"
+#include "ai.c"
+#include "dataset.c"
+
+typedef struct {
+    int games;
+    int max_pieces;
+    int threads;
+    uint64_t base_seed;
+    Ai_Weights weights;
+
+    Dataset_Writer *writer;
+    _Atomic int next_game;
+    _Atomic long records;
+    _Atomic bool failed;    // A write failed: every worker stops.
+    _Atomic int write_errno;
+} Datagen_Job;
+
+static double datagen_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void *datagen_worker(void *arg)
+{
+    Datagen_Job *job = arg;
+    Dataset_Record *records = malloc(sizeof(Dataset_Record) * (size_t)job->max_pieces);
+    Game_State s = {0};
+
+    for (;;)
+    {
+        if (atomic_load_explicit(&job->failed, memory_order_relaxed)) break;
+        int game = atomic_fetch_add_explicit(&job->next_game, 1, memory_order_relaxed);
+        if (game >= job->games) break;
+
+        uint64_t seed_rng = job->base_seed + (uint64_t)game;
+        s.tetris_cols = TETRIS_COLS;
+        s.tetris_rows = TETRIS_ROWS;
+        initialize_game_with_seed(&s, rng_next(&seed_rng));
+
+        int count = 0;
+        while (!s.is_game_over && count < job->max_pieces)
+        {
+            Ai_Snapshot snap;
+            Ai_Placement placement;
+            ai_snapshot_from_state(&s, &snap);
+            if (!ai_find_best_placement(&snap, &job->weights, &placement))
+            {
+                s.is_game_over = true;
+                break;
+            }
+
+            Dataset_Record *r = &records[count++];
+            dataset_record_from_state(&s, r);
+            r->placement_x = (int8_t)placement.x;
+            r->placement_orient = (uint8_t)placement.orient;
+            r->lines_cleared = (uint8_t)ai_play_placement(&s, &placement);
+        }
+
+        // The outcome is only known once the game is over.
+        for (int i = 0; i < count; i++)
+        {
+            int left = count - 1 - i;
+            records[i].pieces_left = (uint16_t)(left > UINT16_MAX ? UINT16_MAX : left);
+            records[i].flags = s.is_game_over ? DATASET_FLAG_TOPPED_OUT : 0;
+        }
+
+        if (!dataset_writer_append(job->writer, records, count))
+        {
+            atomic_store(&job->write_errno, errno);
+            atomic_store(&job->failed, true);
+            break;
+        }
+        atomic_fetch_add_explicit(&job->records, count, memory_order_relaxed);
+    }
+
+    free_game(&s);
+    free(records);
+    return NULL;
+}
+
+static int datagen_read(const char *path)
+{
+    Dataset_Reader r;
+    if (!dataset_reader_open(&r, path)) return 1;
+
+    double start = datagen_now();
+    uint64_t lines = 0, topped_out = 0, filled = 0;
+    uint64_t kinds[PIECE_KIND_COUNT] = {0};
+    for (uint64_t i = 0; i < r.record_count; i++)
+    {
+        const Dataset_Record *rec = &r.records[i];
+        lines += rec->lines_cleared;
+        if ((rec->flags & DATASET_FLAG_TOPPED_OUT) && rec->pieces_left == 0) topped_out++;
+        kinds[dataset_piece_kind(rec) % PIECE_KIND_COUNT]++;
+        for (int b = 0; b < DATASET_BOARD_BYTES; b++) filled += (uint64_t)__builtin_popcount(rec->board[b]);
+    }
+    double elapsed = datagen_now() - start;
+
+    printf("%s: %dx%d, %llu records\n", path, r.header->cols, r.header->rows, (unsigned long long)r.record_count);
+    printf("  lines cleared: %llu, games topped out: %llu\n", (unsigned long long)lines, (unsigned long long)topped_out);
+    printf("  average filled cells: %.2f\n", r.record_count ? (double)filled / (double)r.record_count : 0.0);
+    printf("  pieces:");
+    for (int k = 0; k < PIECE_KIND_COUNT; k++) printf(" %llu", (unsigned long long)kinds[k]);
+    printf("\n  scanned in %.3fs (%.0f records/s)\n", elapsed, elapsed > 0 ? (double)r.record_count / elapsed : 0.0);
+
+    dataset_reader_close(&r);
+    return 0;
+}
+
+static void datagen_usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s --out path [--games N] [--max-pieces N] [--threads N] [--seed N]\n"
+        "       %s --read path\n", argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    Datagen_Job job = {
+        .games = 100,
+        .max_pieces = 1000,
+        .threads = cpus > 0 ? (int)cpus : 1,
+        .base_seed = 1,
+        .weights = ai_default_weights(),
+    };
+    const char *out_path = NULL;
+    const char *read_path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!val) { datagen_usage(argv[0]); return 1; }
+
+        if      (!strcmp(arg, "--out"))        out_path = val;
+        else if (!strcmp(arg, "--read"))       read_path = val;
+        else if (!strcmp(arg, "--games"))      job.games = atoi(val);
+        else if (!strcmp(arg, "--max-pieces")) job.max_pieces = atoi(val);
+        else if (!strcmp(arg, "--threads"))    job.threads = atoi(val);
+        else if (!strcmp(arg, "--seed"))       job.base_seed = strtoull(val, NULL, 10);
+        else { datagen_usage(argv[0]); return 1; }
+        i++;
+    }
+
+    if (read_path) return datagen_read(read_path);
+    if (!out_path || job.games < 1 || job.max_pieces < 1 || job.threads < 1)
+    {
+        datagen_usage(argv[0]);
+        return 1;
+    }
+
+    Dataset_Writer writer;
+    if (!dataset_writer_open(&writer, out_path, TETRIS_COLS, TETRIS_ROWS)) return 1;
+    job.writer = &writer;
+
+    double start = datagen_now();
+    pthread_t threads[256];
+    int thread_count = job.threads < 256 ? job.threads : 256;
+    for (int i = 0; i < thread_count; i++) pthread_create(&threads[i], NULL, datagen_worker, &job);
+    for (int i = 0; i < thread_count; i++) pthread_join(threads[i], NULL);
+    double elapsed = datagen_now() - start;
+
+    if (atomic_load(&job.failed))
+    {
+        fprintf(stderr, "Dataset: failed writing %s: %s\n", out_path, atomic_load(&job.write_errno) ? strerror(atomic_load(&job.write_errno)) : "short write");
+        dataset_writer_discard(&writer);
+        return 1;
+    }
+    if (!dataset_writer_close(&writer))
+    {
+        fprintf(stderr, "Dataset: failed writing %s\n", out_path);
+        return 1;
+    }
+
+    long records = atomic_load(&job.records);
+    printf("Wrote %ld records from %d games to %s in %.2fs (%.0f records/s)\n",
+        records, job.games, out_path, elapsed, (double)records / elapsed);
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dataset.h"
+#include "tetris.h"
+
+void dataset_record_from_state(Game_State *s, Dataset_Record *r)
+{
+    memset(r, 0, sizeof(*r));
+    for (int row = 0; row < s->tetris_rows; row++)
+    {
+        for (int col = 0; col < s->tetris_cols; col++)
+        {
+            if (get_block_at(s, col, row)->piece_id > 0) dataset_board_set(r, s->tetris_cols, col, row);
+        }
+    }
+    r->piece = dataset_pack_piece(s->current_piece.kind, s->current_piece.orient);
+}
+
+// --------------------------------------------------------------------
+
+bool dataset_writer_open(Dataset_Writer *w, const char *path, int cols, int rows)
+{
+    if (cols * rows > DATASET_BOARD_BITS)
+    {
+        fprintf(stderr, "Dataset: %dx%d board doesn't fit in %d bits\n", cols, rows, DATASET_BOARD_BITS);
+        return false;
+    }
+
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w->fd < 0)
+    {
+        fprintf(stderr, "Dataset: couldn't open %s for writing\n", path);
+        return false;
+    }
+    w->cols = cols;
+    w->rows = rows;
+    atomic_store(&w->next_record, 0);
+    return true;
+}
+
+/*
+ * Safe to call from many threads at once: each call reserves its own range
+ * of record slots and writes it with a single positioned write.
+ */
+bool dataset_writer_append(Dataset_Writer *w, const Dataset_Record *records, int count)
+{
+    if (count <= 0) return true;
+
+    uint64_t first = atomic_fetch_add_explicit(&w->next_record, (uint64_t)count, memory_order_relaxed);
+    off_t offset = (off_t)(sizeof(Dataset_Header) + first * sizeof(Dataset_Record));
+    size_t size = (size_t)count * sizeof(Dataset_Record);
+
+    const char *p = (const char *)records;
+    while (size > 0)
+    {
+        ssize_t written = pwrite(w->fd, p, size, offset);
+        if (written <= 0) return false;
+        p += written;
+        offset += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+// Writes the header last so a half-written file is never mistaken for a complete one.
+bool dataset_writer_close(Dataset_Writer *w)
+{
+    Dataset_Header h = {0};
+    memcpy(h.magic, DATASET_MAGIC, sizeof(h.magic));
+    h.version = DATASET_VERSION;
+    h.record_size = sizeof(Dataset_Record);
+    h.cols = (uint16_t)w->cols;
+    h.rows = (uint16_t)w->rows;
+    h.record_count = atomic_load(&w->next_record);
+
+    bool ok = pwrite(w->fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h);
+    ok = (close(w->fd) == 0) && ok;
+    w->fd = -1;
+    return ok;
+}
+
+// After a failed append: closes without the header, so the partial file never reads as a dataset.
+void dataset_writer_discard(Dataset_Writer *w)
+{
+    close(w->fd);
+    w->fd = -1;
+}
+
+// --------------------------------------------------------------------
+
+bool dataset_reader_open(Dataset_Reader *r, const char *path)
+{
+    memset(r, 0, sizeof(*r));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Dataset: couldn't open %s\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Dataset_Header))
+    {
+        fprintf(stderr, "Dataset: %s is too small\n", path);
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "Dataset: couldn't map %s\n", path);
+        return false;
+    }
+
+    const Dataset_Header *h = map;
+    uint64_t max_records = ((size_t)st.st_size - sizeof(Dataset_Header)) / sizeof(Dataset_Record);
+    if (memcmp(h->magic, DATASET_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != DATASET_VERSION ||
+        h->record_size != sizeof(Dataset_Record) ||
+        h->record_count > max_records)
+    {
+        fprintf(stderr, "Dataset: %s has a bad header\n", path);
+        munmap(map, (size_t)st.st_size);
+        return false;
+    }
+
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    r->map = map;
+    r->map_size = (size_t)st.st_size;
+    r->header = h;
+    r->records = (const Dataset_Record *)((const char *)map + sizeof(Dataset_Header));
+    r->record_count = h->record_count;
+    return true;
+}
+
+void dataset_reader_close(Dataset_Reader *r)
+{
+    if (r->map) munmap(r->map, r->map_size);
+    memset(r, 0, sizeof(*r));
+}
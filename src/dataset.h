@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "pieces.h"
+
+/*
+ * Training records: one per placement, fixed 32 bytes so a file can be
+ * mmap'd and indexed directly.
+ *
+ * File layout:
+ *   Dataset_Header (64 bytes)
+ *   Dataset_Record[record_count]
+ */
+
+#define DATASET_MAGIC "TTRSDSET"
+#define DATASET_VERSION 1
+#define DATASET_BOARD_BITS 200
+#define DATASET_BOARD_BYTES (DATASET_BOARD_BITS / 8)
+
+#define DATASET_FLAG_TOPPED_OUT 0x1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint16_t cols, rows;
+    uint32_t reserved0;
+    uint64_t record_count;
+    uint8_t reserved[32];
+} Dataset_Header;
+
+typedef struct {
+    // Bit (row * cols + col), LSB first. Only the occupancy, not piece kinds.
+    uint8_t board[DATASET_BOARD_BYTES];
+    // Current piece at spawn: kind in bits 0-2, orient in bits 3-4.
+    uint8_t piece;
+    // Chosen placement.
+    int8_t placement_x;
+    uint8_t placement_orient;
+    // Outcome.
+    uint8_t lines_cleared;
+    uint8_t flags;
+    uint16_t pieces_left;
+} Dataset_Record;
+
+_Static_assert(sizeof(Dataset_Header) == 64, "Dataset_Header must stay 64 bytes");
+_Static_assert(sizeof(Dataset_Record) == 32, "Dataset_Record must stay 32 bytes");
+
+typedef struct {
+    int fd;
+    int cols, rows;
+    _Atomic uint64_t next_record;
+} Dataset_Writer;
+
+typedef struct {
+    void *map;
+    size_t map_size;
+    const Dataset_Header *header;
+    const Dataset_Record *records;
+    uint64_t record_count;
+} Dataset_Reader;
+
+static inline void dataset_board_set(Dataset_Record *r, int cols, int col, int row)
+{
+    int bit = row * cols + col;
+    r->board[bit >> 3] |= (uint8_t)(1u << (bit & 7));
+}
+
+static inline bool dataset_board_get(const Dataset_Record *r, int cols, int col, int row)
+{
+    int bit = row * cols + col;
+    return (r->board[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static inline uint8_t dataset_pack_piece(Piece_Kind kind, Piece_Orient orient)
+{
+    return (uint8_t)((kind & 0x7) | ((orient & 0x3) << 3));
+}
+
+static inline Piece_Kind dataset_piece_kind(const Dataset_Record *r)
+{
+    return (Piece_Kind)(r->piece & 0x7);
+}
+
+static inline Piece_Orient dataset_piece_orient(const Dataset_Record *r)
+{
+    return (Piece_Orient)((r->piece >> 3) & 0x3);
+}
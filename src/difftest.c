@@ -0,0 +1,670 @@
+/*
+ * Differential tester: plays the same input sequence through the engine
+ * and through a frozen, Block-array-only copy of the original rules, and
+ * compares the two after every step. At each step it also checks that
+ * every collision entry point agrees around the current piece.
+ *
+ *   bin/difftest [--seconds N] [--seed N] [--size N]    random soak
+ *   bin/difftest FILE...                                replay inputs
+ *   bin/difftest --lockstep [--seconds N] [--seed N]    lockstep engine vs Game_State
+ *   bin/difftest --replay [--seconds N] [--seed N]      recorded sim input, played back twice
+ *
+ * The same checks run under libFuzzer when built with
+ * -DDIFFTEST_LIBFUZZER -fsanitize=fuzzer (see `make fuzz`). A soak that
+ * finds a mismatch writes its input to difftest-failure.bin for replay.
+ *
+ * Input format: byte 0 picks the board size and bytes 1-8 the seed.
+ * Every byte after that is one step, with the op in the low 3 bits.
+ */
+
+#define TETRIS_HEADLESS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tetris.h"
+
+#include "tetris_core.c"
+#include "sim.c"
+#include "lockstep.c"
+
+typedef enum {
+    DIFF_OP_LEFT,
+    DIFF_OP_RIGHT,
+    DIFF_OP_DOWN,
+    DIFF_OP_ROTATE_CW,
+    DIFF_OP_ROTATE_CCW,
+    DIFF_OP_ROTATE_180,
+    DIFF_OP_HARD_DROP,
+    DIFF_OP_GARBAGE,        // Count in bits 3-4, hole column from the next byte.
+} Diff_Op;
+
+#define DIFF_MIN_COLS 7     // Room for an I piece at the spawn column.
+#define DIFF_MAX_COLS 16
+#define DIFF_MIN_ROWS 4
+#define DIFF_MAX_ROWS 32
+
+// --------------------------------------------------------------------
+
+/*
+ * The rules as they stood before row masks: every query walks the Block
+ * array. Kept apart from the engine on purpose, so engine changes are
+ * measured against this rather than against themselves.
+ */
+typedef struct {
+    int cols, rows;
+    Block blocks[DIFF_MAX_COLS * DIFF_MAX_ROWS];
+    Piece piece;
+    int piece_id_seed;
+    uint64_t rng_state;
+    bool is_game_over;
+} Ref_Game;
+
+static Block *ref_block_at(Ref_Game *g, int x, int y)
+{
+    if (x < 0 || x >= g->cols || y < 0 || y >= g->rows) return NULL;
+    return &g->blocks[g->cols * y + x];
+}
+
+static bool ref_fits(Ref_Game *g, const Piece *p, int x, int y, Piece_Orient o)
+{
+    const Piece_Spec *spec = piece_spec_get_by_kind(p->kind);
+    for (int col = 0; col < PIECE_MAX_COLS; col++)
+    {
+        for (int row = 0; row < PIECE_MAX_ROWS; row++)
+        {
+            if (!piece_spec_get_block_state_at(spec, o, col, row)) continue;
+            Block *b = ref_block_at(g, x + col, y + row);
+            if (!b || b->piece_id > 0) return false;
+        }
+    }
+    return true;
+}
+
+static bool ref_move(Ref_Game *g, int dx, int dy)
+{
+    if (!ref_fits(g, &g->piece, g->piece.x + dx, g->piece.y + dy, g->piece.orient)) return false;
+    g->piece.x += dx;
+    g->piece.y += dy;
+    return true;
+}
+
+static bool ref_rotate(Ref_Game *g, Piece_Rotation rot)
+{
+    Piece_Orient to = (Piece_Orient)((g->piece.orient + rot) & (PIECE_ORIENT_COUNT - 1));
+    const Piece_Kick_List *kicks = piece_kicks_get(g->piece.kind, g->piece.orient, rot);
+    for (int i = 0; i < kicks->count; i++)
+    {
+        int x = g->piece.x + kicks->tests[i].x;
+        int y = g->piece.y + kicks->tests[i].y;
+        if (ref_fits(g, &g->piece, x, y, to))
+        {
+            g->piece.x = x;
+            g->piece.y = y;
+            g->piece.orient = to;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Same draw as the engine's; a piece that doesn't fit leaves the old one in place and ends the game.
+static void ref_spawn(Ref_Game *g)
+{
+    Piece p = {
+        .id = g->piece_id_seed++,
+        .x = 3, .y = 0,
+        .kind = (Piece_Kind)(rng_next(&g->rng_state) % PIECE_KIND_COUNT),
+        .orient = (Piece_Orient)(rng_next(&g->rng_state) % PIECE_ORIENT_COUNT)
+    };
+    if (ref_fits(g, &p, p.x, p.y, p.orient)) g->piece = p;
+    else g->is_game_over = true;
+}
+
+static void ref_commit(Ref_Game *g)
+{
+    const Piece_Spec *spec = piece_spec_get_by_kind(g->piece.kind);
+    for (int col = 0; col < PIECE_MAX_COLS; col++)
+    {
+        for (int row = 0; row < PIECE_MAX_ROWS; row++)
+        {
+            if (!piece_spec_get_block_state_at(spec, g->piece.orient, col, row)) continue;
+            Block *b = ref_block_at(g, g->piece.x + col, g->piece.y + row);
+            b->piece_id = g->piece.id;
+            b->piece_kind = g->piece.kind;
+        }
+    }
+}
+
+static int ref_check_lines(Ref_Game *g)
+{
+    int cleared = 0;
+    for (int row = g->rows - 1; row >= 0;)
+    {
+        bool full = true;
+        for (int col = 0; col < g->cols && full; col++) full = ref_block_at(g, col, row)->piece_id > 0;
+        if (!full)
+        {
+            row--;
+            continue;
+        }
+
+        for (int r = row; r >= 0; r--)
+        {
+            for (int col = 0; col < g->cols; col++)
+            {
+                *ref_block_at(g, col, r) = r > 0 ? *ref_block_at(g, col, r - 1) : (Block){0};
+            }
+        }
+        cleared++;
+    }
+    return cleared;
+}
+
+static bool ref_insert_garbage(Ref_Game *g, int count, int hole_col)
+{
+    if (count <= 0) return true;
+    if (count > g->rows) count = g->rows;
+
+    bool spilled = false;
+    for (int n = 0; n < count; n++)
+    {
+        for (int col = 0; col < g->cols; col++)
+        {
+            if (ref_block_at(g, col, 0)->piece_id > 0) spilled = true;
+        }
+        for (int row = 0; row < g->rows - 1; row++)
+        {
+            for (int col = 0; col < g->cols; col++) *ref_block_at(g, col, row) = *ref_block_at(g, col, row + 1);
+        }
+        for (int col = 0; col < g->cols; col++)
+        {
+            *ref_block_at(g, col, g->rows - 1) = (col == hole_col) ? (Block){0} : (Block){.piece_id = GARBAGE_PIECE_ID, .piece_kind = PIECE_GARBAGE};
+        }
+    }
+    return !spilled && ref_fits(g, &g->piece, g->piece.x, g->piece.y, g->piece.orient);
+}
+
+// --------------------------------------------------------------------
+
+typedef struct {
+    Game_State game;
+    Ref_Game ref;
+    uint64_t steps;
+    uint64_t probes;
+
+    const uint8_t *input;
+    size_t input_size;
+    bool write_failures;
+} Diff_Run;
+
+static void diff_fail(Diff_Run *run, size_t at, const char *what)
+{
+    fprintf(stderr, "difftest: %s at input byte %zu (step %llu)\n", what, at, (unsigned long long)run->steps);
+    if (run->write_failures)
+    {
+        FILE *f = fopen("difftest-failure.bin", "wb");
+        if (f)
+        {
+            fwrite(run->input, 1, run->input_size, f);
+            fclose(f);
+            fprintf(stderr, "difftest: input written to difftest-failure.bin\n");
+        }
+    }
+    abort();
+}
+
+// Every collision entry point, at every orientation, in a window around the piece.
+static void diff_check_collisions(Diff_Run *run, size_t at)
+{
+    Game_State *s = &run->game;
+    Piece p = s->current_piece;
+    for (int o = 0; o < PIECE_ORIENT_COUNT; o++)
+    {
+        for (int y = p.y - 2; y <= p.y + 2; y++)
+        {
+            for (int x = -2; x < s->tetris_cols + 1; x++)
+            {
+                bool reference = check_piece_collision(s, &p, x, y, (Piece_Orient)o);
+                bool fast = check_piece_collision_fast(s, &p, x, y, (Piece_Orient)o);
+                bool frozen = ref_fits(&run->ref, &p, x, y, (Piece_Orient)o);
+                if (reference != fast || reference != frozen) diff_fail(run, at, "collision tests disagree");
+                run->probes++;
+            }
+        }
+    }
+}
+
+static void diff_check_state(Diff_Run *run, size_t at)
+{
+    Game_State *s = &run->game;
+    Ref_Game *g = &run->ref;
+
+    if (s->is_game_over != g->is_game_over) diff_fail(run, at, "game over differs");
+    if (memcmp(&s->current_piece, &g->piece, sizeof(Piece)) != 0) diff_fail(run, at, "piece differs");
+    if (memcmp(s->blocks, g->blocks, sizeof(Block) * (size_t)(g->cols * g->rows)) != 0) diff_fail(run, at, "board differs");
+
+    for (int row = 0; row < g->rows; row++)
+    {
+        uint16_t mask = 0;
+        for (int col = 0; col < g->cols; col++)
+        {
+            if (ref_block_at(g, col, row)->piece_id > 0) mask |= (uint16_t)(1u << col);
+        }
+        if (s->row_masks[row] != mask) diff_fail(run, at, "row mask out of sync");
+    }
+
+    if (!s->is_game_over) diff_check_collisions(run, at);
+}
+
+static void diff_start(Diff_Run *run, uint64_t seed)
+{
+    initialize_game_with_seed(&run->game, seed);
+
+    Ref_Game *g = &run->ref;
+    memset(g->blocks, 0, sizeof(g->blocks));
+    g->piece = (Piece){0};
+    g->piece_id_seed = 1;
+    g->rng_state = seed;
+    g->is_game_over = false;
+    ref_spawn(g);
+}
+
+static void diff_run_input(Diff_Run *run, const uint8_t *data, size_t size)
+{
+    if (size < 9) return;
+    run->input = data;
+    run->input_size = size;
+
+    int cols = DIFF_MIN_COLS + (data[0] & 0x0F) % (DIFF_MAX_COLS - DIFF_MIN_COLS + 1);
+    int rows = DIFF_MIN_ROWS + (data[0] >> 4) * (DIFF_MAX_ROWS - DIFF_MIN_ROWS) / 15;
+    uint64_t seed = 0;
+    for (int i = 0; i < 8; i++) seed |= (uint64_t)data[1 + i] << (8 * i);
+
+    run->game.tetris_cols = run->ref.cols = cols;
+    run->game.tetris_rows = run->ref.rows = rows;
+    diff_start(run, seed);
+    diff_check_state(run, 0);
+
+    for (size_t at = 9; at < size; at++)
+    {
+        uint8_t b = data[at];
+        Game_State *s = &run->game;
+        Ref_Game *g = &run->ref;
+
+        if (s->is_game_over)
+        {
+            diff_start(run, rng_next(&seed));
+            diff_check_state(run, at);
+            continue;
+        }
+
+        bool moved = false, ref_moved = false;
+        int cleared = 0, ref_cleared = 0;
+        switch ((Diff_Op)(b & 7))
+        {
+            case DIFF_OP_LEFT:       moved = slide_current_piece(s, -1); ref_moved = ref_move(g, -1, 0); break;
+            case DIFF_OP_RIGHT:      moved = slide_current_piece(s, +1); ref_moved = ref_move(g, +1, 0); break;
+            case DIFF_OP_DOWN:       moved = move_current_piece_down(s); ref_moved = ref_move(g, 0, +1); break;
+            case DIFF_OP_ROTATE_CW:  moved = rotate_current_piece(s, PIECE_ROTATE_CW); ref_moved = ref_rotate(g, PIECE_ROTATE_CW); break;
+            case DIFF_OP_ROTATE_CCW: moved = rotate_current_piece(s, PIECE_ROTATE_CCW); ref_moved = ref_rotate(g, PIECE_ROTATE_CCW); break;
+            case DIFF_OP_ROTATE_180: moved = rotate_current_piece(s, PIECE_ROTATE_180); ref_moved = ref_rotate(g, PIECE_ROTATE_180); break;
+            case DIFF_OP_HARD_DROP:
+            {
+                while (move_current_piece_down(s)) {}
+                while (ref_move(g, 0, +1)) {}
+                cleared = lock_current_piece(s);
+                ref_commit(g);
+                ref_cleared = ref_check_lines(g);
+                ref_spawn(g);
+            } break;
+            case DIFF_OP_GARBAGE:
+            {
+                int count = 1 + ((b >> 3) & 3);
+                int hole = (at + 1 < size) ? data[++at] % cols : 0;
+                moved = insert_garbage_rows(s, count, hole);
+                ref_moved = ref_insert_garbage(g, count, hole);
+                if (!moved) s->is_game_over = true;
+                if (!ref_moved) g->is_game_over = true;
+            } break;
+        }
+
+        if (moved != ref_moved) diff_fail(run, at, "move result differs");
+        if (cleared != ref_cleared) diff_fail(run, at, "lines cleared differ");
+        run->steps++;
+        diff_check_state(run, at);
+    }
+}
+
+// --------------------------------------------------------------------
+
+#ifdef DIFFTEST_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static Diff_Run run;
+    diff_run_input(&run, data, size);
+    return 0;
+}
+
+#else
+
+static double diff_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int diff_replay(Diff_Run *run, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "difftest: couldn't open %s\n", path);
+        return 1;
+    }
+    static uint8_t data[1 << 20];
+    size_t size = fread(data, 1, sizeof(data), f);
+    fclose(f);
+
+    diff_run_input(run, data, size);
+    printf("%s: %zu bytes, %llu steps, no differences\n", path, size, (unsigned long long)run->steps);
+    return 0;
+}
+
+// --------------------------------------------------------------------
+
+#define DIFF_LOCKSTEP_GAMES 61  // Deliberately not a whole number of vectors.
+
+// The rollout policy, applied the engine's way.
+static void diff_place_spawned(Game_State *s, uint64_t *policy_rng)
+{
+    Piece placed;
+    lockstep_pick_pose(policy_rng, s->tetris_cols, &s->current_piece, &placed);
+    set_current_piece(s, placed);
+}
+
+static bool diff_lockstep_matches(const Lockstep_Engine *L, Game_State *games, int *bad_game)
+{
+    for (int g = 0; g < L->count; g++)
+    {
+        Game_State *s = &games[g];
+        *bad_game = g;
+        if ((L->playing[g] != 0) == s->is_game_over) return false;
+        if (L->lines[g] != s->stats.lines || L->pieces[g] != s->stats.pieces) return false;
+        for (int row = 0; row < L->rows; row++)
+        {
+            if (L->board[row * L->stride + g] != s->row_masks[row]) return false;
+        }
+        if (s->is_game_over) continue;
+
+        const Piece *p = &s->current_piece;
+        if (L->x[g] != p->x || L->y[g] != p->y || L->kind[g] != (int32_t)p->kind || L->orient[g] != (int32_t)p->orient) return false;
+    }
+    return true;
+}
+
+/*
+ * Plays the same rollouts on the lockstep engine and on one Game_State per
+ * game, comparing every game after every step. Rounds pick a new board size.
+ */
+static int diff_lockstep_soak(double seconds, uint64_t seed)
+{
+    static Game_State games[DIFF_LOCKSTEP_GAMES];
+    uint64_t policy_rng[DIFF_LOCKSTEP_GAMES];
+    Lockstep_Engine L = {0};
+
+    printf("Lockstep soak for %.0fs from seed %llu, %d lanes\n", seconds, (unsigned long long)seed, LOCKSTEP_LANES);
+
+    uint64_t game_steps = 0;
+    long rounds = 0;
+    double start = diff_now(), elapsed = 0.0;
+    while (elapsed < seconds)
+    {
+        uint64_t round_seed = seed;
+        int cols = DIFF_MIN_COLS + (int)(rng_next(&seed) % (DIFF_MAX_COLS - DIFF_MIN_COLS + 1));
+        int rows = DIFF_MIN_ROWS + (int)(rng_next(&seed) % (DIFF_MAX_ROWS - DIFF_MIN_ROWS + 1));
+        lockstep_free(&L);
+        if (!lockstep_init(&L, DIFF_LOCKSTEP_GAMES, cols, rows)) return 1;
+
+        for (int g = 0; g < DIFF_LOCKSTEP_GAMES; g++)
+        {
+            uint64_t game_seed = rng_next(&seed);
+            uint64_t policy_seed = rng_next(&seed);
+            lockstep_start(&L, g, game_seed, policy_seed);
+
+            Game_State *s = &games[g];
+            s->tetris_cols = cols;
+            s->tetris_rows = rows;
+            initialize_game_with_seed(s, game_seed);
+            policy_rng[g] = policy_seed;
+            diff_place_spawned(s, &policy_rng[g]);
+        }
+
+        for (int step = 0;; step++)
+        {
+            int bad_game;
+            if (!diff_lockstep_matches(&L, games, &bad_game))
+            {
+                fprintf(stderr, "difftest: lockstep game %d differs at step %d of the round from seed %llu (%dx%d)\n",
+                    bad_game, step, (unsigned long long)round_seed, cols, rows);
+                return 1;
+            }
+
+            int playing = lockstep_playing_count(&L);
+            if (playing == 0) break;
+            game_steps += (uint64_t)playing;
+
+            lockstep_step(&L);
+            for (int g = 0; g < DIFF_LOCKSTEP_GAMES; g++)
+            {
+                Game_State *s = &games[g];
+                if (s->is_game_over || move_current_piece_down(s)) continue;
+                lock_current_piece(s);
+                if (!s->is_game_over) diff_place_spawned(s, &policy_rng[g]);
+            }
+        }
+        rounds++;
+        elapsed = diff_now() - start;
+    }
+
+    printf("%ld rounds, %llu game-steps in %.2fs: %.0f game-steps/s, no differences\n", rounds,
+        (unsigned long long)game_steps, elapsed, (double)game_steps / elapsed);
+    lockstep_free(&L);
+    for (int g = 0; g < DIFF_LOCKSTEP_GAMES; g++) free_game(&games[g]);
+    return 0;
+}
+
+// --------------------------------------------------------------------
+
+#define DIFF_REPLAY_TICKS (SIM_TICK_HZ * 120)   // Per game, unless it tops out first.
+#define DIFF_REPLAY_MAX_EVENTS 8192
+#define DIFF_REPLAY_EVENT_ODDS (SIM_TICK_HZ / 10)
+
+typedef struct {
+    uint64_t seed;
+    uint64_t ticks;         // Where the recording stopped.
+    int count;
+    Sim_Input_Event events[DIFF_REPLAY_MAX_EVENTS];
+} Diff_Recording;
+
+// Random presses and releases, about ten a second, queued on the tick they happen like a host does.
+static void diff_record(Game_State *s, Diff_Recording *rec, uint64_t *input_rng)
+{
+    initialize_game_with_seed(s, rec->seed);
+    rec->count = 0;
+    while (s->sim.tick < DIFF_REPLAY_TICKS && !s->is_game_over)
+    {
+        if (rng_next(input_rng) % DIFF_REPLAY_EVENT_ODDS == 0 && rec->count < DIFF_REPLAY_MAX_EVENTS)
+        {
+            Sim_Input input = (Sim_Input)(rng_next(input_rng) % SIM_INPUT_COUNT);
+            bool down = rng_next(input_rng) & 1;
+            if (sim_queue_input(&s->sim, input, down))
+            {
+                rec->events[rec->count++] = (Sim_Input_Event){.tick = s->sim.tick, .input = (uint8_t)input, .down = down};
+            }
+        }
+        sim_step(s);
+    }
+    rec->ticks = s->sim.tick;
+}
+
+// Plays a recording from its seed, queueing events up to a second ahead as the queue has room.
+static void diff_play_recording(Game_State *s, const Diff_Recording *rec)
+{
+    initialize_game_with_seed(s, rec->seed);
+    int next = 0;
+    while (s->sim.tick < rec->ticks && !s->is_game_over)
+    {
+        for (; next < rec->count && rec->events[next].tick <= s->sim.tick + SIM_TICK_HZ; next++)
+        {
+            const Sim_Input_Event *e = &rec->events[next];
+            if (!sim_queue_input_at(&s->sim, e->tick, (Sim_Input)e->input, e->down)) break;
+        }
+        sim_step(s);
+    }
+}
+
+static bool diff_games_match(const Game_State *a, const Game_State *b)
+{
+    const Game_Stats *sa = &a->stats, *sb = &b->stats;
+    const Piece *pa = &a->current_piece, *pb = &b->current_piece;
+    size_t cells = (size_t)(a->tetris_cols * a->tetris_rows);
+    return a->sim.tick == b->sim.tick && a->is_game_over == b->is_game_over && a->rng_state == b->rng_state &&
+        a->piece_id_seed == b->piece_id_seed &&
+        pa->id == pb->id && pa->kind == pb->kind && pa->orient == pb->orient && pa->x == pb->x && pa->y == pb->y &&
+        sa->score == sb->score && sa->level == sb->level && sa->lines == sb->lines && sa->pieces == sb->pieces &&
+        sa->tspins == sb->tspins && sa->back_to_backs == sb->back_to_backs && sa->max_combo == sb->max_combo &&
+        sa->finesse_faults == sb->finesse_faults &&
+        !memcmp(a->row_masks, b->row_masks, sizeof(uint16_t) * (size_t)a->tetris_rows) &&
+        !memcmp(a->blocks, b->blocks, sizeof(Block) * cells);
+}
+
+/*
+ * Records random input through sim_step, then plays the recording back
+ * twice from the same seed. All three games must end identically: the
+ * game is meant to be a function of its seed and its (tick, input) stream.
+ */
+static int diff_replay_soak(double seconds, uint64_t seed)
+{
+    static Game_State games[3];
+    static Diff_Recording rec;
+    for (int g = 0; g < 3; g++)
+    {
+        games[g].tetris_cols = TETRIS_COLS;
+        games[g].tetris_rows = TETRIS_ROWS;
+    }
+
+    printf("Replay soak for %.0fs from seed %llu\n", seconds, (unsigned long long)seed);
+
+    long recordings = 0, events = 0;
+    uint64_t ticks = 0;
+    double start = diff_now(), elapsed = 0.0;
+    while (elapsed < seconds)
+    {
+        rec.seed = rng_next(&seed);
+        diff_record(&games[0], &rec, &seed);
+        diff_play_recording(&games[1], &rec);
+        diff_play_recording(&games[2], &rec);
+        if (!diff_games_match(&games[0], &games[1]) || !diff_games_match(&games[1], &games[2]))
+        {
+            fprintf(stderr, "difftest: replays of game seed %llu differ (%d inputs, %llu ticks)\n",
+                (unsigned long long)rec.seed, rec.count, (unsigned long long)rec.ticks);
+            return 1;
+        }
+        recordings++;
+        events += rec.count;
+        ticks += rec.ticks;
+        elapsed = diff_now() - start;
+    }
+
+    printf("%ld recordings, %ld inputs, %llu ticks each played 3 times in %.2fs, no differences\n", recordings, events,
+        (unsigned long long)ticks, elapsed);
+    for (int g = 0; g < 3; g++) free_game(&games[g]);
+    return 0;
+}
+
+static void diff_usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [--seconds N] [--seed N] [--size N]\n"
+        "       %s FILE...\n"
+        "       %s --lockstep [--seconds N] [--seed N]\n"
+        "       %s --replay [--seconds N] [--seed N]\n", argv0, argv0, argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 10.0;
+    uint64_t seed = (uint64_t)time(NULL);
+    int input_size = 4096;
+    bool lockstep = false;
+    bool replay = false;
+    static Diff_Run run;
+
+    if (argc > 1 && argv[1][0] != '-')
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (diff_replay(&run, argv[i])) return 1;
+        }
+        free_game(&run.game);
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "--lockstep")) { lockstep = true; continue; }
+        if (!strcmp(arg, "--replay"))   { replay = true; continue; }
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!val) { diff_usage(argv[0]); return 1; }
+
+        if      (!strcmp(arg, "--seconds")) seconds = atof(val);
+        else if (!strcmp(arg, "--seed"))    seed = strtoull(val, NULL, 10);
+        else if (!strcmp(arg, "--size"))    input_size = atoi(val);
+        else { diff_usage(argv[0]); return 1; }
+        i++;
+    }
+    if (input_size < 16)
+    {
+        diff_usage(argv[0]);
+        return 1;
+    }
+
+    if (lockstep) return diff_lockstep_soak(seconds, seed);
+    if (replay) return diff_replay_soak(seconds, seed);
+
+    printf("Soaking for %.0fs from seed %llu\n", seconds, (unsigned long long)seed);
+
+    uint8_t *data = malloc((size_t)input_size);
+    run.write_failures = true;
+    long inputs = 0;
+    double start = diff_now(), elapsed = 0.0, next_report = 1.0;
+    while (elapsed < seconds)
+    {
+        for (int i = 0; i < input_size; i++) data[i] = (uint8_t)rng_next(&seed);
+        diff_run_input(&run, data, (size_t)input_size);
+        inputs++;
+
+        elapsed = diff_now() - start;
+        if (elapsed >= next_report)
+        {
+            printf("%6.0fs: %ld inputs, %llu steps, %.0f steps/s, %.0f probes/s\n", elapsed, inputs,
+                (unsigned long long)run.steps, (double)run.steps / elapsed, (double)run.probes / elapsed);
+            fflush(stdout);
+            next_report += next_report < 10.0 ? 1.0 : 10.0;
+        }
+    }
+
+    printf("%ld inputs, %llu steps in %.2fs: %.0f steps/s, no differences\n", inputs,
+        (unsigned long long)run.steps, elapsed, (double)run.steps / elapsed);
+    free(data);
+    free_game(&run.game);
+    return 0;
+}
+
+#endif
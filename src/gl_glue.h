@@ -1,11 +1,26 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#ifdef __APPLE__
 #include <OpenGL/gl3.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
 #include <stb_image.h>
 
+#include "common.h"
+#include "mem.h"
+#include "trace.h"
+
 typedef struct {
     GLuint texture_id;
     int w, h, ch;
@@ -41,34 +56,186 @@ bool gl_check_link_success(GLuint prog)
     return (bool)success;
 }
 
-static GLuint gl_create_shader_program(const char *vs_src, const char *fs_src)
+/*
+ * Programs are built in two steps so several can compile at once:
+ * gl_program_submit hands the sources to the driver without waiting,
+ * gl_program_finish waits and checks the result. Drivers with
+ * KHR_parallel_shader_compile work through everything submitted on their
+ * own threads in between; others simply compile at submit.
+ *
+ * Linked programs are kept in GL_PROGRAM_CACHE_DIR as the driver's own
+ * program binaries, keyed by a hash of the sources and the GL vendor,
+ * renderer and version, so a restart or a hot reload with unchanged
+ * shaders skips compiling. A binary the driver turns down (an updated
+ * driver, another GPU) is compiled from source and written again.
+ */
+#define GL_PROGRAM_CACHE_DIR ".shader_cache"
+#define GL_PROGRAM_CACHE_MAGIC 0x47525054u     // "TPRG"
+#define GL_PROGRAM_CACHE_MAX_BYTES (16u << 20)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t format;        // The driver's binary format, as glGetProgramBinary reported it.
+    uint64_t key;
+    uint32_t length;
+} Gl_Program_Cache_Header;
+
+typedef struct {
+    GLuint prog;
+    GLuint vs, fs;          // 0 when the program came from the cache.
+    const char *vs_src, *fs_src;
+    uint64_t key;
+    bool cacheable;
+    bool cached;
+} Gl_Program_Build;
+
+static uint64_t gl_hash_string(uint64_t h, const char *str)
 {
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vs, 1, &vs_src, 0);
-    glCompileShader(vs);
-    gl_check_compile_success(vs, vs_src);
+    for (; *str; str++) h = (h ^ (unsigned char)*str) * 0x100000001b3ull;
+    // A terminator, so moving text from one string to the next changes the hash.
+    return (h ^ 0xff) * 0x100000001b3ull;
+}
 
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fs, 1, &fs_src, 0);
-    glCompileShader(fs);
-    gl_check_compile_success(fs, fs_src);
+static uint64_t gl_program_key(const char *vs_src, const char *fs_src)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    const GLenum driver[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (int i = 0; i < 3; i++)
+    {
+        const char *str = (const char *)glGetString(driver[i]);
+        h = gl_hash_string(h, str ? str : "");
+    }
+    h = gl_hash_string(h, vs_src);
+    return gl_hash_string(h, fs_src);
+}
 
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, vs);
-    glAttachShader(prog, fs);
-    glLinkProgram(prog);
-    gl_check_link_success(prog);
+static void gl_program_cache_path(char *path, size_t size, uint64_t key)
+{
+    snprintf(path, size, GL_PROGRAM_CACHE_DIR "/%016llx.bin", (unsigned long long)key);
+}
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+static bool gl_program_cache_supported()
+{
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
 
-    return prog;
+// Loads `prog` from its cached binary; false if there's none or the driver won't take it.
+static bool gl_program_cache_load(GLuint prog, uint64_t key)
+{
+    char path[64];
+    gl_program_cache_path(path, sizeof(path), key);
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+
+    Gl_Program_Cache_Header h;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1 && h.magic == GL_PROGRAM_CACHE_MAGIC && h.key == key &&
+        h.length > 0 && h.length <= GL_PROGRAM_CACHE_MAX_BYTES;
+    void *data = ok ? mem_alloc(h.length) : NULL;
+    ok = data && fread(data, 1, h.length, f) == h.length;
+    fclose(f);
+
+    if (ok)
+    {
+        glProgramBinary(prog, h.format, data, (GLsizei)h.length);
+        GLint linked = 0;
+        glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+        ok = linked;
+    }
+    mem_free(data);
+    return ok;
+}
+
+static void gl_program_cache_save(GLuint prog, uint64_t key)
+{
+    GLint length = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0 || (uint32_t)length > GL_PROGRAM_CACHE_MAX_BYTES) return;
+
+    void *data = mem_alloc((size_t)length);
+    if (!data) return;
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(prog, length, &written, &format, data);
+    Gl_Program_Cache_Header h = {.magic = GL_PROGRAM_CACHE_MAGIC, .format = format, .key = key, .length = (uint32_t)written};
+
+    // Written aside and renamed into place, so a reader never sees half a file.
+    char path[64], tmp_path[96];
+    gl_program_cache_path(path, sizeof(path), key);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld.tmp", path, (long)getpid());
+    mkdir(GL_PROGRAM_CACHE_DIR, 0755);
+    FILE *f = written > 0 ? fopen(tmp_path, "wb") : NULL;
+    if (f)
+    {
+        bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(data, 1, (size_t)written, f) == (size_t)written;
+        ok = fclose(f) == 0 && ok;
+        if (!ok || rename(tmp_path, path) != 0) remove(tmp_path);
+    }
+    mem_free(data);
+}
+
+static void gl_program_submit(Gl_Program_Build *b, const char *vs_src, const char *fs_src)
+{
+    *b = (Gl_Program_Build){.vs_src = vs_src, .fs_src = fs_src};
+    b->prog = glCreateProgram();
+
+    b->cacheable = gl_program_cache_supported();
+    if (b->cacheable)
+    {
+        b->key = gl_program_key(vs_src, fs_src);
+        b->cached = gl_program_cache_load(b->prog, b->key);
+        if (b->cached) return;
+        glProgramParameteri(b->prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    b->vs = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(b->vs, 1, &vs_src, 0);
+    glCompileShader(b->vs);
+
+    b->fs = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(b->fs, 1, &fs_src, 0);
+    glCompileShader(b->fs);
+
+    glAttachShader(b->prog, b->vs);
+    glAttachShader(b->prog, b->fs);
+    glLinkProgram(b->prog);
+}
+
+// Waits for a submitted program, reporting any errors, and caches it if it linked.
+static GLuint gl_program_finish(Gl_Program_Build *b)
+{
+    if (b->cached) return b->prog;
+
+    bool ok = gl_check_compile_success(b->vs, b->vs_src);
+    ok = gl_check_compile_success(b->fs, b->fs_src) && ok;
+    ok = gl_check_link_success(b->prog) && ok;
+
+    glDetachShader(b->prog, b->vs);
+    glDetachShader(b->prog, b->fs);
+    glDeleteShader(b->vs);
+    glDeleteShader(b->fs);
+
+    if (ok && b->cacheable) gl_program_cache_save(b->prog, b->key);
+    return b->prog;
+}
+
+static GLuint gl_create_shader_program(const char *vs_src, const char *fs_src)
+{
+    Gl_Program_Build b;
+    gl_program_submit(&b, vs_src, fs_src);
+    return gl_program_finish(&b);
 }
 
 static Texture gl_load_texture(const char *path, GLint sampling_type)
 {
-    Texture tex;
+    Texture tex = {0};
     unsigned char *tex_data = stbi_load(path, &tex.w, &tex.h, &tex.ch, 0);
+    if (!tex_data)
+    {
+        fprintf(stderr, "Couldn't load texture %s: %s\n", path, stbi_failure_reason());
+        return tex;
+    }
 
     if (tex.ch == 4) { tex.internal_format = GL_RGBA8; tex.format = GL_RGBA; }
     else if (tex.ch == 3) { tex.internal_format = GL_RGB8; tex.format = GL_RGB; }
@@ -94,9 +261,144 @@ static void gl_delete_texture(Texture *tex)
     glDeleteTextures(1, &tex->texture_id);
 }
 
+/*
+ * Streams per-frame vertex data through one buffer split into
+ * GL_RING_REGIONS regions, one per frame in flight. A frame is written
+ * straight into mapped memory while the GPU still reads the previous ones,
+ * and a fence per region says when the GPU is done with it.
+ *
+ * With GL 4.4 or ARB_buffer_storage the buffer is mapped once, persistent
+ * and coherent. Otherwise each region is mapped unsynchronized while its
+ * frame is written; the fence replaces the driver's implicit sync.
+ */
+#define GL_RING_REGIONS 3
+
 typedef struct {
-    float r, g, b;
-} Col_3f;
+    GLuint buffer;
+    size_t region_size;
+    int region;                 // The one being written or drawn this frame.
+    bool persistent;
+    unsigned char *base;        // The whole buffer, when persistent.
+    unsigned char *writing;     // The current region, while it's open for writing.
+    GLsync fences[GL_RING_REGIONS];
+} Gl_Ring;
+
+static bool gl_has_buffer_storage()
+{
+#ifdef GL_MAP_PERSISTENT_BIT
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major > 4 || (major == 4 && minor >= 4)) return true;
+
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        if (!strcmp((const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i), "GL_ARB_buffer_storage")) return true;
+    }
+#endif
+    return false;
+}
+
+// Whole vertices per region, so a region's first vertex is a plain base vertex; also keeps indices 4-aligned.
+static inline size_t gl_ring_region_size(size_t bytes, size_t vert_size)
+{
+    size_t unit = vert_size * 4;
+    return (bytes + unit - 1) / unit * unit;
+}
+
+// Leaves the buffer bound to GL_ARRAY_BUFFER for the caller's attribute setup.
+static inline void gl_ring_init(Gl_Ring *r, size_t region_size)
+{
+    memset(r, 0, sizeof(*r));
+    r->region_size = region_size;
+    GLsizeiptr size = (GLsizeiptr)(region_size * GL_RING_REGIONS);
+
+    glGenBuffers(1, &r->buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, r->buffer);
+#ifdef GL_MAP_PERSISTENT_BIT
+    if (gl_has_buffer_storage())
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+        r->base = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+        r->persistent = r->base != NULL;
+        if (r->persistent) return;
+
+        // Storage is immutable, so start over with a plain buffer.
+        glDeleteBuffers(1, &r->buffer);
+        glGenBuffers(1, &r->buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffer);
+    }
+#endif
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+}
+
+static inline void gl_ring_free(Gl_Ring *r)
+{
+    for (int i = 0; i < GL_RING_REGIONS; i++)
+    {
+        if (r->fences[i]) glDeleteSync(r->fences[i]);
+    }
+    // Deleting a buffer unmaps it.
+    glDeleteBuffers(1, &r->buffer);
+    memset(r, 0, sizeof(*r));
+}
+
+static inline size_t gl_ring_offset(const Gl_Ring *r)
+{
+    return r->region_size * (size_t)r->region;
+}
+
+/*
+ * Opens the current region for writing, first waiting for the GPU to finish
+ * the frame that last used it. Returns NULL if it couldn't be mapped. A
+ * region that was never drawn is still open and is simply handed back.
+ */
+static inline unsigned char *gl_ring_begin(Gl_Ring *r)
+{
+    if (r->writing) return r->writing;
+
+    GLsync fence = r->fences[r->region];
+    if (fence)
+    {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000 * 1000 * 1000) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(fence);
+        r->fences[r->region] = 0;
+    }
+
+    if (r->persistent)
+    {
+        r->writing = r->base + gl_ring_offset(r);
+    }
+    else
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffer);
+        r->writing = glMapBufferRange(GL_ARRAY_BUFFER, (GLintptr)gl_ring_offset(r), (GLsizeiptr)r->region_size, flags);
+    }
+    return r->writing;
+}
+
+// Closes the current region so it can be drawn from. Coherent mappings need no flush.
+static inline void gl_ring_end(Gl_Ring *r)
+{
+    if (!r->writing) return;
+    if (!r->persistent)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, r->buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    r->writing = NULL;
+}
+
+// After the region's draws are issued: fence them and move on to the next region.
+static inline void gl_ring_fence(Gl_Ring *r)
+{
+    r->fences[r->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    r->region = (r->region + 1) % GL_RING_REGIONS;
+}
 
 typedef struct {
     float x, y;
@@ -105,51 +407,37 @@ typedef struct {
 
 #define VERT_MAX 4096
 #define INDEX_MAX 8192
+
+// Each ring region holds a frame's verts, then its indices.
 typedef struct {
-    Vert verts[VERT_MAX];
+    Vert *verts;                // Point into the ring while a frame is being built, NULL otherwise.
     int vert_count;
+    int vert_max;
 
-    unsigned int indices[INDEX_MAX];
+    unsigned int *indices;
     int index_count;
+    int index_max;
 
-    GLuint vao, vbo, ebo;
+    GLuint vao;
+    Gl_Ring ring;
 } Vert_Buffer;
 
-static inline size_t vert_buffer_vert_size(const Vert_Buffer *vb)
+static inline size_t vert_buffer_region_size(const Vert_Buffer *vb)
 {
-    return sizeof(Vert) * vb->vert_count;
+    return gl_ring_region_size(sizeof(Vert) * (size_t)vb->vert_max + sizeof(unsigned int) * (size_t)vb->index_max, sizeof(Vert));
 }
 
-static inline size_t vert_buffer_max_vert_size()
+// A buffer for up to `vert_max` verts and `index_max` indices a frame; VERT_MAX and INDEX_MAX suit the board.
+static inline Vert_Buffer *vert_buffer_make(int vert_max, int index_max)
 {
-    return sizeof(Vert) * VERT_MAX;
-}
-
-static inline size_t vert_buffer_index_size(const Vert_Buffer *vb)
-{
-    return sizeof(unsigned int) * vb->index_count;
-}
-
-static inline size_t vert_buffer_max_index_size()
-{
-    return sizeof(unsigned int) * INDEX_MAX;
-}
-
-static inline Vert_Buffer *vert_buffer_make()
-{
-    Vert_Buffer *vb = malloc(sizeof(Vert_Buffer));
-    vb->vert_count = 0;
-    vb->index_count = 0;
+    Vert_Buffer *vb = mem_calloc(1, sizeof(Vert_Buffer));
+    vb->vert_max = vert_max;
+    vb->index_max = index_max;
 
     glGenVertexArrays(1, &vb->vao);
-    glGenBuffers(1, &vb->vbo);
-    glGenBuffers(1, &vb->ebo);
-
     glBindVertexArray(vb->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vb->vbo);
-    glBufferData(GL_ARRAY_BUFFER, vert_buffer_max_vert_size(), NULL, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vb->ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, vert_buffer_max_index_size(), NULL, GL_DYNAMIC_DRAW);
+    gl_ring_init(&vb->ring, vert_buffer_region_size(vb));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vb->ring.buffer);
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vert), (void *)0);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vert), (void *)(offsetof(Vert, color)));
@@ -159,23 +447,26 @@ static inline Vert_Buffer *vert_buffer_make()
     return vb;
 }
 
+// Starts a frame: waits for this frame's region and points verts and indices into it.
 static inline void vert_buffer_clear(Vert_Buffer *vb)
 {
+    unsigned char *region = gl_ring_begin(&vb->ring);
+    vb->verts = (Vert *)region;
+    vb->indices = region ? (unsigned int *)(region + sizeof(Vert) * (size_t)vb->vert_max) : NULL;
     vb->vert_count = 0;
     vb->index_count = 0;
 }
 
 static inline void vert_buffer_free(Vert_Buffer *vb)
 {
-    glDeleteBuffers(1, &vb->vbo);
-    glDeleteBuffers(1, &vb->ebo);
+    gl_ring_free(&vb->ring);
     glDeleteVertexArrays(1, &vb->vao);
-    free(vb);
+    mem_free(vb);
 }
 
 static inline void vert_buffer_add_vert(Vert_Buffer *vert_buffer, Vert vert)
 {
-    if (vert_buffer->vert_count < VERT_MAX)
+    if (vert_buffer->verts && vert_buffer->vert_count < vert_buffer->vert_max)
     {
         vert_buffer->verts[vert_buffer->vert_count++] = vert;
     }
@@ -188,26 +479,157 @@ static inline int vert_buffer_next_vert_index(const Vert_Buffer *vb)
 
 static inline void vert_buffer_add_indices(Vert_Buffer *vb, int base, int *indices, int index_count)
 {
+    if (!vb->indices) return;
     for (int i = 0; i < index_count; i++)
     {
-        if (vb->index_count < INDEX_MAX)
+        if (vb->index_count < vb->index_max)
         {
             vb->indices[vb->index_count++] = base + indices[i];
         }
     }
 }
 
-static inline void vert_buffer_draw_call(const Vert_Buffer *vb)
+/*
+ * Room for up to `quad_count` quads at once, for callers that add a great
+ * many: their indices are filled in and the first of their verts returned,
+ * four per quad in the order vb_add_rect uses. `*added` says how many fit.
+ */
+static inline Vert *vert_buffer_add_quads(Vert_Buffer *vb, int quad_count, int *added)
+{
+    *added = 0;
+    if (!vb->verts || !vb->indices) return NULL;
+    int room = (vb->vert_max - vb->vert_count) / 4;
+    if ((vb->index_max - vb->index_count) / 6 < room) room = (vb->index_max - vb->index_count) / 6;
+    if (quad_count > room) quad_count = room;
+
+    unsigned int base = (unsigned int)vb->vert_count;
+    unsigned int *indices = vb->indices + vb->index_count;
+    for (int q = 0; q < quad_count; q++, base += 4, indices += 6)
+    {
+        indices[0] = base;
+        indices[1] = base + 3;
+        indices[2] = base + 1;
+        indices[3] = base + 1;
+        indices[4] = base + 3;
+        indices[5] = base + 2;
+    }
+
+    Vert *verts = vb->verts + vb->vert_count;
+    vb->vert_count += quad_count * 4;
+    vb->index_count += quad_count * 6;
+    *added = quad_count;
+    return verts;
+}
+
+// Ends the frame. Indices start at 0 each frame; the base vertex moves them to the region.
+static inline void vert_buffer_draw_call(Vert_Buffer *vb)
 {
+    trace_begin("vert_buffer_draw_call");
+    gl_ring_end(&vb->ring);
+    vb->verts = NULL;
+    vb->indices = NULL;
+
+    size_t region = gl_ring_offset(&vb->ring);
     glBindVertexArray(vb->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vb->vbo);
-    glBufferData(GL_ARRAY_BUFFER, vert_buffer_max_vert_size(), NULL, GL_DYNAMIC_DRAW);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vert_buffer_vert_size(vb), vb->verts);
+    glDrawElementsBaseVertex(GL_TRIANGLES, vb->index_count, GL_UNSIGNED_INT,
+        (void *)(region + sizeof(Vert) * (size_t)vb->vert_max), (GLint)(region / sizeof(Vert)));
+    gl_ring_fence(&vb->ring);
+    trace_end("vert_buffer_draw_call");
+}
+
+typedef struct {
+    float x, y;
+    float u, v;
+    Col_3f color;
+} Sprite_Vert;
+
+#define SPRITE_VERT_MAX 4096
+#define SPRITE_INDEX_MAX 6144
+
+// Same ring layout as Vert_Buffer.
+typedef struct {
+    Sprite_Vert *verts;
+    int vert_count;
+
+    unsigned int *indices;
+    int index_count;
+
+    GLuint vao;
+    Gl_Ring ring;
+} Sprite_Buffer;
+
+static inline size_t sprite_buffer_region_size()
+{
+    return gl_ring_region_size(sizeof(Sprite_Vert) * SPRITE_VERT_MAX + sizeof(unsigned int) * SPRITE_INDEX_MAX, sizeof(Sprite_Vert));
+}
+
+static inline Sprite_Buffer *sprite_buffer_make()
+{
+    Sprite_Buffer *sb = mem_calloc(1, sizeof(Sprite_Buffer));
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vb->ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, vert_buffer_max_index_size(), NULL, GL_DYNAMIC_DRAW);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, vert_buffer_index_size(vb), vb->indices);
+    glGenVertexArrays(1, &sb->vao);
+    glBindVertexArray(sb->vao);
+    gl_ring_init(&sb->ring, sprite_buffer_region_size());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sb->ring.buffer);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Sprite_Vert), (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Sprite_Vert), (void *)(offsetof(Sprite_Vert, u)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Sprite_Vert), (void *)(offsetof(Sprite_Vert, color)));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+
+    return sb;
+}
 
-    glDrawElements(GL_TRIANGLES, vb->index_count, GL_UNSIGNED_INT, 0);
+static inline void sprite_buffer_clear(Sprite_Buffer *sb)
+{
+    unsigned char *region = gl_ring_begin(&sb->ring);
+    sb->verts = (Sprite_Vert *)region;
+    sb->indices = region ? (unsigned int *)(region + sizeof(Sprite_Vert) * SPRITE_VERT_MAX) : NULL;
+    sb->vert_count = 0;
+    sb->index_count = 0;
+}
+
+static inline void sprite_buffer_free(Sprite_Buffer *sb)
+{
+    gl_ring_free(&sb->ring);
+    glDeleteVertexArrays(1, &sb->vao);
+    mem_free(sb);
 }
 
+// Quads only: 4 verts and 6 indices per call, dropped whole if it doesn't fit.
+static inline void sprite_buffer_add_quad(Sprite_Buffer *sb, Sprite_Vert v0, Sprite_Vert v1, Sprite_Vert v2, Sprite_Vert v3)
+{
+    if (!sb->verts || sb->vert_count + 4 > SPRITE_VERT_MAX || sb->index_count + 6 > SPRITE_INDEX_MAX) return;
+
+    unsigned int base = (unsigned int)sb->vert_count;
+    sb->verts[sb->vert_count++] = v0;
+    sb->verts[sb->vert_count++] = v1;
+    sb->verts[sb->vert_count++] = v2;
+    sb->verts[sb->vert_count++] = v3;
+
+    unsigned int *idx = &sb->indices[sb->index_count];
+    idx[0] = base + 0; idx[1] = base + 3; idx[2] = base + 1;
+    idx[3] = base + 1; idx[4] = base + 3; idx[5] = base + 2;
+    sb->index_count += 6;
+}
+
+// With nothing to draw the region stays open, and the next sprite_buffer_clear reuses it.
+static inline void sprite_buffer_draw_call(Sprite_Buffer *sb, const Texture *tex)
+{
+    if (sb->index_count == 0) return;
+
+    gl_ring_end(&sb->ring);
+    sb->verts = NULL;
+    sb->indices = NULL;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, tex->texture_id);
+
+    size_t region = gl_ring_offset(&sb->ring);
+    glBindVertexArray(sb->vao);
+    glDrawElementsBaseVertex(GL_TRIANGLES, sb->index_count, GL_UNSIGNED_INT,
+        (void *)(region + sizeof(Sprite_Vert) * SPRITE_VERT_MAX), (GLint)(region / sizeof(Sprite_Vert)));
+    gl_ring_fence(&sb->ring);
+}
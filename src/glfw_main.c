@@ -0,0 +1,99 @@
+/*
+ * Standalone GLFW front end: hosts the scene the same way the editor does,
+ * for platforms where the editor isn't available (Linux with Mesa, say).
+ */
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "gl_glue.h"
+#include <GLFW/glfw3.h>
+
+#include "main.c"
+
+static Game_State glfw_state;
+
+static void glfw_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    Platform_Event e = {
+        .kind = PLATFORM_EVENT_KEY,
+        .key = {.key = key, .scancode = scancode, .action = action, .mods = mods},
+    };
+    on_platform_event(&glfw_state, &e);
+}
+
+static void glfw_window_size_callback(GLFWwindow *window, int w, int h)
+{
+    int px_w, px_h;
+    glfwGetFramebufferSize(window, &px_w, &px_h);
+    Platform_Event e = {
+        .kind = PLATFORM_EVENT_WINDOW_RESIZE,
+        .window_resize = {.px_w = px_w, .px_h = px_h, .logical_w = w, .logical_h = h},
+    };
+    on_platform_event(&glfw_state, &e);
+}
+
+int main(int argc, char **argv)
+{
+    if (!glfwInit())
+    {
+        fprintf(stderr, "GLFW: init failed\n");
+        return 1;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+
+    GLFWwindow *window = glfwCreateWindow(256, 512, "Tetris", NULL, NULL);
+    if (!window)
+    {
+        fprintf(stderr, "GLFW: couldn't create a GL 3.3 core window\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(1);
+    glfwSetKeyCallback(window, glfw_key_callback);
+    glfwSetWindowSizeCallback(window, glfw_window_size_callback);
+
+    int w, h, px_w, px_h;
+    glfwGetWindowSize(window, &w, &h);
+    glfwGetFramebufferSize(window, &px_w, &px_h);
+    on_init(&glfw_state, window, (float)w, (float)h, (float)px_w, (float)px_h, false, 0, argc, argv);
+
+    Platform_Timing t = {0};
+    t.prev_frame_time = (float)glfwGetTime();
+    t.last_fps_measurement_time = t.prev_frame_time;
+
+    while (!glfwWindowShouldClose(window))
+    {
+        float now = (float)glfwGetTime();
+        t.prev_prev_frame_time = t.prev_frame_time;
+        t.prev_frame_time = now;
+        t.prev_delta_time = t.prev_frame_time - t.prev_prev_frame_time;
+        t.fps_instant = t.prev_delta_time > 0.0f ? 1.0f / t.prev_delta_time : 0.0f;
+        t.frame_running_count++;
+        t.frame_total_count++;
+        if (now - t.last_fps_measurement_time >= 1.0f)
+        {
+            t.fps_avg = (float)t.frame_running_count / (now - t.last_fps_measurement_time);
+            t.frame_running_count = 0;
+            t.last_fps_measurement_time = now;
+        }
+
+        on_frame(&glfw_state, &t);
+
+        // Undrawn frames aren't swapped, so the last image stays up while the scene sleeps.
+        Platform_Frame_Schedule schedule = on_frame_schedule(&glfw_state);
+        if (schedule.drew) glfwSwapBuffers(window);
+        if (schedule.wait < 0.0f)      glfwWaitEvents();
+        else if (schedule.wait > 0.0f) glfwWaitEventsTimeout(schedule.wait);
+        else                           glfwPollEvents();
+    }
+
+    on_destroy(&glfw_state);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
@@ -20,14 +20,20 @@ void vb_add_rect(Vert_Buffer *vb, Rect rect, Col_3f color)
     vert_buffer_add_indices(vb, index_base, indices, 6);
 }
 
-Block *get_block_at(Game_State *s, int x, int y)
+void sb_add_sprite(Sprite_Buffer *sb, Rect rect, Rect uv, Col_3f color)
 {
-    if (x < 0 || x >= s->tetris_cols ||
-        y < 0 || y >= s->tetris_rows)
-    {
-        return NULL;
-    }
+    float x_min = rect.x;
+    float x_max = rect.x + rect.w;
+    float y_min = rect.y;
+    float y_max = rect.y + rect.h;
+    float u_min = uv.x;
+    float u_max = uv.x + uv.w;
+    float v_min = uv.y;
+    float v_max = uv.y + uv.h;
 
-    return &s->blocks[s->tetris_cols * y + x];
+    sprite_buffer_add_quad(sb,
+        (Sprite_Vert){x_min, y_min, u_min, v_min, color},
+        (Sprite_Vert){x_max, y_min, u_max, v_min, color},
+        (Sprite_Vert){x_max, y_max, u_max, v_max, color},
+        (Sprite_Vert){x_min, y_max, u_min, v_max, color});
 }
-
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tetris.h"
+#include "lockstep.h"
+
+#define LOCKSTEP_INT_ARRAYS(X) \
+    X(x) X(y) X(kind) X(orient) X(height) X(playing) X(lines) X(pieces) X(piece_id_seed)
+
+static size_t lockstep_arena_size(int stride, int rows)
+{
+    size_t ints = arena_align_up(sizeof(int32_t) * (size_t)stride, 64);
+    size_t size = arena_align_up(sizeof(int32_t) * (size_t)(stride * rows), 64);
+    size += arena_align_up(sizeof(int32_t) * (size_t)(stride * PIECE_MAX_ROWS), 64);
+#define LOCKSTEP_COUNT_ARRAY(name) size += ints;
+    LOCKSTEP_INT_ARRAYS(LOCKSTEP_COUNT_ARRAY)
+#undef LOCKSTEP_COUNT_ARRAY
+    size += 2 * arena_align_up(sizeof(uint64_t) * (size_t)stride, 64);
+    return size;
+}
+
+// Every game starts out topped out, including the padding lanes, which stay that way.
+bool lockstep_init(Lockstep_Engine *L, int count, int cols, int rows)
+{
+    memset(L, 0, sizeof(*L));
+    L->count = count;
+    L->stride = (count + LOCKSTEP_LANES - 1) / LOCKSTEP_LANES * LOCKSTEP_LANES;
+    L->cols = cols;
+    L->rows = rows;
+
+    size_t size = lockstep_arena_size(L->stride, rows);
+    if (!arena_init(&L->arena, size))
+    {
+        fprintf(stderr, "Lockstep: couldn't allocate %zu bytes for %d games\n", size, count);
+        return false;
+    }
+
+    L->board = arena_push(&L->arena, sizeof(int32_t) * (size_t)(L->stride * rows), 64);
+    L->piece_rows = arena_push(&L->arena, sizeof(int32_t) * (size_t)(L->stride * PIECE_MAX_ROWS), 64);
+#define LOCKSTEP_PUSH_ARRAY(name) L->name = arena_push(&L->arena, sizeof(int32_t) * (size_t)L->stride, 64);
+    LOCKSTEP_INT_ARRAYS(LOCKSTEP_PUSH_ARRAY)
+#undef LOCKSTEP_PUSH_ARRAY
+    L->rng = arena_push(&L->arena, sizeof(uint64_t) * (size_t)L->stride, 64);
+    L->policy_rng = arena_push(&L->arena, sizeof(uint64_t) * (size_t)L->stride, 64);
+    return true;
+}
+
+void lockstep_free(Lockstep_Engine *L)
+{
+    arena_release(&L->arena);
+    memset(L, 0, sizeof(*L));
+}
+
+// --------------------------------------------------------------------
+
+// piece_fits, on game `g`'s column of the board.
+static bool lockstep_fits(const Lockstep_Engine *L, int g, Piece_Kind kind, Piece_Orient o, int x, int y)
+{
+    const Piece_Spec *spec = piece_spec_get_by_kind(kind);
+    for (int row = 0; row < PIECE_MAX_ROWS; row++)
+    {
+        uint16_t bits = (uint16_t)piece_spec_get_row(spec, o, row);
+        if (!bits) continue;
+        int board_row = y + row;
+        if (board_row < 0 || board_row >= L->rows) return false;
+        uint16_t shifted;
+        if (!piece_shift_row(bits, x, L->cols, &shifted)) return false;
+        if (L->board[board_row * L->stride + g] & shifted) return false;
+    }
+    return true;
+}
+
+// Assumes the piece fits.
+static void lockstep_set_piece(Lockstep_Engine *L, int g, const Piece *p)
+{
+    const Piece_Spec *spec = piece_spec_get_by_kind(p->kind);
+    int height = 0;
+    for (int row = 0; row < PIECE_MAX_ROWS; row++)
+    {
+        uint16_t shifted = 0;
+        uint16_t bits = (uint16_t)piece_spec_get_row(spec, p->orient, row);
+        if (bits)
+        {
+            piece_shift_row(bits, p->x, L->cols, &shifted);
+            height = row + 1;
+        }
+        L->piece_rows[row * L->stride + g] = shifted;
+    }
+    L->x[g] = p->x;
+    L->y[g] = p->y;
+    L->kind[g] = p->kind;
+    L->orient[g] = p->orient;
+    L->height[g] = height;
+}
+
+// generate_new_piece, then the rollout policy's placement if that fits too.
+static void lockstep_spawn(Lockstep_Engine *L, int g)
+{
+    Piece p = {
+        .id = L->piece_id_seed[g]++,
+        .x = 3, .y = 0,
+        .kind = (Piece_Kind)(rng_next(&L->rng[g]) % PIECE_KIND_COUNT),
+        .orient = (Piece_Orient)(rng_next(&L->rng[g]) % PIECE_ORIENT_COUNT)
+    };
+    if (!lockstep_fits(L, g, p.kind, p.orient, p.x, p.y))
+    {
+        L->playing[g] = 0;
+        return;
+    }
+
+    Piece placed;
+    lockstep_pick_pose(&L->policy_rng[g], L->cols, &p, &placed);
+    lockstep_set_piece(L, g, lockstep_fits(L, g, placed.kind, placed.orient, placed.x, placed.y) ? &placed : &p);
+}
+
+void lockstep_start(Lockstep_Engine *L, int g, uint64_t seed, uint64_t policy_seed)
+{
+    for (int row = 0; row < L->rows; row++) L->board[row * L->stride + g] = 0;
+    L->rng[g] = seed;
+    L->policy_rng[g] = policy_seed;
+    L->piece_id_seed[g] = 1;
+    L->lines[g] = 0;
+    L->pieces[g] = 0;
+    L->playing[g] = -1;
+    lockstep_spawn(L, g);
+}
+
+// --------------------------------------------------------------------
+
+// Each lane's piece row for board row `row`, where the piece's top is at `top`; zero outside the piece.
+static inline Lockstep_Vec lockstep_piece_row_at(const Lockstep_Vec p[PIECE_MAX_ROWS], int row, Lockstep_Vec top)
+{
+    Lockstep_Vec rel = row - top;
+    return (p[0] & (rel == 0)) | (p[1] & (rel == 1)) | (p[2] & (rel == 2)) | (p[3] & (rel == 3));
+}
+
+// Board rows any lane's piece could touch with its top at `top`.
+static inline void lockstep_row_span(const Lockstep_Engine *L, Lockstep_Vec top, int *lo, int *hi)
+{
+    int min = top[0], max = top[0];
+    for (int i = 1; i < LOCKSTEP_LANES; i++)
+    {
+        if (top[i] < min) min = top[i];
+        if (top[i] > max) max = top[i];
+    }
+    *lo = min < 0 ? 0 : min;
+    *hi = max + PIECE_MAX_ROWS - 1 < L->rows - 1 ? max + PIECE_MAX_ROWS - 1 : L->rows - 1;
+}
+
+// Board row `rows[i]` of each lane; rows past the floor read as empty, the floor test catches those.
+static inline Lockstep_Vec lockstep_gather_rows(const Lockstep_Engine *L, int b, Lockstep_Vec rows)
+{
+    Lockstep_Vec v;
+    for (int i = 0; i < LOCKSTEP_LANES; i++)
+    {
+        int row = rows[i] < L->rows ? rows[i] : 0;
+        v[i] = rows[i] < L->rows ? L->board[row * L->stride + b + i] : 0;
+    }
+    return v;
+}
+
+/*
+ * Clears full rows in the lanes of vector `b`, bottom-most first like
+ * check_lines. Each pass drops everything above one row per lane with a
+ * per-lane select, so lanes clearing different rows never diverge.
+ */
+static Lockstep_Vec lockstep_clear_lines(Lockstep_Engine *L, int b, int lo, int hi)
+{
+    const int stride = L->stride;
+    const int32_t full_row = (int32_t)((1u << L->cols) - 1);
+    Lockstep_Vec cleared = {0};
+
+    for (int pass = 0; pass < PIECE_MAX_ROWS; pass++)
+    {
+        Lockstep_Vec lowest = {0};
+        lowest -= 1;
+        for (int row = lo; row <= hi; row++)
+        {
+            Lockstep_Vec full = lockstep_load(&L->board[row * stride + b]) == full_row;
+            lowest = (full & row) | (~full & lowest);
+        }
+        Lockstep_Vec found = lowest >= 0;
+        if (!lockstep_any(found)) break;
+        cleared -= found;
+
+        for (int row = hi; row >= 1; row--)
+        {
+            Lockstep_Vec take = row <= lowest;
+            Lockstep_Vec here = lockstep_load(&L->board[row * stride + b]);
+            Lockstep_Vec above = lockstep_load(&L->board[(row - 1) * stride + b]);
+            lockstep_store(&L->board[row * stride + b], (take & above) | (~take & here));
+        }
+        lockstep_store(&L->board[b], lockstep_load(&L->board[b]) & ~found);
+    }
+    return cleared;
+}
+
+/*
+ * One gravity row for every game: move_current_piece_down where the piece
+ * fits a row lower, otherwise commit_piece, check_lines and a new piece.
+ */
+void lockstep_step(Lockstep_Engine *L)
+{
+    const int stride = L->stride;
+
+    for (int b = 0; b < stride; b += LOCKSTEP_LANES)
+    {
+        Lockstep_Vec playing = lockstep_load(&L->playing[b]);
+        if (!lockstep_any(playing)) continue;
+
+        Lockstep_Vec p[PIECE_MAX_ROWS];
+        for (int row = 0; row < PIECE_MAX_ROWS; row++) p[row] = lockstep_load(&L->piece_rows[row * stride + b]);
+        Lockstep_Vec y = lockstep_load(&L->y[b]);
+        Lockstep_Vec below = y + 1;
+
+        Lockstep_Vec hit = {0};
+        for (int row = 0; row < PIECE_MAX_ROWS; row++)
+        {
+            hit |= lockstep_gather_rows(L, b, below + row) & p[row];
+        }
+
+        Lockstep_Vec fits = (hit == 0) & (below + lockstep_load(&L->height[b]) <= L->rows);
+        y -= fits & playing;
+        lockstep_store(&L->y[b], y);
+
+        Lockstep_Vec locks = ~fits & playing;
+        if (!lockstep_any(locks)) continue;
+
+        int lo, hi;
+        lockstep_row_span(L, y, &lo, &hi);
+        for (int row = lo; row <= hi; row++)
+        {
+            Lockstep_Vec board = lockstep_load(&L->board[row * stride + b]);
+            lockstep_store(&L->board[row * stride + b], board | (lockstep_piece_row_at(p, row, y) & locks));
+        }
+
+        Lockstep_Vec cleared = lockstep_clear_lines(L, b, lo, hi);
+        lockstep_store(&L->lines[b], lockstep_load(&L->lines[b]) + cleared);
+        lockstep_store(&L->pieces[b], lockstep_load(&L->pieces[b]) - locks);
+
+        for (int i = 0; i < LOCKSTEP_LANES; i++)
+        {
+            if (locks[i]) lockstep_spawn(L, b + i);
+        }
+    }
+}
+
+// Games still running.
+int lockstep_playing_count(const Lockstep_Engine *L)
+{
+    int playing = 0;
+    for (int g = 0; g < L->count; g++) playing += L->playing[g] != 0;
+    return playing;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "tetris.h"
+#include "pieces.h"
+
+/*
+ * Many games stepped together for Monte Carlo rollouts. State is kept as
+ * structure-of-arrays with the games side by side, so one vector holds the
+ * same field for LOCKSTEP_LANES games and gravity, collision, commit and
+ * line clears run across games rather than within one. Only spawning is
+ * done a game at a time.
+ *
+ * The rules are the engine's own (move_current_piece_down, commit_piece,
+ * check_lines, generate_new_piece); bin/difftest --lockstep checks the two
+ * against each other. Pieces are placed by lockstep_pick_pose as they
+ * spawn and then fall a row per step until they lock.
+ */
+
+// One native vector of int32: AVX2 when the build targets it (NATIVE=1), else SSE2/NEON width.
+#ifdef __AVX2__
+#define LOCKSTEP_LANES 8
+#else
+#define LOCKSTEP_LANES 4
+#endif
+
+typedef int32_t Lockstep_Vec __attribute__((vector_size(LOCKSTEP_LANES * sizeof(int32_t))));
+
+typedef struct {
+    int count;          // Games.
+    int stride;         // count rounded up to whole vectors.
+    int cols, rows;
+    Arena arena;
+
+    int32_t *board;         // [rows][stride] row masks.
+    int32_t *piece_rows;    // [PIECE_MAX_ROWS][stride] the falling piece's rows, shifted to its column.
+    int32_t *x, *y;
+    int32_t *kind, *orient;
+    int32_t *height;        // Rows the piece covers, for the floor test.
+    int32_t *playing;       // -1 while the game runs, 0 once it's topped out.
+    int32_t *lines, *pieces;
+    int32_t *piece_id_seed;
+    uint64_t *rng;          // The engine's piece stream.
+    uint64_t *policy_rng;   // Where pieces get placed.
+} Lockstep_Engine;
+
+static inline Lockstep_Vec lockstep_load(const int32_t *p)
+{
+    Lockstep_Vec v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void lockstep_store(int32_t *p, Lockstep_Vec v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline bool lockstep_any(Lockstep_Vec v)
+{
+    int32_t any = 0;
+    for (int i = 0; i < LOCKSTEP_LANES; i++) any |= v[i];
+    return any != 0;
+}
+
+// Columns a piece spans in an orientation. Frames are anchored top-left, so it starts at column 0.
+static inline int lockstep_piece_width(Piece_Kind kind, Piece_Orient o)
+{
+    const Piece_Spec *spec = piece_spec_get_by_kind(kind);
+    unsigned int cols = 0;
+    for (int row = 0; row < PIECE_MAX_ROWS; row++) cols |= piece_spec_get_row(spec, o, row);
+    return 32 - __builtin_clz(cols);
+}
+
+/*
+ * The rollout policy: a uniformly random orientation and column for a
+ * freshly spawned piece. Kept here so the engine-side mirror in difftest
+ * draws exactly the same placements.
+ */
+static inline void lockstep_pick_pose(uint64_t *policy_rng, int cols, const Piece *spawned, Piece *out)
+{
+    *out = *spawned;
+    out->orient = (Piece_Orient)(rng_next(policy_rng) % PIECE_ORIENT_COUNT);
+    int positions = cols - lockstep_piece_width(spawned->kind, out->orient) + 1;
+    out->x = (int)(rng_next(policy_rng) % (uint64_t)positions);
+}
@@ -1,106 +1,362 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
-#include <OpenGL/gl3.h>
+#include "gl_glue.h"
 #include <GLFW/glfw3.h>
 
-#include "gl_glue.h"
 #include "tetris.h"
 
+#include "tetris_core.c"
+#include "sim.c"
+#include "capture.c"
 #include "tetris.c"
+#include "nn.c"
+#include "ai.c"
+#include "trace.c"
+
+/*
+ * Records to the --trace file, or after a reload to a numbered one beside
+ * it (run.json, then run.1.json, ...), so what came before stays intact.
+ */
+static void scene_trace_start(Game_State *state)
+{
+    char path[sizeof(state->trace_path) + 16];
+    const char *ext = strrchr(state->trace_path, '.');
+    if (state->trace_reloads == 0) snprintf(path, sizeof(path), "%s", state->trace_path);
+    else if (ext) snprintf(path, sizeof(path), "%.*s.%d%s", (int)(ext - state->trace_path), state->trace_path, state->trace_reloads, ext);
+    else snprintf(path, sizeof(path), "%s.%d", state->trace_path, state->trace_reloads);
+
+    state->trace_stop = trace_start(path) ? trace_stop : NULL;
+    if (state->trace_stop) printf("Trace: recording to %s\n", path);
+}
+
+// Ends the recording in the build that started it, whichever that was.
+static void scene_trace_stop(Game_State *state)
+{
+    if (state->trace_stop) state->trace_stop();
+    state->trace_stop = NULL;
+}
 
 void on_init(Game_State *state, GLFWwindow *window, float window_w, float window_h, float window_px_w, float window_px_h, bool is_live_scene, GLuint fbo, int argc, char **argv)
 {
+    game_state_write_header(state);
+
     state->window = window;
     state->w = window_w;
     state->h = window_h;
+    state->is_live_scene = is_live_scene;
+    state->fbo = fbo;
 
     state->tetris_cols = TETRIS_COLS;
     state->tetris_rows = TETRIS_ROWS;
-    state->move_period = MOVE_PERIOD;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!strcmp(argv[i], "--nn") && val)
+        {
+            state->nn = nn_model_load(val);
+            if (state->nn) printf("AI: the bot (B) plays with the network from %s\n", val);
+        }
+        else if (!strcmp(argv[i], "--trace") && val)
+        {
+            snprintf(state->trace_path, sizeof(state->trace_path), "%s", val);
+            scene_trace_start(state);
+        }
+        else if (!strcmp(argv[i], "--redraw-always")) state->redraw.always = true;
+        else if (!strcmp(argv[i], "--redraw-stats"))  state->redraw.stats = true;
+    }
+    state->redraw.dirty = true;
 
     create_shaders(state);
     create_vert_buffer(state);
+    create_particles(state);
+    load_block_atlas(state);
     initialize_game(state);
 }
 
+/*
+ * For a state that can't be migrated: stops the bot thread and the trace
+ * another build started, since they would go on running its code.
+ * Everything else is left alone.
+ */
+static void game_state_abandon(Game_State *s)
+{
+    Ai_Worker **ai = game_state_old_field(s, GAME_STATE_FIELD_ai, sizeof(Ai_Worker *));
+    if (ai && *ai)
+    {
+        ai_worker_stop(*ai);
+        *ai = NULL;
+    }
+
+    void (**stop_trace)(void) = game_state_old_field(s, GAME_STATE_FIELD_trace_stop, sizeof(void (*)(void)));
+    if (stop_trace && *stop_trace)
+    {
+        (*stop_trace)();
+        *stop_trace = NULL;
+    }
+}
+
+// The state a reload found is too small for this build's layout: the scene stays idle until restarted.
+static bool state_abandoned;
+
 void on_reload(Game_State *state)
 {
+    if (state->header.magic == GAME_STATE_MAGIC && !game_state_fits(state))
+    {
+        fprintf(stderr, "Reload: Game_State grew from %u to %zu bytes, more than the host allocated; restart the scene\n",
+            state->header.size, sizeof(Game_State));
+        game_state_abandon(state);
+        state_abandoned = true;
+        return;
+    }
+
+    bool migrated = false;
+    if (!game_state_is_current(state))
+    {
+        migrated = game_state_migrate(state);
+        if (!migrated)
+        {
+            // Written by a build that predates the header: nothing in it can be trusted.
+            fprintf(stderr, "Reload: unknown Game_State layout, starting over\n");
+            memset(state, 0, sizeof(*state));
+            game_state_write_header(state);
+            state->tetris_cols = TETRIS_COLS;
+            state->tetris_rows = TETRIS_ROWS;
+        }
+
+        if (!state->blocks)
+        {
+            initialize_game(state);
+        }
+        else
+        {
+            if (!state->arena.base) game_state_adopt_board(state);
+            if (state->current_piece.id == 0 && !state->is_game_over)
+            {
+                if (!generate_new_piece(state)) state->is_game_over = true;
+            }
+            if (state->stats.level == 0) game_stats_reset(&state->stats);
+            sim_reset(&state->sim, state->stats.level);
+        }
+    }
+
+    // Before the bot restarts, so its new thread joins the new file.
+    if (state->trace_stop)
+    {
+        scene_trace_stop(state);
+        state->trace_reloads++;
+        scene_trace_start(state);
+    }
+
+    if (state->ai)
+    {
+        // The worker thread is still running the previous build's code. After a migration it's stopped
+        // through the fields every build agrees on (see Ai_Worker), and its weights can't be trusted.
+        Ai_Weights weights = migrated ? ai_default_weights() : state->ai->weights;
+        ai_worker_stop(state->ai);
+        state->ai = ai_worker_start(weights, state->nn);
+    }
+
+    // GL objects are cheap to rebuild and pick up any shader or buffer changes.
+    create_shaders(state);
+    create_vert_buffer(state);
+    create_particles(state);
+    load_block_atlas(state);
+    state->redraw.dirty = true;
+}
+
+static double redraw_cpu_seconds(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Whether this frame has to be drawn (see redraw.h); if so, remembers what it shows.
+static bool redraw_needed(Game_State *s)
+{
+    Redraw_State *r = &s->redraw;
+    Redraw_Key key = {
+        .piece = s->current_piece,
+        .pieces = s->stats.pieces,
+        .is_game_over = s->is_game_over,
+        .particles = s->particles ? s->particles->count : 0,
+    };
+    bool keeps_image = s->is_live_scene || r->host_schedules;
+    bool needed = r->dirty || r->always || s->is_capturing || key.particles > 0 || !keeps_image ||
+        !redraw_key_equal(&key, &r->key);
+    if (needed) r->key = key;
+    r->dirty = false;
+    r->drew = needed;
+    return needed;
+}
+
+// --redraw-stats: what on_frame cost over the last few seconds, against drawing every frame.
+static void redraw_stats_frame(Game_State *s, float now, double frame_cpu)
+{
+    Redraw_State *r = &s->redraw;
+    if (r->frames == 0)
+    {
+        r->stats_start = now;
+        r->process_cpu = redraw_cpu_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    }
+    r->frames++;
+    r->frame_cpu += frame_cpu;
+
+    float elapsed = now - r->stats_start;
+    if (elapsed < REDRAW_STATS_PERIOD) return;
+
+    double process_cpu = redraw_cpu_seconds(CLOCK_PROCESS_CPUTIME_ID) - r->process_cpu;
+    double per_draw = r->frames_drawn ? r->draw_cpu / r->frames_drawn : 0.0;
+    double every_frame = r->frame_cpu + per_draw * (r->frames - r->frames_drawn);
+    printf("Redraw: drew %d of %d frames in %.1f s; on_frame %.2f ms CPU/s (drawing all of them: ~%.2f ms/s), process %.1f%% of a core\n",
+        r->frames_drawn, r->frames, elapsed, r->frame_cpu * 1e3 / elapsed, every_frame * 1e3 / elapsed,
+        process_cpu * 100.0 / elapsed);
+    r->frames = r->frames_drawn = 0;
+    r->frame_cpu = r->draw_cpu = 0.0;
 }
 
 void on_frame(Game_State *state, const Platform_Timing *t)
 {
-    glViewport(0, 0, (GLsizei)state->w, (GLsizei)state->h);
+    if (state_abandoned) return;
+
+    long alloc_mark = mem_alloc_count();
+    Redraw_State *r = &state->redraw;
+    double frame_start = r->stats ? redraw_cpu_seconds(CLOCK_THREAD_CPUTIME_ID) : 0.0;
+    trace_begin("on_frame");
 
-    glClearColor(0.1f, 0.2f, 0.1f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    if (state->ai) ai_drive(state->ai, state);
 
-    glUseProgram(state->prog);
-    Mat_4 proj = mat4_proj_ortho(0, state->w, state->h, 0, -1, 1);
+    // Time the host spent waiting for an event wasn't game time.
+    float dt = r->waiting_for_event ? 0.0f : t->prev_delta_time;
+    r->waiting_for_event = false;
 
-    glUniformMatrix4fv(glGetUniformLocation(state->prog, "u_mvp"), 1, GL_FALSE, proj.m);
+    bool was_game_over = state->is_game_over;
+    sim_advance(state, dt);
+    if (state->is_game_over && !was_game_over) print_game_stats(state);
+    emit_lock_particles(state);
 
-    if (!state->is_game_over)
+    if (state->particles && state->particles->count > 0)
     {
-        state->move_timer += t->prev_delta_time;
-        if (state->move_timer >= state->move_period)
+        trace_begin("particles_update");
+        particles_update(state->particles, dt < REDRAW_MAX_WAIT ? dt : REDRAW_MAX_WAIT);
+        trace_end("particles_update");
+    }
+
+    if (redraw_needed(state))
+    {
+        double draw_start = r->stats ? redraw_cpu_seconds(CLOCK_THREAD_CPUTIME_ID) : 0.0;
+        render_frame(state);
+        if (r->stats)
         {
-            state->move_timer -= state->move_period;
-            if (!move_current_piece_down(state))
-            {
-                commit_piece(state, &state->current_piece);
-                check_lines(state);
-                state->move_period = MOVE_PERIOD;
-                state->move_timer = 0.0f;
-                if (!generate_new_piece(state))
-                {
-                    state->is_game_over = true;
-                }
-            }
+            r->draw_cpu += redraw_cpu_seconds(CLOCK_THREAD_CPUTIME_ID) - draw_start;
+            r->frames_drawn++;
         }
     }
+    trace_end("on_frame");
+
+    // Simulation and drawing run entirely out of memory set up at init.
+    MEM_ASSERT_NO_ALLOCS_SINCE(alloc_mark);
+
+    if (state->is_capturing) capture_frame(&state->capture, state->fbo);
+    if (r->stats) redraw_stats_frame(state, t->prev_frame_time, redraw_cpu_seconds(CLOCK_THREAD_CPUTIME_ID) - frame_start);
+}
+
+// For hosts that can sleep between frames: see redraw.h and Platform_Frame_Schedule.
+Platform_Frame_Schedule on_frame_schedule(Game_State *state)
+{
+    if (state_abandoned) return (Platform_Frame_Schedule){.wait = -1.0f};
+
+    Redraw_State *r = &state->redraw;
+    r->host_schedules = true;
+
+    Platform_Frame_Schedule schedule = {.drew = r->drew};
+    if (r->dirty || r->always || state->is_capturing) return schedule;
+    if (state->particles && state->particles->count > 0)
+    {
+        schedule.wait = REDRAW_POLL_WAIT;
+        return schedule;
+    }
 
-    draw(state);
+    uint64_t tick;
+    if (state->is_game_over || !sim_next_event_tick(&state->sim, &tick))
+    {
+        schedule.wait = -1.0f;
+        r->waiting_for_event = true;
+        return schedule;
+    }
+
+    // sim_advance runs tick `tick` once a whole tick's worth of time has built up on top of it.
+    float due = (float)(tick - state->sim.tick + 1) / SIM_TICK_HZ - state->sim.time_accum;
+    float wait_max = state->ai ? REDRAW_POLL_WAIT : REDRAW_MAX_WAIT;
+    schedule.wait = due < 0.0f ? 0.0f : due > wait_max ? wait_max : due;
+    return schedule;
 }
 
 void on_platform_event(Game_State *state, const Platform_Event *e)
 {
+    if (state_abandoned) return;
+
     switch (e->kind)
     {
         case PLATFORM_EVENT_KEY:
         {
+            state->redraw.dirty = true;
             if (e->key.action == GLFW_PRESS && state->is_game_over)
             {
                 initialize_game(state);
                 return;
             }
 
-            if (e->key.key == GLFW_KEY_UP &&
-                (e->key.action == GLFW_PRESS || e->key.action == GLFW_REPEAT))
+            if (e->key.key == GLFW_KEY_F12 && e->key.action == GLFW_PRESS)
             {
-                rotate_current_piece(state);
+                toggle_capture(state, (int)state->w, (int)state->h);
             }
 
-            if ((e->key.key == GLFW_KEY_LEFT || e->key.key == GLFW_KEY_RIGHT) &&
-                (e->key.action == GLFW_PRESS || e->key.action == GLFW_REPEAT))
+            if (e->key.key == GLFW_KEY_T && e->key.action == GLFW_PRESS)
             {
-                slide_current_piece(state, (e->key.key == GLFW_KEY_RIGHT) ? +1 : -1);
+                state->textured_blocks = !state->textured_blocks;
             }
 
-            if (e->key.key == GLFW_KEY_DOWN)
+            if (e->key.key == GLFW_KEY_B && e->key.action == GLFW_PRESS)
             {
-                if (e->key.action == GLFW_PRESS)
+                if (state->ai)
                 {
-                    state->move_period = MOVE_PERIOD_FAST;
-                    state->move_timer = state->move_period;
+                    ai_worker_stop(state->ai);
+                    state->ai = NULL;
                 }
-                else if (e->key.action == GLFW_RELEASE)
+                else
                 {
-                    state->move_period = MOVE_PERIOD;
-                    state->move_timer = 0.0f;
+                    state->ai = ai_worker_start(ai_default_weights(), state->nn);
                 }
             }
+
+            // Repeat is handled by the simulation (DAS/ARR), so the OS's own is ignored.
+            if (e->key.action == GLFW_PRESS || e->key.action == GLFW_RELEASE)
+            {
+                bool down = e->key.action == GLFW_PRESS;
+                switch (e->key.key)
+                {
+                    case GLFW_KEY_LEFT:  sim_queue_input(&state->sim, SIM_INPUT_LEFT, down); break;
+                    case GLFW_KEY_RIGHT: sim_queue_input(&state->sim, SIM_INPUT_RIGHT, down); break;
+                    case GLFW_KEY_DOWN:  sim_queue_input(&state->sim, SIM_INPUT_SOFT_DROP, down); break;
+                    case GLFW_KEY_SPACE: sim_queue_input(&state->sim, SIM_INPUT_HARD_DROP, down); break;
+                    case GLFW_KEY_UP:
+                    case GLFW_KEY_X:     sim_queue_input(&state->sim, SIM_INPUT_ROTATE_CW, down); break;
+                    case GLFW_KEY_Z:     sim_queue_input(&state->sim, SIM_INPUT_ROTATE_CCW, down); break;
+                    case GLFW_KEY_A:     sim_queue_input(&state->sim, SIM_INPUT_ROTATE_180, down); break;
+                    default: break;
+                }
+            }
+        } break;
+        case PLATFORM_EVENT_WINDOW_RESIZE:
+        {
+            state->w = (float)e->window_resize.logical_w;
+            state->h = (float)e->window_resize.logical_h;
+            state->redraw.dirty = true;
         } break;
         default: break;
     }
@@ -108,5 +364,11 @@ void on_platform_event(Game_State *state, const Platform_Event *e)
 
 void on_destroy(Game_State *state)
 {
-    free(state->blocks);
+    if (state_abandoned) return;
+    if (state->ai) ai_worker_stop(state->ai);
+    if (state->is_capturing) capture_end(&state->capture);
+    scene_trace_stop(state);
+    particle_pool_free(state->particles);
+    nn_model_free(state->nn);
+    free_game(state);
 }
@@ -0,0 +1,197 @@
+/*
+ * Bot-vs-bot versus matches on the headless core, spread over all cores.
+ * Match N is always played from the same seed, so the totals (and the
+ * checksum over every match's outcome) don't depend on the thread count.
+ *
+ *   bin/match_runner [--matches N] [--max-pieces N] [--threads N] [--seed N]
+ *                    [--weights A,B]
+ *
+ * --weights picks each player's bot: "default" for ai_default_weights(),
+ * or a tuner checkpoint to play its best weights. Both default otherwise.
+ */
+
+#define TETRIS_HEADLESS
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tetris.h"
+#include "ai.h"
+#include "versus.h"
+
+#include "tetris_core.c"
+#include "nn.c"
+#include "ai.c"
+#include "versus.c"
+
+typedef struct {
+    int matches;
+    int max_pieces;
+    int threads;
+    uint64_t base_seed;
+    Ai_Weights weights[VERSUS_PLAYERS];
+
+    _Atomic int next_match;
+    _Atomic int results[VERSUS_RESULT_DRAW + 1];
+    _Atomic long pieces;
+    _Atomic long lines;
+    _Atomic long garbage;
+    _Atomic uint64_t checksum;
+} Match_Job;
+
+static double match_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void *match_worker(void *arg)
+{
+    Match_Job *job = arg;
+    Versus_Match *m = calloc(1, sizeof(*m));
+
+    for (;;)
+    {
+        int match = atomic_fetch_add_explicit(&job->next_match, 1, memory_order_relaxed);
+        if (match >= job->matches) break;
+
+        uint64_t seed_rng = job->base_seed + (uint64_t)match;
+        versus_match_init(m, rng_next(&seed_rng));
+        Versus_Result result = versus_match_play(m, job->weights, job->max_pieces);
+
+        long lines = 0, garbage = 0;
+        for (int i = 0; i < VERSUS_PLAYERS; i++)
+        {
+            lines += m->lines[i];
+            garbage += m->garbage_received[i];
+        }
+
+        // Order-independent, so it's the same however matches land on threads.
+        uint64_t outcome = ((uint64_t)match << 40) ^ ((uint64_t)m->pieces << 8) ^ (uint64_t)result ^ ((uint64_t)garbage << 24);
+        atomic_fetch_add_explicit(&job->checksum, rng_next(&outcome), memory_order_relaxed);
+
+        atomic_fetch_add_explicit(&job->results[result], 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&job->pieces, (long)m->pieces * VERSUS_PLAYERS, memory_order_relaxed);
+        atomic_fetch_add_explicit(&job->lines, lines, memory_order_relaxed);
+        atomic_fetch_add_explicit(&job->garbage, garbage, memory_order_relaxed);
+    }
+
+    versus_match_free(m);
+    free(m);
+    return NULL;
+}
+
+// The best weights in a tuner checkpoint: its "best <fitness> <weights...>" line.
+static bool match_load_checkpoint_weights(const char *path, Ai_Weights *out)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        fprintf(stderr, "Match: couldn't open %s\n", path);
+        return false;
+    }
+
+    char line[1024];
+    bool ok = false;
+    while (!ok && fgets(line, sizeof(line), f))
+    {
+        if (strncmp(line, "best ", 5)) continue;
+        char *p = line + 5, *end;
+        strtof(p, &end);
+        ok = end != p;
+        for (int i = 0; ok && i < AI_FEATURE_COUNT; i++)
+        {
+            p = end;
+            out->w[i] = strtof(p, &end);
+            ok = end != p;
+        }
+        break;
+    }
+    fclose(f);
+    if (!ok) fprintf(stderr, "Match: no best weights in %s\n", path);
+    return ok;
+}
+
+// "A,B", each "default" or a tuner checkpoint.
+static bool match_parse_weights(char *spec, Ai_Weights out[VERSUS_PLAYERS], const char *names[VERSUS_PLAYERS])
+{
+    char *comma = strchr(spec, ',');
+    if (!comma) return false;
+    *comma = 0;
+    names[0] = spec;
+    names[1] = comma + 1;
+    for (int i = 0; i < VERSUS_PLAYERS; i++)
+    {
+        if (!strcmp(names[i], "default")) out[i] = ai_default_weights();
+        else if (!match_load_checkpoint_weights(names[i], &out[i])) return false;
+    }
+    return true;
+}
+
+static void match_usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [--matches N] [--max-pieces N] [--threads N] [--seed N]\n"
+        "          [--weights A,B]  (each default or a tuner checkpoint)\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    Match_Job job = {
+        .matches = 1000,
+        .max_pieces = 1000,
+        .threads = cpus > 0 ? (int)cpus : 1,
+        .base_seed = 1,
+        .weights = {ai_default_weights(), ai_default_weights()},
+    };
+    const char *weight_names[VERSUS_PLAYERS] = {"default", "default"};
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!val) { match_usage(argv[0]); return 1; }
+
+        if      (!strcmp(arg, "--matches"))    job.matches = atoi(val);
+        else if (!strcmp(arg, "--max-pieces")) job.max_pieces = atoi(val);
+        else if (!strcmp(arg, "--threads"))    job.threads = atoi(val);
+        else if (!strcmp(arg, "--seed"))       job.base_seed = strtoull(val, NULL, 10);
+        else if (!strcmp(arg, "--weights"))
+        {
+            if (!match_parse_weights(argv[i + 1], job.weights, weight_names)) { match_usage(argv[0]); return 1; }
+        }
+        else { match_usage(argv[0]); return 1; }
+        i++;
+    }
+
+    if (job.matches < 1 || job.max_pieces < 1 || job.threads < 1)
+    {
+        match_usage(argv[0]);
+        return 1;
+    }
+
+    printf("player 0: %s weights, player 1: %s weights\n", weight_names[0], weight_names[1]);
+    double start = match_now();
+    pthread_t threads[256];
+    int thread_count = job.threads < 256 ? job.threads : 256;
+    for (int i = 0; i < thread_count; i++) pthread_create(&threads[i], NULL, match_worker, &job);
+    for (int i = 0; i < thread_count; i++) pthread_join(threads[i], NULL);
+    double elapsed = match_now() - start;
+
+    printf("%d matches on %d threads: %d-%d, %d drawn\n", job.matches, thread_count,
+        atomic_load(&job.results[VERSUS_RESULT_WIN_0]), atomic_load(&job.results[VERSUS_RESULT_WIN_1]),
+        atomic_load(&job.results[VERSUS_RESULT_DRAW]));
+    printf("%ld pieces, %ld lines, %ld garbage rows landed, checksum %016llx\n",
+        atomic_load(&job.pieces), atomic_load(&job.lines), atomic_load(&job.garbage),
+        (unsigned long long)atomic_load(&job.checksum));
+    printf("%.2fs: %.1f matches/s, %.0f pieces/s\n", elapsed, (double)job.matches / elapsed,
+        (double)atomic_load(&job.pieces) / elapsed);
+    return 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Heap wrappers for engine code. Debug builds count allocations per
+ * thread, so hot paths can assert they haven't allocated since a mark:
+ *
+ *   long mark = mem_alloc_count();
+ *   ... simulate, draw ...
+ *   MEM_ASSERT_NO_ALLOCS_SINCE(mark);
+ *
+ * Only allocations made through these are seen; the GL driver's aren't.
+ */
+#ifndef NDEBUG
+static _Thread_local long mem_thread_alloc_count;
+#endif
+
+static inline long mem_alloc_count()
+{
+#ifndef NDEBUG
+    return mem_thread_alloc_count;
+#else
+    return 0;
+#endif
+}
+
+static inline void *mem_alloc(size_t size)
+{
+#ifndef NDEBUG
+    mem_thread_alloc_count++;
+#endif
+    return malloc(size);
+}
+
+static inline void *mem_calloc(size_t count, size_t size)
+{
+#ifndef NDEBUG
+    mem_thread_alloc_count++;
+#endif
+    return calloc(count, size);
+}
+
+static inline void mem_free(void *p)
+{
+    free(p);
+}
+
+#define MEM_ASSERT_NO_ALLOCS_SINCE(mark) assert(mem_alloc_count() == (mark) && "allocated on a steady-state path")
+
+// --------------------------------------------------------------------
+
+// One block carved up front to back; only ever reset as a whole.
+typedef struct {
+    unsigned char *base;
+    size_t size;
+    size_t used;
+} Arena;
+
+static inline size_t arena_align_up(size_t n, size_t align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+static inline bool arena_init(Arena *a, size_t size)
+{
+    a->base = mem_alloc(size);
+    a->size = a->base ? size : 0;
+    a->used = 0;
+    return a->base != NULL;
+}
+
+static inline void arena_release(Arena *a)
+{
+    mem_free(a->base);
+    a->base = NULL;
+    a->size = 0;
+    a->used = 0;
+}
+
+static inline void arena_reset(Arena *a)
+{
+    a->used = 0;
+}
+
+// Zeroed memory from the arena, or NULL if it's out of room.
+static inline void *arena_push(Arena *a, size_t size, size_t align)
+{
+    size_t at = arena_align_up(a->used, align);
+    if (at + size > a->size) return NULL;
+    a->used = at + size;
+    memset(a->base + at, 0, size);
+    return a->base + at;
+}
@@ -0,0 +1,142 @@
+#include <string.h>
+
+#include "movegen.h"
+
+// Positions where the piece fits in each orientation; rows past the floor are solid.
+static void movegen_fit_maps(const uint16_t *board, int cols, int rows, Piece_Kind kind,
+                             uint32_t fits[PIECE_ORIENT_COUNT][MOVEGEN_MAX_ROWS])
+{
+    const Piece_Spec *spec = piece_spec_get_by_kind(kind);
+    const uint32_t in_board = (1u << cols) - 1;
+    int first_filled = 0;
+    while (first_filled < rows && !board[first_filled]) first_filled++;
+
+    for (int o = 0; o < PIECE_ORIENT_COUNT; o++)
+    {
+        // Over empty rows the piece fits wherever it's inside the walls.
+        uint32_t open = in_board;
+        for (unsigned int bits = piece_spec_get_mask(spec, (Piece_Orient)o); bits; bits &= bits - 1)
+        {
+            open &= in_board >> (__builtin_ctz(bits) % PIECE_MAX_COLS);
+        }
+
+        for (int y = 0; y < rows; y++)
+        {
+            if (y + PIECE_MAX_ROWS <= first_filled) { fits[o][y] = open; continue; }
+
+            uint32_t f = in_board;
+            for (int row = 0; row < PIECE_MAX_ROWS && f; row++)
+            {
+                unsigned int bits = piece_spec_get_row(spec, (Piece_Orient)o, row);
+                if (!bits) continue;
+                if (y + row >= rows) { f = 0; break; }
+
+                // Walls count as filled, so a piece hanging over the edge never fits.
+                uint32_t free_cells = ~(uint32_t)board[y + row] & in_board;
+                for (; bits; bits &= bits - 1) f &= free_cells >> __builtin_ctz(bits);
+            }
+            fits[o][y] = f;
+        }
+    }
+}
+
+// Spreads `r` sideways through the runs of `f` it touches, up to 15 columns each way.
+static inline uint32_t movegen_fill(uint32_t r, uint32_t f)
+{
+    uint32_t left = r, right = r, pl = f, pr = f;
+    left |= pl & (left << 1);   pl &= pl << 1;      right |= pr & (right >> 1); pr &= pr >> 1;
+    left |= pl & (left << 2);   pl &= pl << 2;      right |= pr & (right >> 2); pr &= pr >> 2;
+    left |= pl & (left << 4);   pl &= pl << 4;      right |= pr & (right >> 4); pr &= pr >> 4;
+    left |= pl & (left << 8);                       right |= pr & (right >> 8);
+    return left | right;
+}
+
+static inline uint32_t movegen_shift(uint32_t m, int dx)
+{
+    return dx >= 0 ? m << dx : m >> -dx;
+}
+
+// Orientation that shares this one's shape, or itself.
+static inline int movegen_canonical_orient(const Piece_Spec *spec, int o)
+{
+    for (int first = 0; first < o; first++)
+    {
+        if (spec->masks[first] == spec->masks[o]) return first;
+    }
+    return o;
+}
+
+/*
+ * Fills `out` with every placement reachable from `spawn`, which must fit.
+ * Returns how many there are.
+ */
+int movegen_locks(const uint16_t *board, int cols, int rows, const Piece *spawn, Movegen_Locks *out)
+{
+    uint32_t fits[PIECE_ORIENT_COUNT][MOVEGEN_MAX_ROWS];
+    uint32_t reach[PIECE_ORIENT_COUNT][MOVEGEN_MAX_ROWS];
+    movegen_fit_maps(board, cols, rows, spawn->kind, fits);
+    memset(reach, 0, sizeof(reach));
+    reach[spawn->orient][spawn->y] = 1u << spawn->x;
+
+    // Rows whose reach grew, per orientation, taken lowest row first. Turns can kick a piece
+    // upwards, so a row can come back after it's been done; `done` keeps it to the new positions.
+    uint32_t done[PIECE_ORIENT_COUNT][MOVEGEN_MAX_ROWS];
+    uint32_t dirty[PIECE_ORIENT_COUNT] = {0};
+    memset(done, 0, sizeof(done));
+    dirty[spawn->orient] = 1u << spawn->y;
+    for (uint32_t any; (any = dirty[0] | dirty[1] | dirty[2] | dirty[3]);)
+    {
+        int y = __builtin_ctz(any);
+        for (int o = 0; o < PIECE_ORIENT_COUNT; o++)
+        {
+            if (!(dirty[o] & (1u << y))) continue;
+            dirty[o] &= ~(1u << y);
+
+            uint32_t r = movegen_fill(reach[o][y], fits[o][y]);
+            uint32_t fresh = r & ~done[o][y];
+            reach[o][y] = r;
+            done[o][y] = r;
+
+            if (y + 1 < rows)
+            {
+                uint32_t down = fresh & fits[o][y + 1];
+                if (down & ~reach[o][y + 1]) { reach[o][y + 1] |= down; dirty[o] |= 1u << (y + 1); }
+            }
+
+            for (int rot = PIECE_ROTATE_CW; rot <= PIECE_ROTATE_CCW; rot++)
+            {
+                int to = (o + rot) & (PIECE_ORIENT_COUNT - 1);
+                const Piece_Kick_List *kicks = piece_kicks_get(spawn->kind, (Piece_Orient)o, (Piece_Rotation)rot);
+                // Each position takes the first kick that fits, like piece_try_rotate.
+                uint32_t waiting = fresh;
+                for (int i = 0; i < kicks->count && waiting; i++)
+                {
+                    int dx = kicks->tests[i].x, ty = y + kicks->tests[i].y;
+                    if (ty < 0 || ty >= rows) continue;
+                    uint32_t hit = waiting & movegen_shift(fits[to][ty], -dx);
+                    if (!hit) continue;
+                    waiting &= ~hit;
+                    uint32_t moved = movegen_shift(hit, dx);
+                    if (moved & ~reach[to][ty]) { reach[to][ty] |= moved; dirty[to] |= 1u << ty; }
+                }
+            }
+        }
+    }
+
+    const Piece_Spec *spec = piece_spec_get_by_kind(spawn->kind);
+    memset(out, 0, sizeof(*out));
+    for (int o = 0; o < PIECE_ORIENT_COUNT; o++)
+    {
+        int canonical = movegen_canonical_orient(spec, o);
+        for (int y = 0; y < rows; y++)
+        {
+            uint32_t below = y + 1 < rows ? fits[o][y + 1] : 0;
+            out->at[canonical][y] |= reach[o][y] & ~below;
+        }
+    }
+    for (int o = 0; o < PIECE_ORIENT_COUNT; o++)
+    {
+        for (int y = 0; y < rows; y++) out->count += __builtin_popcount(out->at[o][y]);
+    }
+    return out->count;
+}
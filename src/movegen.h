@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "common.h"
+#include "pieces.h"
+
+/*
+ * Every placement a piece can reach from where it spawned, using the
+ * engine's moves: slides, soft drops and turns with their kicks (see
+ * slide_current_piece, move_current_piece_down, rotate_current_piece).
+ *
+ * Positions are handled a row at a time as bitboards: bit x of
+ * fits[o][y] is set if the piece fits with its top-left at (x, y) in
+ * orientation o. Reachability is a flood fill over those masks; slides
+ * and drops are shifts, and a turn applies each kick to all positions
+ * still waiting on one. bin/perft checks the result against the engine.
+ */
+
+#define MOVEGEN_MAX_ROWS 32
+
+/*
+ * Where the piece can lock, as positions that can't move down. Placements
+ * that cover the same cells from different orientations (an I turned
+ * 180, say) are counted once, under the first orientation with that shape.
+ */
+typedef struct {
+    uint32_t at[PIECE_ORIENT_COUNT][MOVEGEN_MAX_ROWS];
+    int count;
+} Movegen_Locks;
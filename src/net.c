@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tetris.h"
+#include "net.h"
+
+bool net_server_init(Net_Server *srv, int max_sessions, uint64_t seed)
+{
+    memset(srv, 0, sizeof(*srv));
+    srv->sessions = mem_calloc((size_t)max_sessions, sizeof(srv->sessions[0]));
+    srv->free_slots = mem_alloc(sizeof(srv->free_slots[0]) * (size_t)max_sessions);
+    if (!srv->sessions || !srv->free_slots)
+    {
+        fprintf(stderr, "Server: couldn't allocate %d sessions\n", max_sessions);
+        mem_free(srv->sessions);
+        mem_free(srv->free_slots);
+        return false;
+    }
+
+    srv->session_cap = max_sessions;
+    for (int i = 0; i < max_sessions; i++) srv->free_slots[i] = max_sessions - 1 - i;
+    srv->free_count = max_sessions;
+    srv->seed_rng = seed;
+    return true;
+}
+
+void net_server_close_session(Net_Server *srv, int i)
+{
+    Net_Session *sess = &srv->sessions[i];
+    if (!sess->open) return;
+
+    free_game(&sess->game);
+    memset(sess, 0, sizeof(*sess));
+    srv->free_slots[srv->free_count++] = i;
+    srv->session_count--;
+}
+
+void net_server_free(Net_Server *srv)
+{
+    for (int i = 0; i < srv->session_cap; i++) net_server_close_session(srv, i);
+    mem_free(srv->sessions);
+    mem_free(srv->free_slots);
+}
+
+// Returns the new session's index, or -1 if the server is full.
+int net_server_open_session(Net_Server *srv, int fd)
+{
+    if (srv->free_count == 0) return -1;
+
+    int i = srv->free_slots[--srv->free_count];
+    Net_Session *sess = &srv->sessions[i];
+    memset(sess, 0, sizeof(*sess));
+    sess->open = true;
+    sess->fd = fd;
+    srv->session_count++;
+    return i;
+}
+
+// --------------------------------------------------------------------
+
+static void net_pack_row(Game_State *g, int row, uint8_t out[NET_ROW_BYTES])
+{
+    uint16_t mask = g->row_masks[row];
+    memset(out, 0, NET_ROW_BYTES);
+    out[0] = (uint8_t)mask;
+    out[1] = (uint8_t)(mask >> 8);
+    for (int col = 0; col < g->tetris_cols; col++)
+    {
+        if (!(mask & (1u << col))) continue;
+        uint8_t kind = (uint8_t)(g->blocks[row * g->tetris_cols + col].piece_kind & 0xF);
+        out[2 + col / 2] |= (uint8_t)(kind << ((col & 1) * 4));
+    }
+}
+
+// Appends whatever changed since the last delta. False if it didn't fit.
+static bool net_session_write_delta(Net_Session *sess)
+{
+    Game_State *g = &sess->game;
+
+    bool piece_changed = memcmp(&g->current_piece, &sess->sent_piece, sizeof(Piece)) != 0;
+    bool over_changed = g->is_game_over != sess->sent_game_over;
+
+    // The board only changes when a piece locks, and then a new one spawns.
+    uint8_t dirty[TETRIS_ROWS];
+    uint8_t packed[TETRIS_ROWS][NET_ROW_BYTES];
+    int dirty_count = 0;
+    if (g->current_piece.id != sess->sent_board_piece_id || over_changed)
+    {
+        for (int row = 0; row < g->tetris_rows; row++)
+        {
+            net_pack_row(g, row, packed[dirty_count]);
+            if (memcmp(packed[dirty_count], sess->sent_rows[row], NET_ROW_BYTES) != 0) dirty[dirty_count++] = (uint8_t)row;
+        }
+    }
+
+    if (!piece_changed && !over_changed && dirty_count == 0)
+    {
+        sess->sent_board_piece_id = g->current_piece.id;
+        return true;
+    }
+
+    Net_Writer w = {.data = sess->out, .len = sess->out_len, .cap = NET_OUT_CAP};
+    int frame = net_begin_frame(&w, NET_MSG_DELTA);
+    net_put_u32(&w, (uint32_t)g->sim.tick);
+    net_put_u8(&w, (uint8_t)((piece_changed ? NET_DELTA_PIECE : 0) | (g->is_game_over ? NET_DELTA_GAME_OVER : 0)));
+    if (piece_changed)
+    {
+        const Piece *p = &g->current_piece;
+        net_put_u8(&w, (uint8_t)(int8_t)p->x);
+        net_put_u8(&w, (uint8_t)(int8_t)p->y);
+        net_put_u8(&w, (uint8_t)((p->kind << 4) | (p->orient & 0xF)));
+        net_put_u32(&w, (uint32_t)p->id);
+    }
+    net_put_u8(&w, (uint8_t)dirty_count);
+    for (int i = 0; i < dirty_count; i++)
+    {
+        net_put_u8(&w, dirty[i]);
+        net_put_bytes(&w, packed[i], NET_ROW_BYTES);
+    }
+    net_end_frame(&w, frame);
+    if (w.overflow) return false;
+
+    sess->out_len = w.len;
+    sess->sent_piece = g->current_piece;
+    sess->sent_game_over = g->is_game_over;
+    sess->sent_board_piece_id = g->current_piece.id;
+    for (int i = 0; i < dirty_count; i++) memcpy(sess->sent_rows[dirty[i]], packed[i], NET_ROW_BYTES);
+    return true;
+}
+
+static bool net_session_start(Net_Server *srv, int i, uint64_t seed)
+{
+    Net_Session *sess = &srv->sessions[i];
+    Game_State *g = &sess->game;
+    if (seed == 0) seed = rng_next(&srv->seed_rng);
+
+    g->tetris_cols = TETRIS_COLS;
+    g->tetris_rows = TETRIS_ROWS;
+    initialize_game_with_seed(g, seed);
+    sess->joined = true;
+
+    // Forget what the client has, so the next delta carries the whole board.
+    memset(&sess->sent_piece, 0, sizeof(sess->sent_piece));
+    memset(sess->sent_rows, 0, sizeof(sess->sent_rows));
+    sess->sent_game_over = false;
+    sess->sent_board_piece_id = -1;
+
+    Net_Writer w = {.data = sess->out, .len = sess->out_len, .cap = NET_OUT_CAP};
+    int frame = net_begin_frame(&w, NET_MSG_WELCOME);
+    net_put_u32(&w, (uint32_t)i);
+    net_put_u8(&w, (uint8_t)g->tetris_cols);
+    net_put_u8(&w, (uint8_t)g->tetris_rows);
+    net_put_u64(&w, seed);
+    net_end_frame(&w, frame);
+    if (w.overflow) return false;
+    sess->out_len = w.len;
+    return true;
+}
+
+static bool net_session_handle(Net_Server *srv, int i, Net_Reader *r)
+{
+    Net_Session *sess = &srv->sessions[i];
+    uint8_t type = net_get_u8(r);
+
+    switch (type)
+    {
+        case NET_MSG_HELLO:
+        {
+            uint64_t seed = net_get_u64(r);
+            if (r->error) return false;
+            return net_session_start(srv, i, seed);
+        }
+        case NET_MSG_INPUT:
+        {
+            uint8_t input = net_get_u8(r);
+            uint8_t down = net_get_u8(r);
+            if (r->error || !sess->joined || input >= SIM_INPUT_COUNT) return false;
+            // A full queue means the client is flooding; extra input is dropped.
+            sim_queue_input(&sess->game.sim, (Sim_Input)input, down != 0);
+            return true;
+        }
+        case NET_MSG_RESTART:
+        {
+            if (!sess->joined) return false;
+            if (sess->game.is_game_over) return net_session_start(srv, i, 0);
+            return true;
+        }
+        default: return false;
+    }
+}
+
+/*
+ * Feeds bytes read from session `i`'s connection. Returns false on a
+ * protocol error, after which the transport should drop the connection.
+ */
+bool net_server_receive(Net_Server *srv, int i, const uint8_t *data, int len)
+{
+    Net_Session *sess = &srv->sessions[i];
+    srv->bytes_in += (uint64_t)len;
+
+    while (len > 0)
+    {
+        int n = NET_IN_CAP - sess->in_len;
+        if (n > len) n = len;
+        memcpy(sess->in + sess->in_len, data, (size_t)n);
+        sess->in_len += n;
+        data += n;
+        len -= n;
+
+        int at = 0;
+        while (sess->in_len - at >= 2)
+        {
+            int frame_len = sess->in[at] | (sess->in[at + 1] << 8);
+            if (frame_len == 0 || frame_len > NET_IN_CAP - 2) return false;
+            if (sess->in_len - at - 2 < frame_len) break;
+
+            Net_Reader r = {.data = sess->in + at + 2, .len = frame_len};
+            if (!net_session_handle(srv, i, &r)) return false;
+            at += 2 + frame_len;
+        }
+        memmove(sess->in, sess->in + at, (size_t)(sess->in_len - at));
+        sess->in_len -= at;
+    }
+    return true;
+}
+
+// One simulation tick for every game, then a delta for every client that needs one.
+void net_server_tick(Net_Server *srv)
+{
+    for (int i = 0; i < srv->session_cap; i++)
+    {
+        Net_Session *sess = &srv->sessions[i];
+        if (!sess->joined || sess->dropped) continue;
+
+        sim_step(&sess->game);
+        int before = sess->out_len;
+        if (!net_session_write_delta(sess)) sess->dropped = true;
+        srv->bytes_out += (uint64_t)(sess->out_len - before);
+    }
+}
+
+// The transport wrote `n` bytes of the session's output.
+void net_session_consume_output(Net_Session *sess, int n)
+{
+    memmove(sess->out, sess->out + n, (size_t)(sess->out_len - n));
+    sess->out_len -= n;
+}
+
+// --------------------------------------------------------------------
+
+static bool net_view_apply(Net_View *v, Net_Reader *r)
+{
+    uint8_t type = net_get_u8(r);
+    switch (type)
+    {
+        case NET_MSG_WELCOME:
+        {
+            memset(v, 0, sizeof(*v));
+            v->session = net_get_u32(r);
+            v->cols = net_get_u8(r);
+            v->rows = net_get_u8(r);
+            net_get_u64(r);
+            return !r->error && v->cols <= TETRIS_COLS && v->rows <= TETRIS_ROWS;
+        }
+        case NET_MSG_DELTA:
+        {
+            v->tick = net_get_u32(r);
+            uint8_t flags = net_get_u8(r);
+            v->is_game_over = (flags & NET_DELTA_GAME_OVER) != 0;
+            if (flags & NET_DELTA_PIECE)
+            {
+                v->piece.x = (int8_t)net_get_u8(r);
+                v->piece.y = (int8_t)net_get_u8(r);
+                uint8_t kind_orient = net_get_u8(r);
+                v->piece.kind = (Piece_Kind)(kind_orient >> 4);
+                v->piece.orient = (Piece_Orient)(kind_orient & 0xF);
+                v->piece.id = (int)net_get_u32(r);
+            }
+
+            int count = net_get_u8(r);
+            for (int i = 0; i < count && !r->error; i++)
+            {
+                int row = net_get_u8(r);
+                uint8_t packed[NET_ROW_BYTES] = {0};
+                net_get_bytes(r, packed, NET_ROW_BYTES);
+                if (r->error || row >= v->rows) return false;
+
+                v->row_masks[row] = (uint16_t)(packed[0] | (packed[1] << 8));
+                for (int col = 0; col < v->cols; col++)
+                {
+                    v->kinds[row][col] = (uint8_t)((packed[2 + col / 2] >> ((col & 1) * 4)) & 0xF);
+                }
+            }
+            return !r->error;
+        }
+        default: return false;
+    }
+}
+
+// Client side: applies every whole frame in `data`. Returns bytes consumed, or -1 on a bad frame.
+int net_view_receive(Net_View *v, const uint8_t *data, int len)
+{
+    int at = 0;
+    while (len - at >= 2)
+    {
+        int frame_len = data[at] | (data[at + 1] << 8);
+        if (frame_len == 0 || frame_len > NET_MAX_FRAME) return -1;
+        if (len - at - 2 < frame_len) break;
+
+        Net_Reader r = {.data = data + at + 2, .len = frame_len};
+        if (!net_view_apply(v, &r)) return -1;
+        at += 2 + frame_len;
+    }
+    return at;
+}
+
+// Frames a client sends. `out` needs room for 16 bytes.
+int net_write_hello(uint8_t *out, uint64_t seed)
+{
+    Net_Writer w = {.data = out, .cap = 16};
+    int frame = net_begin_frame(&w, NET_MSG_HELLO);
+    net_put_u64(&w, seed);
+    net_end_frame(&w, frame);
+    return w.len;
+}
+
+int net_write_input(uint8_t *out, Sim_Input input, bool down)
+{
+    Net_Writer w = {.data = out, .cap = 16};
+    int frame = net_begin_frame(&w, NET_MSG_INPUT);
+    net_put_u8(&w, (uint8_t)input);
+    net_put_u8(&w, down ? 1 : 0);
+    net_end_frame(&w, frame);
+    return w.len;
+}
+
+int net_write_restart(uint8_t *out)
+{
+    Net_Writer w = {.data = out, .cap = 16};
+    int frame = net_begin_frame(&w, NET_MSG_RESTART);
+    net_end_frame(&w, frame);
+    return w.len;
+}
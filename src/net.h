@@ -0,0 +1,185 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "tetris.h"
+
+/*
+ * Wire protocol between bin/server and its clients. Every frame is
+ *
+ *   u16 length (of what follows), u8 type, payload
+ *
+ * with all integers little-endian.
+ *
+ * Client to server:
+ *   NET_MSG_HELLO    u64 seed (0: server picks)        -> NET_MSG_WELCOME
+ *   NET_MSG_INPUT    u8 Sim_Input, u8 down
+ *   NET_MSG_RESTART  (empty) only honoured after game over
+ *
+ * Server to client:
+ *   NET_MSG_WELCOME  u32 session, u8 cols, u8 rows, u64 seed
+ *   NET_MSG_DELTA    u32 tick, u8 flags,
+ *                    [NET_DELTA_PIECE] i8 x, i8 y, u8 kind << 4 | orient, u32 id,
+ *                    u8 row count, rows of { u8 index, NET_ROW_BYTES packed row }
+ *
+ * A packed row is the u16 row mask followed by one nibble of Piece_Kind
+ * per column, low nibble first. Deltas only carry what changed since the
+ * previous one, so the first after a (re)start carries the whole board.
+ */
+
+#define NET_MSG_HELLO 0x01
+#define NET_MSG_INPUT 0x02
+#define NET_MSG_RESTART 0x03
+#define NET_MSG_WELCOME 0x81
+#define NET_MSG_DELTA 0x82
+
+#define NET_DELTA_PIECE 0x01
+#define NET_DELTA_GAME_OVER 0x02
+
+#define NET_ROW_BYTES (2 + (TETRIS_COLS + 1) / 2)
+#define NET_MAX_FRAME 512
+#define NET_IN_CAP 256
+#define NET_OUT_CAP 1024
+
+// --------------------------------------------------------------------
+
+typedef struct {
+    uint8_t *data;
+    int len, cap;
+    bool overflow;
+} Net_Writer;
+
+typedef struct {
+    const uint8_t *data;
+    int len, at;
+    bool error;
+} Net_Reader;
+
+static inline void net_put_u8(Net_Writer *w, uint8_t v)
+{
+    if (w->len + 1 > w->cap) { w->overflow = true; return; }
+    w->data[w->len++] = v;
+}
+
+static inline void net_put_u16(Net_Writer *w, uint16_t v)
+{
+    net_put_u8(w, (uint8_t)v);
+    net_put_u8(w, (uint8_t)(v >> 8));
+}
+
+static inline void net_put_u32(Net_Writer *w, uint32_t v)
+{
+    net_put_u16(w, (uint16_t)v);
+    net_put_u16(w, (uint16_t)(v >> 16));
+}
+
+static inline void net_put_u64(Net_Writer *w, uint64_t v)
+{
+    net_put_u32(w, (uint32_t)v);
+    net_put_u32(w, (uint32_t)(v >> 32));
+}
+
+static inline void net_put_bytes(Net_Writer *w, const uint8_t *src, int n)
+{
+    if (w->len + n > w->cap) { w->overflow = true; return; }
+    memcpy(w->data + w->len, src, (size_t)n);
+    w->len += n;
+}
+
+// Starts a frame; returns where its length goes so net_end_frame can patch it.
+static inline int net_begin_frame(Net_Writer *w, uint8_t type)
+{
+    int at = w->len;
+    net_put_u16(w, 0);
+    net_put_u8(w, type);
+    return at;
+}
+
+static inline void net_end_frame(Net_Writer *w, int at)
+{
+    if (w->overflow) return;
+    uint16_t len = (uint16_t)(w->len - at - 2);
+    w->data[at] = (uint8_t)len;
+    w->data[at + 1] = (uint8_t)(len >> 8);
+}
+
+static inline uint8_t net_get_u8(Net_Reader *r)
+{
+    if (r->at + 1 > r->len) { r->error = true; return 0; }
+    return r->data[r->at++];
+}
+
+static inline uint16_t net_get_u16(Net_Reader *r)
+{
+    uint16_t lo = net_get_u8(r);
+    return (uint16_t)(lo | (net_get_u8(r) << 8));
+}
+
+static inline uint32_t net_get_u32(Net_Reader *r)
+{
+    uint32_t lo = net_get_u16(r);
+    return lo | ((uint32_t)net_get_u16(r) << 16);
+}
+
+static inline uint64_t net_get_u64(Net_Reader *r)
+{
+    uint64_t lo = net_get_u32(r);
+    return lo | ((uint64_t)net_get_u32(r) << 32);
+}
+
+static inline void net_get_bytes(Net_Reader *r, uint8_t *dst, int n)
+{
+    if (r->at + n > r->len) { r->error = true; return; }
+    memcpy(dst, r->data + r->at, (size_t)n);
+    r->at += n;
+}
+
+// --------------------------------------------------------------------
+
+/*
+ * One connected player and their game. Sessions live in a pool sized at
+ * startup; buffers are inline, and the board's arena is kept across
+ * restarts, so a session only allocates when it first joins.
+ */
+typedef struct {
+    bool open;
+    bool joined;
+    bool dropped;       // Fell too far behind to take another delta; the transport closes it.
+    int fd;             // -1 for in-process clients.
+
+    Game_State game;
+
+    // What the client was last told, for deltas.
+    Piece sent_piece;
+    bool sent_game_over;
+    int sent_board_piece_id;
+    uint8_t sent_rows[TETRIS_ROWS][NET_ROW_BYTES];
+
+    uint8_t in[NET_IN_CAP];
+    int in_len;
+    uint8_t out[NET_OUT_CAP];
+    int out_len;
+} Net_Session;
+
+typedef struct {
+    Net_Session *sessions;
+    int session_cap;
+    int session_count;
+    int *free_slots;
+    int free_count;
+
+    uint64_t seed_rng;
+    uint64_t bytes_in, bytes_out;
+} Net_Server;
+
+// Client-side mirror of a session's board, rebuilt from deltas.
+typedef struct {
+    uint32_t session;
+    int cols, rows;
+    uint32_t tick;
+    bool is_game_over;
+    Piece piece;
+    uint16_t row_masks[TETRIS_ROWS];
+    uint8_t kinds[TETRIS_ROWS][TETRIS_COLS];
+} Net_View;
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nn.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NN_HAVE_AVX2 1
+#else
+#define NN_HAVE_AVX2 0
+#endif
+
+static void nn_layer_scalar(const float *w, const float *bias, int in, int out,
+                            const float *x, float *y, int stride, int count, bool relu)
+{
+    for (int o = 0; o < out; o++)
+    {
+        const float *wo = &w[(size_t)o * (size_t)in];
+        float *yo = &y[(size_t)o * (size_t)stride];
+        for (int b = 0; b < count; b++) yo[b] = bias[o];
+        for (int i = 0; i < in; i++)
+        {
+            const float *xi = &x[(size_t)i * (size_t)stride];
+            for (int b = 0; b < count; b++) yo[b] += wo[i] * xi[b];
+        }
+        if (relu)
+        {
+            for (int b = 0; b < count; b++) yo[b] = yo[b] > 0.0f ? yo[b] : 0.0f;
+        }
+    }
+}
+
+#if NN_HAVE_AVX2
+/*
+ * Four output units per pass over the inputs, so each activation vector
+ * is loaded once and feeds four FMAs.
+ */
+__attribute__((target("avx2,fma")))
+static void nn_layer_avx2(const float *w, const float *bias, int in, int out,
+                          const float *x, float *y, int stride, int count, bool relu)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    for (int b = 0; b < count; b += NN_LANES)
+    {
+        int o = 0;
+        for (; o + 4 <= out; o += 4)
+        {
+            const float *w0 = &w[(size_t)o * (size_t)in];
+            const float *w1 = w0 + in, *w2 = w1 + in, *w3 = w2 + in;
+            __m256 a0 = _mm256_set1_ps(bias[o + 0]);
+            __m256 a1 = _mm256_set1_ps(bias[o + 1]);
+            __m256 a2 = _mm256_set1_ps(bias[o + 2]);
+            __m256 a3 = _mm256_set1_ps(bias[o + 3]);
+            for (int i = 0; i < in; i++)
+            {
+                __m256 xi = _mm256_loadu_ps(&x[(size_t)i * (size_t)stride + (size_t)b]);
+                a0 = _mm256_fmadd_ps(_mm256_set1_ps(w0[i]), xi, a0);
+                a1 = _mm256_fmadd_ps(_mm256_set1_ps(w1[i]), xi, a1);
+                a2 = _mm256_fmadd_ps(_mm256_set1_ps(w2[i]), xi, a2);
+                a3 = _mm256_fmadd_ps(_mm256_set1_ps(w3[i]), xi, a3);
+            }
+            if (relu)
+            {
+                a0 = _mm256_max_ps(a0, zero);
+                a1 = _mm256_max_ps(a1, zero);
+                a2 = _mm256_max_ps(a2, zero);
+                a3 = _mm256_max_ps(a3, zero);
+            }
+            _mm256_storeu_ps(&y[(size_t)(o + 0) * (size_t)stride + (size_t)b], a0);
+            _mm256_storeu_ps(&y[(size_t)(o + 1) * (size_t)stride + (size_t)b], a1);
+            _mm256_storeu_ps(&y[(size_t)(o + 2) * (size_t)stride + (size_t)b], a2);
+            _mm256_storeu_ps(&y[(size_t)(o + 3) * (size_t)stride + (size_t)b], a3);
+        }
+        for (; o < out; o++)
+        {
+            const float *wo = &w[(size_t)o * (size_t)in];
+            __m256 a = _mm256_set1_ps(bias[o]);
+            for (int i = 0; i < in; i++)
+            {
+                a = _mm256_fmadd_ps(_mm256_set1_ps(wo[i]), _mm256_loadu_ps(&x[(size_t)i * (size_t)stride + (size_t)b]), a);
+            }
+            if (relu) a = _mm256_max_ps(a, zero);
+            _mm256_storeu_ps(&y[(size_t)o * (size_t)stride + (size_t)b], a);
+        }
+    }
+}
+#endif
+
+// __builtin_cpu_supports only reads flags filled in at startup, so this is cheap enough per call.
+static Nn_Layer_Fn *nn_layer_best()
+{
+#if NN_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return nn_layer_avx2;
+#endif
+    return nn_layer_scalar;
+}
+
+static const char *nn_layer_name(Nn_Layer_Fn *layer)
+{
+    return layer == nn_layer_scalar ? "scalar" : "avx2+fma";
+}
+
+// --------------------------------------------------------------------
+
+static size_t nn_model_arena_size(int layer_count, const int *sizes)
+{
+    size_t size = 0;
+    for (int l = 0; l < layer_count; l++)
+    {
+        size += arena_align_up(sizeof(float) * (size_t)(sizes[l] * sizes[l + 1]), 64);
+        size += arena_align_up(sizeof(float) * (size_t)sizes[l + 1], 64);
+    }
+    return size;
+}
+
+// Zeroed weights for a network of the given shape, or NULL if the shape isn't one we can run.
+static Nn_Model *nn_model_alloc(int layer_count, const int *sizes)
+{
+    if (layer_count < 1 || layer_count > NN_MAX_LAYERS)
+    {
+        fprintf(stderr, "NN: %d layers, expected 1 to %d\n", layer_count, NN_MAX_LAYERS);
+        return NULL;
+    }
+    if (sizes[0] != NN_INPUT_COUNT || sizes[layer_count] != 1)
+    {
+        fprintf(stderr, "NN: network takes %d inputs to %d outputs, expected %d to 1\n",
+            sizes[0], sizes[layer_count], NN_INPUT_COUNT);
+        return NULL;
+    }
+    for (int l = 1; l < layer_count; l++)
+    {
+        if (sizes[l] < 1 || sizes[l] > NN_MAX_WIDTH)
+        {
+            fprintf(stderr, "NN: layer %d has %d units, expected 1 to %d\n", l, sizes[l], NN_MAX_WIDTH);
+            return NULL;
+        }
+    }
+
+    Nn_Model *m = mem_calloc(1, sizeof(*m));
+    size_t size = nn_model_arena_size(layer_count, sizes);
+    if (!arena_init(&m->arena, size))
+    {
+        fprintf(stderr, "NN: couldn't allocate %zu bytes of weights\n", size);
+        mem_free(m);
+        return NULL;
+    }
+
+    m->layer_count = layer_count;
+    memcpy(m->sizes, sizes, sizeof(sizes[0]) * (size_t)(layer_count + 1));
+    for (int l = 0; l < layer_count; l++)
+    {
+        m->weights[l] = arena_push(&m->arena, sizeof(float) * (size_t)(sizes[l] * sizes[l + 1]), 64);
+        m->biases[l] = arena_push(&m->arena, sizeof(float) * (size_t)sizes[l + 1], 64);
+    }
+    return m;
+}
+
+void nn_model_free(Nn_Model *m)
+{
+    if (!m) return;
+    arena_release(&m->arena);
+    mem_free(m);
+}
+
+Nn_Model *nn_model_load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        fprintf(stderr, "NN: couldn't open %s\n", path);
+        return NULL;
+    }
+
+    int version = 0, layer_count = 0;
+    int sizes[NN_MAX_LAYERS + 1] = {0};
+    bool ok =
+        fscanf(f, " tetris-mlp %d", &version) == 1 && version == NN_FILE_VERSION &&
+        fscanf(f, " layers %d", &layer_count) == 1 && layer_count >= 1 && layer_count <= NN_MAX_LAYERS &&
+        fscanf(f, " sizes") == 0;
+    for (int l = 0; ok && l <= layer_count; l++) ok = fscanf(f, "%d", &sizes[l]) == 1;
+
+    Nn_Model *m = ok ? nn_model_alloc(layer_count, sizes) : NULL;
+    for (int l = 0; m && ok && l < layer_count; l++)
+    {
+        for (int o = 0; ok && o < sizes[l + 1]; o++)
+        {
+            float *wo = &m->weights[l][(size_t)o * (size_t)sizes[l]];
+            for (int i = 0; ok && i < sizes[l]; i++) ok = fscanf(f, "%f", &wo[i]) == 1;
+            ok = ok && fscanf(f, "%f", &m->biases[l][o]) == 1;
+        }
+    }
+    fclose(f);
+
+    if (!m || !ok)
+    {
+        fprintf(stderr, "NN: malformed weight file %s\n", path);
+        nn_model_free(m);
+        return NULL;
+    }
+    return m;
+}
+
+bool nn_model_save(const Nn_Model *m, const char *path)
+{
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *f = fopen(tmp_path, "w");
+    if (!f)
+    {
+        fprintf(stderr, "NN: couldn't write %s\n", tmp_path);
+        return false;
+    }
+
+    fprintf(f, "tetris-mlp %d\n", NN_FILE_VERSION);
+    fprintf(f, "layers %d\n", m->layer_count);
+    fprintf(f, "sizes");
+    for (int l = 0; l <= m->layer_count; l++) fprintf(f, " %d", m->sizes[l]);
+    fprintf(f, "\n");
+    for (int l = 0; l < m->layer_count; l++)
+    {
+        int in = m->sizes[l];
+        for (int o = 0; o < m->sizes[l + 1]; o++)
+        {
+            for (int i = 0; i < in; i++) fprintf(f, "%.9g ", m->weights[l][(size_t)o * (size_t)in + (size_t)i]);
+            fprintf(f, "%.9g\n", m->biases[l][o]);
+        }
+    }
+
+    bool ok = fclose(f) == 0;
+    return ok && rename(tmp_path, path) == 0;
+}
+
+/*
+ * A network that scores exactly like the linear heuristic: two hidden
+ * units carry the weighted sum's positive and negative parts, and the
+ * output recombines them. A starting point for training, and a way to
+ * check the batched path against ai_find_best_placement.
+ */
+Nn_Model *nn_model_from_weights(const Ai_Weights *weights)
+{
+    const int sizes[] = {NN_INPUT_COUNT, 2, 1};
+    Nn_Model *m = nn_model_alloc(2, sizes);
+    if (!m) return NULL;
+
+    for (int f = 0; f < AI_FEATURE_COUNT; f++)
+    {
+        m->weights[0][NN_INPUT_FEATURES + f] = weights->w[f];
+        m->weights[0][NN_INPUT_COUNT + NN_INPUT_FEATURES + f] = -weights->w[f];
+    }
+    m->weights[1][0] = 1.0f;
+    m->weights[1][1] = -1.0f;
+    return m;
+}
+
+// --------------------------------------------------------------------
+
+bool nn_batch_init(Nn_Batch *b, int capacity)
+{
+    memset(b, 0, sizeof(*b));
+    b->capacity = (capacity + NN_LANES - 1) / NN_LANES * NN_LANES;
+
+    size_t inputs = sizeof(float) * (size_t)NN_INPUT_COUNT * (size_t)b->capacity;
+    size_t buffer = sizeof(float) * (size_t)NN_MAX_WIDTH * (size_t)b->capacity;
+    size_t size = arena_align_up(inputs, 64) + 2 * arena_align_up(buffer, 64);
+    if (!arena_init(&b->arena, size))
+    {
+        fprintf(stderr, "NN: couldn't allocate %zu bytes for a batch of %d\n", size, b->capacity);
+        return false;
+    }
+    b->inputs = arena_push(&b->arena, inputs, 64);
+    b->act[0] = arena_push(&b->arena, buffer, 64);
+    b->act[1] = arena_push(&b->arena, buffer, 64);
+    return true;
+}
+
+void nn_batch_free(Nn_Batch *b)
+{
+    arena_release(&b->arena);
+    memset(b, 0, sizeof(*b));
+}
+
+static const float *nn_forward_with(const Nn_Model *m, Nn_Batch *b, Nn_Layer_Fn *layer)
+{
+    int count = (b->count + NN_LANES - 1) / NN_LANES * NN_LANES;
+    const float *x = b->inputs;
+    for (int l = 0; l < m->layer_count; l++)
+    {
+        float *y = b->act[l & 1];
+        layer(m->weights[l], m->biases[l], m->sizes[l], m->sizes[l + 1], x, y, b->capacity, count, l + 1 < m->layer_count);
+        x = y;
+    }
+    return x;
+}
+
+// Scores every board in the batch; the result holds one score per board, in the order they were added,
+// until the next call. The inputs are left alone, so a batch can be run again.
+const float *nn_forward(const Nn_Model *m, Nn_Batch *b)
+{
+    return nn_forward_with(m, b, nn_layer_best());
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "mem.h"
+#include "ai.h"
+
+/*
+ * A small MLP that scores the board left by a placement, in place of the
+ * linear heuristic in ai.c. Candidates are scored in batches: every board
+ * goes into an Nn_Batch, and one nn_forward call runs the whole network
+ * over all of them.
+ *
+ * Activations are laid out unit-major, boards side by side
+ * ([unit][capacity]). That makes a dense layer a run of broadcast weights
+ * times contiguous activations, NN_LANES boards at a time. Those run as
+ * AVX2/FMA when the CPU has it and as plain C otherwise. Hidden layers use
+ * ReLU, and the last layer is a single linear unit.
+ *
+ * Weight file, text like the tuner's checkpoints:
+ *   tetris-mlp 1
+ *   layers 2
+ *   sizes 38 16 1
+ * then, for each layer, one line per output unit: its inputs' weights,
+ * then its bias.
+ */
+
+#define NN_FILE_VERSION 1
+#define NN_MAX_LAYERS 4
+#define NN_MAX_WIDTH 64
+#define NN_LANES 8
+#define NN_BATCH_MAX 256
+
+// What the network sees of a board. Per-column inputs are 0 past the board's right edge.
+typedef enum {
+    NN_INPUT_HEIGHTS = 0,
+    NN_INPUT_HOLES = NN_INPUT_HEIGHTS + AI_MAX_COLS,
+    NN_INPUT_FEATURES = NN_INPUT_HOLES + AI_MAX_COLS,   // The heuristic's Ai_Feature values.
+    NN_INPUT_COUNT = NN_INPUT_FEATURES + AI_FEATURE_COUNT
+} Nn_Input;
+
+typedef struct Nn_Model {
+    int layer_count;
+    int sizes[NN_MAX_LAYERS + 1];   // sizes[0] is NN_INPUT_COUNT, the last is 1.
+    float *weights[NN_MAX_LAYERS];  // [out][in]
+    float *biases[NN_MAX_LAYERS];
+    Arena arena;
+} Nn_Model;
+
+typedef struct Nn_Batch {
+    int capacity;       // Boards, a multiple of NN_LANES.
+    int count;
+    float *inputs;      // [NN_INPUT_COUNT][capacity]
+    float *act[2];      // [NN_MAX_WIDTH][capacity], alternating between layers.
+    Arena arena;
+} Nn_Batch;
+
+// One input of board `i`.
+static inline float *nn_batch_input(Nn_Batch *b, int input, int i)
+{
+    return &b->inputs[(size_t)input * (size_t)b->capacity + (size_t)i];
+}
+
+// Dense layer over `count` boards (a multiple of NN_LANES): y[o][b] = bias[o] + sum_i w[o][i] * x[i][b].
+typedef void Nn_Layer_Fn(const float *w, const float *bias, int in, int out,
+                         const float *x, float *y, int stride, int count, bool relu);
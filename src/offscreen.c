@@ -0,0 +1,223 @@
+/*
+ * Windowless front end: plays bot games and renders them into an FBO,
+ * streaming frames to disk. Runs on a software GL such as Mesa llvmpipe
+ * through EGL's surfaceless platform (LIBGL_ALWAYS_SOFTWARE=1 to force it).
+ *
+ *   bin/offscreen [--games N] [--seed N] [--every N] [--max-pieces N]
+ *                 [--format png|raw] [--out dir] [--textured] [--trace FILE]
+ *
+ * --every 0 only renders the final board of each game (thumbnails).
+ * --trace records the run as a Chrome trace (see trace.h).
+ *
+ * Linux only for now:
+ *   cc -O2 -Isrc -Ithird_party src/offscreen.c -o bin/offscreen -lEGL -lOpenGL -lm -lpthread
+ */
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "gl_glue.h"
+#include "tetris.h"
+
+#include "tetris_core.c"
+#include "capture.c"
+#include "tetris.c"
+#include "nn.c"
+#include "ai.c"
+#include "trace.c"
+
+static const float offscreen_w = 256.0f;
+static const float offscreen_h = 512.0f;
+
+typedef struct {
+    EGLDisplay display;
+    EGLContext context;
+} Offscreen_Context;
+
+static bool offscreen_context_create(Offscreen_Context *c)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    c->display = EGL_NO_DISPLAY;
+    if (get_platform_display) c->display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (c->display == EGL_NO_DISPLAY) c->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (c->display == EGL_NO_DISPLAY || !eglInitialize(c->display, &major, &minor))
+    {
+        fprintf(stderr, "EGL: no display\n");
+        return false;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(c->display, config_attribs, &config, 1, &config_count) || config_count == 0)
+    {
+        fprintf(stderr, "EGL: no config\n");
+        return false;
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    c->context = eglCreateContext(c->display, config, EGL_NO_CONTEXT, context_attribs);
+    if (c->context == EGL_NO_CONTEXT || !eglMakeCurrent(c->display, EGL_NO_SURFACE, EGL_NO_SURFACE, c->context))
+    {
+        fprintf(stderr, "EGL: couldn't create a surfaceless GL 3.3 core context\n");
+        return false;
+    }
+
+    printf("GL: %s, %s\n", (const char *)glGetString(GL_RENDERER), (const char *)glGetString(GL_VERSION));
+    return true;
+}
+
+static GLuint offscreen_fbo_create(int w, int h, GLuint *out_rbo)
+{
+    GLuint fbo, rbo;
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &rbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        fprintf(stderr, "GL: offscreen framebuffer incomplete\n");
+    }
+    *out_rbo = rbo;
+    return fbo;
+}
+
+static void offscreen_usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [--games N] [--seed N] [--every N] [--max-pieces N]\n"
+        "          [--format png|raw] [--out dir] [--textured] [--trace FILE]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    int games = 1;
+    uint64_t base_seed = 1;
+    int every = 1;
+    int max_pieces = 500;
+    Capture_Format format = CAPTURE_FORMAT_PNG;
+    const char *out_dir = "captures";
+    bool textured = false;
+    const char *trace_path = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "--textured")) { textured = true; continue; }
+
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!val) { offscreen_usage(argv[0]); return 1; }
+
+        if      (!strcmp(arg, "--games"))      games = atoi(val);
+        else if (!strcmp(arg, "--seed"))       base_seed = strtoull(val, NULL, 10);
+        else if (!strcmp(arg, "--every"))      every = atoi(val);
+        else if (!strcmp(arg, "--max-pieces")) max_pieces = atoi(val);
+        else if (!strcmp(arg, "--out"))        out_dir = val;
+        else if (!strcmp(arg, "--trace"))      trace_path = val;
+        else if (!strcmp(arg, "--format"))
+        {
+            if      (!strcmp(val, "png")) format = CAPTURE_FORMAT_PNG;
+            else if (!strcmp(val, "raw")) format = CAPTURE_FORMAT_RAW;
+            else { offscreen_usage(argv[0]); return 1; }
+        }
+        else { offscreen_usage(argv[0]); return 1; }
+        i++;
+    }
+
+    Offscreen_Context ctx;
+    if (!offscreen_context_create(&ctx)) return 1;
+
+    static Game_State state;
+    Game_State *s = &state;
+    s->w = offscreen_w;
+    s->h = offscreen_h;
+    GLuint rbo;
+    s->fbo = offscreen_fbo_create((int)s->w, (int)s->h, &rbo);
+    s->tetris_cols = TETRIS_COLS;
+    s->tetris_rows = TETRIS_ROWS;
+
+    if (trace_path && !trace_start(trace_path)) return 1;
+    struct timespec shaders_start, shaders_end;
+    clock_gettime(CLOCK_MONOTONIC, &shaders_start);
+    create_shaders(s);
+    glFinish();
+    clock_gettime(CLOCK_MONOTONIC, &shaders_end);
+    printf("GL: shaders ready in %.2f ms\n", (double)(shaders_end.tv_sec - shaders_start.tv_sec) * 1e3 +
+        (double)(shaders_end.tv_nsec - shaders_start.tv_nsec) * 1e-6);
+    create_vert_buffer(s);
+    if (textured) load_block_atlas(s);
+    s->textured_blocks = textured;
+
+    mkdir(out_dir, 0755);
+    const Ai_Weights weights = ai_default_weights();
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int total_frames = 0;
+
+    for (int game = 0; game < games; game++)
+    {
+        uint64_t seed_rng = base_seed + (uint64_t)game;
+        initialize_game_with_seed(s, rng_next(&seed_rng));
+
+        char path[512];
+        if (format == CAPTURE_FORMAT_RAW) snprintf(path, sizeof(path), "%s/game_%04d.rgba", out_dir, game);
+        else snprintf(path, sizeof(path), "%s/game_%04d", out_dir, game);
+        if (!capture_begin(&s->capture, format, path, (int)s->w, (int)s->h)) return 1;
+
+        int pieces = 0;
+        while (!s->is_game_over && pieces < max_pieces)
+        {
+            if (every > 0 && pieces % every == 0)
+            {
+                render_frame(s);
+                capture_frame(&s->capture, s->fbo);
+            }
+            if (ai_play_step(s, &weights) < 0) break;
+            pieces++;
+        }
+        render_frame(s);
+        capture_frame(&s->capture, s->fbo);
+
+        capture_end(&s->capture);
+        total_frames += s->capture.frames_written;
+        printf("%s: %d pieces, %d frames\n", path, pieces, s->capture.frames_written);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("%d frames in %.2fs (%.1f frames/s)\n", total_frames, elapsed, (double)total_frames / elapsed);
+    trace_stop();
+
+    free_game(s);
+    glDeleteRenderbuffers(1, &rbo);
+    glDeleteFramebuffers(1, &s->fbo);
+    eglMakeCurrent(ctx.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(ctx.display, ctx.context);
+    eglTerminate(ctx.display);
+    return 0;
+}
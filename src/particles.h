@@ -0,0 +1,202 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+#include "mem.h"
+
+/*
+ * Line-clear and lock effects. Particles live in a fixed pool laid out as
+ * structure-of-arrays, one array per field, so the update works through a
+ * vector of particles at a time: particle_step, on Vec_2s, is the scalar
+ * reference and particles_update its vector form. A particle that dies is
+ * replaced by the last live one, so the live ones stay packed in front.
+ *
+ * Positions are in board cells (x right, y down, a cell's top-left corner
+ * on its integer coordinates); draw_particles maps them to pixels in a
+ * Vert_Buffer of their own, sized for PARTICLE_DRAW_MAX. Emitting draws
+ * from the pool's own random stream, never the game's, so effects can't
+ * change what pieces come.
+ */
+
+#define PARTICLE_MAX (1 << 15)
+#define PARTICLE_DRAW_MAX 4096      // Drawn a frame, from the front of the pool; a tetris makes about half that.
+#define PARTICLE_GRAVITY 40.0f      // Cells per second, per second.
+#define PARTICLE_DRAG 1.5f          // Share of its speed a particle loses per second.
+
+// Per cell: how many, how fast (cells per second) and how long they last (seconds).
+#define PARTICLE_CLEAR_COUNT 48
+#define PARTICLE_CLEAR_SPEED 9.0f
+#define PARTICLE_CLEAR_LIFETIME 1.2f
+#define PARTICLE_LOCK_COUNT 6
+#define PARTICLE_LOCK_SPEED 3.0f
+#define PARTICLE_LOCK_LIFETIME 0.4f
+
+// One native vector of float: AVX when the build targets it (NATIVE=1), else SSE/NEON width.
+#ifdef __AVX__
+#define PARTICLE_LANES 8
+#else
+#define PARTICLE_LANES 4
+#endif
+
+typedef float Particle_Vec __attribute__((vector_size(PARTICLE_LANES * sizeof(float))));
+
+typedef struct {
+    int count;              // Live particles, packed at the front of every array.
+    uint64_t rng;
+    float *x, *y;
+    float *vx, *vy;
+    float *r, *g, *b;
+    float *life;            // From 1 at birth down to 0.
+    float *fade;            // Life lost per second: 1 / lifetime.
+    unsigned char *memory;
+} Particle_Pool;
+
+#define PARTICLE_FIELDS 9
+
+static inline Particle_Pool *particle_pool_make()
+{
+    Particle_Pool *p = mem_calloc(1, sizeof(Particle_Pool));
+    if (!p) return NULL;
+    p->memory = mem_alloc(sizeof(float) * PARTICLE_MAX * PARTICLE_FIELDS + 64);
+    if (!p->memory)
+    {
+        mem_free(p);
+        return NULL;
+    }
+
+    float *f = (float *)(((uintptr_t)p->memory + 63) & ~(uintptr_t)63);
+    float **fields[PARTICLE_FIELDS] = {&p->x, &p->y, &p->vx, &p->vy, &p->r, &p->g, &p->b, &p->life, &p->fade};
+    for (int i = 0; i < PARTICLE_FIELDS; i++) *fields[i] = f + i * PARTICLE_MAX;
+    p->rng = 0x5EED0F9A57C1E5ull;
+    return p;
+}
+
+static inline void particle_pool_free(Particle_Pool *p)
+{
+    if (!p) return;
+    mem_free(p->memory);
+    mem_free(p);
+}
+
+// Uniform in [0, 1).
+static inline float particle_random(Particle_Pool *p)
+{
+    return (float)(rng_next(&p->rng) >> 40) * (1.0f / 16777216.0f);
+}
+
+/*
+ * `count` particles from somewhere in the cell at (`col`, `row`), thrown
+ * up and out at up to `speed` cells per second and gone within `lifetime`
+ * seconds. Whatever doesn't fit in the pool is left out.
+ */
+static inline void particles_emit_cell(Particle_Pool *p, int col, int row, Col_3f color, int count, float speed, float lifetime)
+{
+    if (count > PARTICLE_MAX - p->count) count = PARTICLE_MAX - p->count;
+    for (int n = 0; n < count; n++)
+    {
+        int i = p->count++;
+        p->x[i] = (float)col + particle_random(p);
+        p->y[i] = (float)row + particle_random(p);
+        p->vx[i] = (particle_random(p) - 0.5f) * 2.0f * speed;
+        p->vy[i] = -particle_random(p) * speed;
+        p->r[i] = color.r;
+        p->g[i] = color.g;
+        p->b[i] = color.b;
+        p->life[i] = 1.0f;
+        p->fade[i] = 1.0f / (lifetime * (0.5f + 0.5f * particle_random(p)));
+    }
+}
+
+// The scalar reference for one particle over `dt` seconds; `drag` is the velocity kept, from particle_drag.
+static inline void particle_step(Vec_2 *pos, Vec_2 *vel, float *life, float fade, float drag, float dt)
+{
+    vel->x = vel->x * drag;
+    vel->y = (vel->y + PARTICLE_GRAVITY * dt) * drag;
+    pos->x += vel->x * dt;
+    pos->y += vel->y * dt;
+    *life -= fade * dt;
+}
+
+static inline float particle_drag(float dt)
+{
+    float lost = PARTICLE_DRAG * dt;
+    return lost < 1.0f ? 1.0f - lost : 0.0f;
+}
+
+static inline Particle_Vec particle_load(const float *p)
+{
+    Particle_Vec v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void particle_store(float *p, Particle_Vec v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+// particle_step over particles [`from`, `to`).
+static inline void particles_step_range(Particle_Pool *p, int from, int to, float drag, float dt)
+{
+    for (int i = from; i < to; i++)
+    {
+        Vec_2 pos = {p->x[i], p->y[i]};
+        Vec_2 vel = {p->vx[i], p->vy[i]};
+        particle_step(&pos, &vel, &p->life[i], p->fade[i], drag, dt);
+        p->x[i] = pos.x;
+        p->y[i] = pos.y;
+        p->vx[i] = vel.x;
+        p->vy[i] = vel.y;
+    }
+}
+
+// Replaces each particle that has faded with the last live one.
+static inline void particles_drop_faded(Particle_Pool *p)
+{
+    for (int i = 0; i < p->count;)
+    {
+        if (p->life[i] > 0.0f)
+        {
+            i++;
+            continue;
+        }
+        int last = --p->count;
+        p->x[i] = p->x[last];
+        p->y[i] = p->y[last];
+        p->vx[i] = p->vx[last];
+        p->vy[i] = p->vy[last];
+        p->r[i] = p->r[last];
+        p->g[i] = p->g[last];
+        p->b[i] = p->b[last];
+        p->life[i] = p->life[last];
+        p->fade[i] = p->fade[last];
+    }
+}
+
+// Moves every particle on by `dt` seconds, PARTICLE_LANES at a time, and drops the ones that have faded.
+static inline void particles_update(Particle_Pool *p, float dt)
+{
+    const float drag = particle_drag(dt);
+    const int whole = p->count - p->count % PARTICLE_LANES;
+    for (int i = 0; i < whole; i += PARTICLE_LANES)
+    {
+        Particle_Vec vx = particle_load(&p->vx[i]) * drag;
+        Particle_Vec vy = (particle_load(&p->vy[i]) + PARTICLE_GRAVITY * dt) * drag;
+        particle_store(&p->vx[i], vx);
+        particle_store(&p->vy[i], vy);
+        particle_store(&p->x[i], particle_load(&p->x[i]) + vx * dt);
+        particle_store(&p->y[i], particle_load(&p->y[i]) + vy * dt);
+        particle_store(&p->life[i], particle_load(&p->life[i]) - particle_load(&p->fade[i]) * dt);
+    }
+    particles_step_range(p, whole, p->count, drag, dt);
+    particles_drop_faded(p);
+}
+
+// particles_update one particle at a time: the reference bench --particles compares it against.
+static inline void particles_update_scalar(Particle_Pool *p, float dt)
+{
+    particles_step_range(p, 0, p->count, particle_drag(dt), dt);
+    particles_drop_faded(p);
+}
@@ -0,0 +1,430 @@
+/*
+ * Move generation counter, after chess engines' perft: counts every
+ * sequence of placements `depth` pieces deep, with each later piece
+ * following the engine's own piece stream from the seed or an explicit
+ * sequence.
+ *
+ *   bin/perft [--depth N] [--seed N] [--pieces TLSOIJZ...] [--threads N]
+ *             [--cols N] [--rows N] [--verify]
+ *
+ * Each depth is counted by movegen on one thread and then on --threads
+ * threads, and reported as nodes per second, a node being one counted
+ * sequence. --verify counts once more by walking the engine itself,
+ * slide_current_piece, rotate_current_piece and move_current_piece_down
+ * on a Game_State, and fails on any difference.
+ *
+ * Placements are told apart by the cells they cover, so a piece that
+ * gets to the same spot by different paths or turned 180 counts once.
+ * Sequences that top out before `depth` pieces don't count.
+ */
+
+#define TETRIS_HEADLESS
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tetris.h"
+#include "movegen.h"
+
+#include "tetris_core.c"
+#include "movegen.c"
+
+#define PERFT_MAX_DEPTH 16
+#define PERFT_MAX_THREADS 256
+
+typedef struct {
+    int cols, rows;
+    // Explicit piece sequence, spawned facing up; empty to follow the engine's RNG.
+    Piece_Kind sequence[PERFT_MAX_DEPTH];
+    int sequence_length;
+} Perft_Config;
+
+typedef struct {
+    uint16_t rows[MOVEGEN_MAX_ROWS];
+    uint64_t rng;
+    int next;           // Index of the next piece in the explicit sequence.
+} Perft_Node;
+
+static double perft_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// generate_new_piece on a node: false if the new piece doesn't fit.
+static bool perft_spawn(const Perft_Config *c, Perft_Node *n, Piece *out)
+{
+    Piece p = {.x = 3, .y = 0};
+    if (c->sequence_length > 0)
+    {
+        p.kind = c->sequence[n->next++];
+        p.orient = PIECE_ORIENT_UP;
+    }
+    else
+    {
+        p.kind = (Piece_Kind)(rng_next(&n->rng) % PIECE_KIND_COUNT);
+        p.orient = (Piece_Orient)(rng_next(&n->rng) % PIECE_ORIENT_COUNT);
+    }
+    *out = p;
+    return piece_fits(n->rows, c->cols, c->rows, p.kind, p.orient, p.x, p.y);
+}
+
+// commit_piece and check_lines on a node's row masks.
+static void perft_lock(const Perft_Config *c, Perft_Node *n, Piece_Kind kind, int o, int x, int y)
+{
+    const Piece_Spec *spec = piece_spec_get_by_kind(kind);
+    for (int row = 0; row < PIECE_MAX_ROWS; row++)
+    {
+        unsigned int bits = piece_spec_get_row(spec, (Piece_Orient)o, row);
+        if (bits) n->rows[y + row] |= (uint16_t)(bits << x);
+    }
+
+    const uint16_t full = (uint16_t)((1u << c->cols) - 1);
+    int dst = c->rows - 1;
+    for (int src = c->rows - 1; src >= 0; src--)
+    {
+        if (n->rows[src] != full) n->rows[dst--] = n->rows[src];
+    }
+    while (dst >= 0) n->rows[dst--] = 0;
+}
+
+// Sequences `depth` pieces deep from `n` with `p` in play. The last level is counted without being played.
+static uint64_t perft_count(const Perft_Config *c, const Perft_Node *n, const Piece *p, int depth)
+{
+    Movegen_Locks locks;
+    int count = movegen_locks(n->rows, c->cols, c->rows, p, &locks);
+    if (depth == 1) return (uint64_t)count;
+
+    uint64_t total = 0;
+    for (int o = 0; o < PIECE_ORIENT_COUNT; o++)
+    {
+        for (int y = 0; y < c->rows; y++)
+        {
+            for (uint32_t xs = locks.at[o][y]; xs; xs &= xs - 1)
+            {
+                Perft_Node child = *n;
+                perft_lock(c, &child, p->kind, o, __builtin_ctz(xs), y);
+                Piece next;
+                if (perft_spawn(c, &child, &next)) total += perft_count(c, &child, &next, depth - 1);
+            }
+        }
+    }
+    return total;
+}
+
+// --------------------------------------------------------------------
+
+typedef struct {
+    Perft_Node node;
+    Piece piece;
+} Perft_Task;
+
+typedef struct {
+    const Perft_Config *config;
+    const Perft_Task *tasks;
+    int task_count;
+    int depth;          // Left to count below each task.
+    _Atomic int next_task;
+    _Atomic uint64_t total;
+} Perft_Job;
+
+// Every position `levels` placements below the root that's still in play.
+static void perft_split(const Perft_Config *c, const Perft_Node *n, const Piece *p, int levels,
+                        Perft_Task **tasks, int *count, int *capacity)
+{
+    if (levels == 0)
+    {
+        if (*count == *capacity)
+        {
+            *capacity = *capacity ? *capacity * 2 : 256;
+            Perft_Task *grown = mem_alloc(sizeof(Perft_Task) * (size_t)*capacity);
+            if (*count) memcpy(grown, *tasks, sizeof(Perft_Task) * (size_t)*count);
+            mem_free(*tasks);
+            *tasks = grown;
+        }
+        (*tasks)[(*count)++] = (Perft_Task){.node = *n, .piece = *p};
+        return;
+    }
+
+    Movegen_Locks locks;
+    movegen_locks(n->rows, c->cols, c->rows, p, &locks);
+    for (int o = 0; o < PIECE_ORIENT_COUNT; o++)
+    {
+        for (int y = 0; y < c->rows; y++)
+        {
+            for (uint32_t xs = locks.at[o][y]; xs; xs &= xs - 1)
+            {
+                Perft_Node child = *n;
+                perft_lock(c, &child, p->kind, o, __builtin_ctz(xs), y);
+                Piece next;
+                if (perft_spawn(c, &child, &next)) perft_split(c, &child, &next, levels - 1, tasks, count, capacity);
+            }
+        }
+    }
+}
+
+static void *perft_worker(void *arg)
+{
+    Perft_Job *job = arg;
+    uint64_t total = 0;
+    for (;;)
+    {
+        int i = atomic_fetch_add_explicit(&job->next_task, 1, memory_order_relaxed);
+        if (i >= job->task_count) break;
+        total += perft_count(job->config, &job->tasks[i].node, &job->tasks[i].piece, job->depth);
+    }
+    atomic_fetch_add_explicit(&job->total, total, memory_order_relaxed);
+    return NULL;
+}
+
+// perft_count with the positions a level or two down shared out between threads.
+static uint64_t perft_count_parallel(const Perft_Config *c, const Perft_Node *n, const Piece *p, int depth, int threads)
+{
+    int levels = depth >= 4 ? 2 : 1;
+    if (depth <= levels) return perft_count(c, n, p, depth);
+
+    Perft_Job job = {.config = c, .depth = depth - levels};
+    Perft_Task *tasks = NULL;
+    int capacity = 0;
+    perft_split(c, n, p, levels, &tasks, &job.task_count, &capacity);
+    job.tasks = tasks;
+
+    pthread_t ids[PERFT_MAX_THREADS];
+    for (int i = 0; i < threads; i++) pthread_create(&ids[i], NULL, perft_worker, &job);
+    for (int i = 0; i < threads; i++) pthread_join(ids[i], NULL);
+
+    mem_free(tasks);
+    return atomic_load(&job.total);
+}
+
+// --------------------------------------------------------------------
+
+/*
+ * The same count through the engine: a breadth-first search over the
+ * piece's positions using the engine's own move functions, then
+ * lock_current_piece on a copy of the game for each placement.
+ */
+
+typedef struct {
+    const Perft_Config *config;
+    Game_State levels[PERFT_MAX_DEPTH + 1];
+    int next[PERFT_MAX_DEPTH + 1];  // Explicit sequence index per level.
+} Perft_Engine;
+
+// Copies everything but the arena, then the board into dst's own arena.
+static void perft_copy_game(Game_State *dst, const Game_State *src)
+{
+    Arena arena = dst->arena;
+    Block *blocks = dst->blocks;
+    uint16_t *row_masks = dst->row_masks;
+    *dst = *src;
+    dst->arena = arena;
+    dst->blocks = blocks;
+    dst->row_masks = row_masks;
+    memcpy(blocks, src->blocks, sizeof(Block) * (size_t)(src->tetris_cols * src->tetris_rows));
+    memcpy(row_masks, src->row_masks, sizeof(uint16_t) * (size_t)src->tetris_rows);
+}
+
+static bool perft_engine_move(Game_State *s, const Piece *from, int move)
+{
+    s->current_piece = *from;
+    switch (move)
+    {
+        case 0: return slide_current_piece(s, -1);
+        case 1: return slide_current_piece(s, +1);
+        case 2: return move_current_piece_down(s);
+        case 3: return rotate_current_piece(s, PIECE_ROTATE_CW);
+        case 4: return rotate_current_piece(s, PIECE_ROTATE_180);
+        default: return rotate_current_piece(s, PIECE_ROTATE_CCW);
+    }
+}
+
+// Placements of the piece in play, one per set of covered cells. Leaves the piece where it was.
+static int perft_engine_locks(Game_State *s, Piece *out)
+{
+    const Piece spawn = s->current_piece;
+    const Piece_Spec *spec = piece_spec_get_by_kind(spawn.kind);
+    uint32_t seen[PIECE_ORIENT_COUNT][MOVEGEN_MAX_ROWS] = {{0}};
+    uint32_t locked[PIECE_ORIENT_COUNT][MOVEGEN_MAX_ROWS] = {{0}};
+    static _Thread_local Piece queue[PIECE_ORIENT_COUNT * MOVEGEN_MAX_ROWS * 16];
+    int head = 0, tail = 0, count = 0;
+
+    queue[tail++] = spawn;
+    seen[spawn.orient][spawn.y] |= 1u << spawn.x;
+    while (head < tail)
+    {
+        const Piece at = queue[head++];
+        for (int move = 0; move < 6; move++)
+        {
+            if (!perft_engine_move(s, &at, move)) continue;
+            const Piece *to = &s->current_piece;
+            if (seen[to->orient][to->y] & (1u << to->x)) continue;
+            seen[to->orient][to->y] |= 1u << to->x;
+            queue[tail++] = *to;
+        }
+
+        s->current_piece = at;
+        if (move_current_piece_down(s)) continue;
+        int canonical = movegen_canonical_orient(spec, at.orient);
+        if (locked[canonical][at.y] & (1u << at.x)) continue;
+        locked[canonical][at.y] |= 1u << at.x;
+        out[count++] = at;
+    }
+
+    s->current_piece = spawn;
+    return count;
+}
+
+static uint64_t perft_engine_count(Perft_Engine *e, int level, int depth)
+{
+    static _Thread_local Piece locks_by_level[PERFT_MAX_DEPTH + 1][PIECE_ORIENT_COUNT * MOVEGEN_MAX_ROWS * 16];
+    Game_State *s = &e->levels[level];
+    Piece *locks = locks_by_level[level];
+    int count = perft_engine_locks(s, locks);
+    if (depth == 1) return (uint64_t)count;
+
+    const Perft_Config *c = e->config;
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        Game_State *child = &e->levels[level + 1];
+        perft_copy_game(child, s);
+        child->current_piece = locks[i];
+        lock_current_piece(child);
+        e->next[level + 1] = e->next[level];
+        if (c->sequence_length > 0)
+        {
+            Piece next = {.id = child->piece_id_seed++, .x = 3, .y = 0, .kind = c->sequence[e->next[level + 1]++]};
+            child->is_game_over = !set_current_piece(child, next);
+        }
+        if (!child->is_game_over) total += perft_engine_count(e, level + 1, depth - 1);
+    }
+    return total;
+}
+
+// --------------------------------------------------------------------
+
+static bool perft_parse_pieces(const char *s, Perft_Config *c)
+{
+    c->sequence_length = 0;
+    for (; *s; s++)
+    {
+        Piece_Kind kind = piece_kind_from_letter(*s);
+        if (kind == PIECE_KIND_COUNT || c->sequence_length == PERFT_MAX_DEPTH) return false;
+        c->sequence[c->sequence_length++] = kind;
+    }
+    return c->sequence_length > 0;
+}
+
+static void perft_usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [--depth N] [--seed N] [--pieces TLSOIJZ...] [--threads N]\n"
+        "          [--cols N] [--rows N] [--verify]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    Perft_Config c = {.cols = TETRIS_COLS, .rows = TETRIS_ROWS};
+    int depth = 4;
+    int threads = cpus > 0 ? (int)cpus : 1;
+    uint64_t seed = 1;
+    bool verify = false;
+    const char *pieces = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "--verify")) { verify = true; continue; }
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!val) { perft_usage(argv[0]); return 1; }
+
+        if      (!strcmp(arg, "--depth"))   depth = atoi(val);
+        else if (!strcmp(arg, "--seed"))    seed = strtoull(val, NULL, 10);
+        else if (!strcmp(arg, "--threads")) threads = atoi(val);
+        else if (!strcmp(arg, "--cols"))    c.cols = atoi(val);
+        else if (!strcmp(arg, "--rows"))    c.rows = atoi(val);
+        else if (!strcmp(arg, "--pieces"))
+        {
+            if (!perft_parse_pieces(val, &c)) { perft_usage(argv[0]); return 1; }
+            pieces = val;
+        }
+        else { perft_usage(argv[0]); return 1; }
+        i++;
+    }
+
+    if (depth < 1 || depth > PERFT_MAX_DEPTH || threads < 1 || threads > PERFT_MAX_THREADS ||
+        c.cols < 4 || c.cols > 16 || c.rows < 4 || c.rows > MOVEGEN_MAX_ROWS)
+    {
+        perft_usage(argv[0]);
+        return 1;
+    }
+    if (c.sequence_length > 0 && c.sequence_length < depth)
+    {
+        fprintf(stderr, "Perft: %d pieces given for depth %d\n", c.sequence_length, depth);
+        return 1;
+    }
+
+    Perft_Engine *engine = mem_calloc(1, sizeof(*engine));
+    engine->config = &c;
+    for (int i = 0; i <= depth; i++)
+    {
+        engine->levels[i].tetris_cols = c.cols;
+        engine->levels[i].tetris_rows = c.rows;
+        initialize_game_with_seed(&engine->levels[i], seed);
+    }
+    Game_State *root = &engine->levels[0];
+    if (c.sequence_length > 0)
+    {
+        Piece first = {.id = root->piece_id_seed++, .x = 3, .y = 0, .kind = c.sequence[0]};
+        set_current_piece(root, first);
+        engine->next[0] = 1;
+    }
+
+    Perft_Node node = {.rng = root->rng_state, .next = 1};
+    memcpy(node.rows, root->row_masks, sizeof(uint16_t) * (size_t)c.rows);
+    const Piece piece = root->current_piece;
+
+    if (pieces) printf("%dx%d board, pieces %s\n", c.cols, c.rows, pieces);
+    else        printf("%dx%d board, pieces from seed %llu\n", c.cols, c.rows, (unsigned long long)seed);
+
+    bool agreed = true;
+    for (int d = 1; d <= depth; d++)
+    {
+        double start = perft_now();
+        uint64_t nodes = perft_count(&c, &node, &piece, d);
+        double single = perft_now() - start;
+
+        start = perft_now();
+        uint64_t parallel_nodes = perft_count_parallel(&c, &node, &piece, d, threads);
+        double parallel = perft_now() - start;
+
+        printf("depth %2d: %14llu   1 thread %8.3fs %8.2fM nodes/s   %d threads %8.3fs %8.2fM nodes/s\n",
+            d, (unsigned long long)nodes, single, nodes / single * 1e-6, threads, parallel, parallel_nodes / parallel * 1e-6);
+        if (parallel_nodes != nodes)
+        {
+            fprintf(stderr, "Perft: depth %d counts %llu on %d threads\n", d, (unsigned long long)parallel_nodes, threads);
+            agreed = false;
+        }
+
+        if (verify)
+        {
+            start = perft_now();
+            uint64_t engine_nodes = perft_engine_count(engine, 0, d);
+            printf("          %14llu   engine   %8.3fs %8.2fM nodes/s   %s\n", (unsigned long long)engine_nodes,
+                perft_now() - start, engine_nodes / (perft_now() - start) * 1e-6, engine_nodes == nodes ? "agrees" : "DIFFERS");
+            agreed = agreed && engine_nodes == nodes;
+        }
+    }
+
+    for (int i = 0; i <= depth; i++) free_game(&engine->levels[i]);
+    mem_free(engine);
+    return agreed ? 0 : 1;
+}
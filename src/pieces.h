@@ -1,7 +1,6 @@
 #pragma once
 
 #include "common.h"
-#include "gl_glue.h"
 
 #define PIECE_MAX_COLS 4
 #define PIECE_MAX_ROWS 4
@@ -17,6 +16,9 @@ typedef enum {
     PIECE_KIND_COUNT,
 } Piece_Kind;
 
+// Board cells that arrived as versus garbage rather than from a piece. Never spawned.
+#define PIECE_GARBAGE PIECE_KIND_COUNT
+
 typedef enum {
     PIECE_ORIENT_UP,
     PIECE_ORIENT_RIGHT,
@@ -25,11 +27,15 @@ typedef enum {
     PIECE_ORIENT_COUNT
 } Piece_Orient;
 
+/*
+ * One 16-bit mask per orientation: bit (y * PIECE_MAX_COLS + x) of the 4x4
+ * box. Orientations are precomputed from the UP shape by turning it within
+ * its cols x rows bounding box, anchored at the top-left.
+ * The whole table is 70 bytes.
+ */
 typedef struct {
-    int cols, rows;
-    Col_3f color;
-    Piece_Kind kind;
-    int blocks[PIECE_MAX_COLS * PIECE_MAX_ROWS];
+    uint16_t masks[PIECE_ORIENT_COUNT];
+    uint8_t cols, rows;
 } Piece_Spec;
 
 typedef struct {
@@ -39,152 +45,309 @@ typedef struct {
     Piece_Orient orient;
 } Piece;
 
+static const Piece_Spec piece_specs[PIECE_KIND_COUNT] __attribute__((aligned(64))) = {
+    [PIECE_T] = {
+        // .#..
+        // ###.
+        .cols = 3, .rows = 2,
+        .masks = {0x0072, 0x0131, 0x0027, 0x0232},
+    },
+    [PIECE_L] = {
+        // #...
+        // #...
+        // ##..
+        .cols = 2, .rows = 3,
+        .masks = {0x0311, 0x0017, 0x0223, 0x0074},
+    },
+    [PIECE_S] = {
+        // #...
+        // ##..
+        // .#..
+        .cols = 2, .rows = 3,
+        .masks = {0x0231, 0x0036, 0x0231, 0x0036},
+    },
+    [PIECE_O] = {
+        // ##..
+        // ##..
+        .cols = 2, .rows = 2,
+        .masks = {0x0033, 0x0033, 0x0033, 0x0033},
+    },
+    [PIECE_I] = {
+        // ####
+        .cols = 4, .rows = 1,
+        .masks = {0x000F, 0x1111, 0x000F, 0x1111},
+    },
+    [PIECE_J] = {
+        // .#..
+        // .#..
+        // ##..
+        .cols = 2, .rows = 3,
+        .masks = {0x0322, 0x0071, 0x0113, 0x0047},
+    },
+    [PIECE_Z] = {
+        // .#..
+        // ##..
+        // #...
+        .cols = 2, .rows = 3,
+        .masks = {0x0132, 0x0063, 0x0132, 0x0063},
+    },
+};
+
+static inline const Piece_Spec *piece_spec_get_by_kind(Piece_Kind kind)
+{
+    if ((unsigned)kind >= PIECE_KIND_COUNT) return &piece_specs[PIECE_T];
+    return &piece_specs[kind];
+}
+
+static inline uint16_t piece_spec_get_mask(const Piece_Spec *spec, Piece_Orient o)
+{
+    return spec->masks[o & (PIECE_ORIENT_COUNT - 1)];
+}
+
 static inline int piece_spec_get_block_state_at(const Piece_Spec *spec, Piece_Orient o, int x, int y)
 {
-    int x_t;
-    int y_t;
-    switch (o)
-    {
-        case PIECE_ORIENT_DOWN:
-        {
-            x_t = spec->cols - 1 - x;
-            y_t = spec->rows - 1 - y;
-            if (x_t < 0) return 0;
-            if (y_t < 0) return 0;
-        } break;
+    return (piece_spec_get_mask(spec, o) >> (y * PIECE_MAX_COLS + x)) & 1;
+}
 
-        case PIECE_ORIENT_LEFT:
-        {
-            x_t = spec->cols - 1 - y;
-            y_t = x;
-            if (x_t < 0) return 0;
-        } break;
+// Row `y` of the 4x4 box as a 4-bit mask, bit N is column N.
+static inline unsigned int piece_spec_get_row(const Piece_Spec *spec, Piece_Orient o, int y)
+{
+    return (piece_spec_get_mask(spec, o) >> (y * PIECE_MAX_COLS)) & 0xF;
+}
 
-        case PIECE_ORIENT_RIGHT:
-        {
-            x_t = y;
-            y_t = spec->rows - 1 - x;
-            if (y_t < 0) return 0;
-        } break;
+// --------------------------------------------------------------------
 
-        default:
-        {
-            x_t = x;
-            y_t = y;
-        } break;
+/*
+ * Row-mask boards: one uint16_t per row, bit N is column N, row 0 at the
+ * top. Used by the engine's fast collision path and by the AI search.
+ */
+
+// Moves a row mask `x` columns right; false if anything falls off either side.
+static inline bool piece_shift_row(uint16_t mask, int x, int cols, uint16_t *out)
+{
+    uint32_t shifted;
+    if (x >= 0)
+    {
+        shifted = (uint32_t)mask << x;
+    }
+    else
+    {
+        if (mask & ((1u << -x) - 1)) return false;
+        shifted = (uint32_t)mask >> -x;
     }
+    if (shifted & ~((1u << cols) - 1)) return false;
+    *out = (uint16_t)shifted;
+    return true;
+}
 
-    //printf("o = %d; x = %d; x_t = %d; y = %d, y_t = %d\n", o, x, x_t, y, y_t);
+static inline bool piece_fits(const uint16_t *board, int cols, int rows, Piece_Kind kind, Piece_Orient o, int x, int y)
+{
+    unsigned int mask = piece_spec_get_mask(piece_spec_get_by_kind(kind), o);
+    for (int row = 0; mask; row++, mask >>= PIECE_MAX_COLS)
+    {
+        uint16_t bits = (uint16_t)(mask & 0xF);
+        if (!bits) continue;
+        int board_row = y + row;
+        if (board_row < 0 || board_row >= rows) return false;
+        uint16_t shifted;
+        if (!piece_shift_row(bits, x, cols, &shifted)) return false;
+        if (board[board_row] & shifted) return false;
+    }
+    return true;
+}
 
-    //if (x_t >= spec->cols || y_t >= spec->rows) return 0;
+// --------------------------------------------------------------------
 
-    return spec->blocks[y_t * PIECE_MAX_COLS + x_t];
-}
+// Quarter turns clockwise.
+typedef enum {
+    PIECE_ROTATE_CW = 1,
+    PIECE_ROTATE_180 = 2,
+    PIECE_ROTATE_CCW = 3,
+} Piece_Rotation;
 
-static const Piece_Spec Piece_Spec_T = (Piece_Spec){
-    .cols = 3,
-    .rows = 2,
-    .color = (Col_3f){0.6f, 0.1f, 0.6f},
-    .kind = PIECE_T,
-    .blocks = {
-        0, 1, 0, 0,
-        1, 1, 1, 0,
-        0, 0 ,0, 0,
-        0, 0 ,0, 0,
-    },
-};
+typedef enum {
+    PIECE_KICKS_JLSTZ,
+    PIECE_KICKS_I,
+    PIECE_KICKS_O,
+    PIECE_KICKS_COUNT
+} Piece_Kick_Set;
 
-static const Piece_Spec Piece_Spec_L = (Piece_Spec){
-    .cols = 2,
-    .rows = 3,
-    .color = (Col_3f){0.7f, 0.4f, 0.1f},
-    .kind = PIECE_L,
-    .blocks = {
-        1, 0, 0, 0,
-        1, 0, 0, 0,
-        1, 1 ,0, 0,
-        0, 0 ,0, 0,
-    },
-};
+#define PIECE_KICK_MAX_TESTS 6
 
-static const Piece_Spec Piece_Spec_S = (Piece_Spec){
-    .cols = 2,
-    .rows = 3,
-    .color = (Col_3f){0.25f, 0.75f, 0.2f},
-    .kind = PIECE_S,
-    .blocks = {
-        1, 0, 0, 0,
-        1, 1, 0, 0,
-        0, 1 ,0, 0,
-        0, 0 ,0, 0,
-    },
-};
+typedef struct {
+    int8_t x, y;
+} Piece_Kick;
 
-static const Piece_Spec Piece_Spec_O = (Piece_Spec){
-    .cols = 2,
-    .rows = 2,
-    .color = (Col_3f){0.75f, 0.75f, 0.1f},
-    .kind = PIECE_O,
-    .blocks = {
-        1, 1, 0, 0,
-        1, 1, 0, 0,
-        0, 0 ,0, 0,
-        0, 0 ,0, 0,
-    },
-};
+typedef struct {
+    uint8_t count;
+    Piece_Kick tests[PIECE_KICK_MAX_TESTS];
+} Piece_Kick_List;
+
+/*
+ * Super Rotation System kick tests, tried in order until one fits.
+ * Written as in the SRS tables (+y is up) and flipped to board rows by
+ * SRS_KICK, and keyed by SRS state, UP/RIGHT/DOWN/LEFT standing for
+ * 0/R/2/L; piece_kicks_get maps an orientation to its state. The offsets
+ * apply on top of this file's own rotation frames, which are anchored at
+ * the top-left rather than at SRS's pivots.
+ * 180 tests aren't part of SRS proper; these are the usual extension.
+ */
+#define SRS_KICK(x, y) {(x), -(y)}
+#define SRS_KICKS(n, ...) {.count = (n), .tests = {__VA_ARGS__}}
 
-static const Piece_Spec Piece_Spec_I = (Piece_Spec){
-    .cols = 4,
-    .rows = 1,
-    .color = (Col_3f){0.4f, 0.4f, 0.7f},
-    .kind = PIECE_I,
-    .blocks = {
-        1, 1, 1, 1,
-        0, 0, 0, 0,
-        0, 0 ,0, 0,
-        0, 0 ,0, 0,
+#define SRS_KICKS_180                                                                                                        \
+    [PIECE_ORIENT_UP]    = SRS_KICKS(6, SRS_KICK(0, 0), SRS_KICK(0, 1), SRS_KICK(1, 1), SRS_KICK(-1, 1), SRS_KICK(1, 0), SRS_KICK(-1, 0)),   \
+    [PIECE_ORIENT_RIGHT] = SRS_KICKS(6, SRS_KICK(0, 0), SRS_KICK(1, 0), SRS_KICK(1, 2), SRS_KICK(1, 1), SRS_KICK(0, 2), SRS_KICK(0, 1)),    \
+    [PIECE_ORIENT_DOWN]  = SRS_KICKS(6, SRS_KICK(0, 0), SRS_KICK(0, -1), SRS_KICK(-1, -1), SRS_KICK(1, -1), SRS_KICK(-1, 0), SRS_KICK(1, 0)), \
+    [PIECE_ORIENT_LEFT]  = SRS_KICKS(6, SRS_KICK(0, 0), SRS_KICK(-1, 0), SRS_KICK(-1, 2), SRS_KICK(-1, 1), SRS_KICK(0, 2), SRS_KICK(0, 1)),
+
+// Indexed [set][rotation - 1][from SRS state].
+static const Piece_Kick_List piece_kicks[PIECE_KICKS_COUNT][3][PIECE_ORIENT_COUNT] = {
+    [PIECE_KICKS_JLSTZ] = {
+        [PIECE_ROTATE_CW - 1] = {
+            [PIECE_ORIENT_UP]    = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(-1, 0), SRS_KICK(-1, 1), SRS_KICK(0, -2), SRS_KICK(-1, -2)),
+            [PIECE_ORIENT_RIGHT] = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(1, 0), SRS_KICK(1, -1), SRS_KICK(0, 2), SRS_KICK(1, 2)),
+            [PIECE_ORIENT_DOWN]  = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(1, 0), SRS_KICK(1, 1), SRS_KICK(0, -2), SRS_KICK(1, -2)),
+            [PIECE_ORIENT_LEFT]  = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(-1, 0), SRS_KICK(-1, -1), SRS_KICK(0, 2), SRS_KICK(-1, 2)),
+        },
+        [PIECE_ROTATE_180 - 1] = { SRS_KICKS_180 },
+        [PIECE_ROTATE_CCW - 1] = {
+            [PIECE_ORIENT_UP]    = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(1, 0), SRS_KICK(1, 1), SRS_KICK(0, -2), SRS_KICK(1, -2)),
+            [PIECE_ORIENT_RIGHT] = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(1, 0), SRS_KICK(1, -1), SRS_KICK(0, 2), SRS_KICK(1, 2)),
+            [PIECE_ORIENT_DOWN]  = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(-1, 0), SRS_KICK(-1, 1), SRS_KICK(0, -2), SRS_KICK(-1, -2)),
+            [PIECE_ORIENT_LEFT]  = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(-1, 0), SRS_KICK(-1, -1), SRS_KICK(0, 2), SRS_KICK(-1, 2)),
+        },
+    },
+    [PIECE_KICKS_I] = {
+        [PIECE_ROTATE_CW - 1] = {
+            [PIECE_ORIENT_UP]    = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(-2, 0), SRS_KICK(1, 0), SRS_KICK(-2, -1), SRS_KICK(1, 2)),
+            [PIECE_ORIENT_RIGHT] = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(-1, 0), SRS_KICK(2, 0), SRS_KICK(-1, 2), SRS_KICK(2, -1)),
+            [PIECE_ORIENT_DOWN]  = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(2, 0), SRS_KICK(-1, 0), SRS_KICK(2, 1), SRS_KICK(-1, -2)),
+            [PIECE_ORIENT_LEFT]  = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(1, 0), SRS_KICK(-2, 0), SRS_KICK(1, -2), SRS_KICK(-2, 1)),
+        },
+        [PIECE_ROTATE_180 - 1] = { SRS_KICKS_180 },
+        [PIECE_ROTATE_CCW - 1] = {
+            [PIECE_ORIENT_UP]    = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(-1, 0), SRS_KICK(2, 0), SRS_KICK(-1, 2), SRS_KICK(2, -1)),
+            [PIECE_ORIENT_RIGHT] = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(2, 0), SRS_KICK(-1, 0), SRS_KICK(2, 1), SRS_KICK(-1, -2)),
+            [PIECE_ORIENT_DOWN]  = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(1, 0), SRS_KICK(-2, 0), SRS_KICK(1, -2), SRS_KICK(-2, 1)),
+            [PIECE_ORIENT_LEFT]  = SRS_KICKS(5, SRS_KICK(0, 0), SRS_KICK(-2, 0), SRS_KICK(1, 0), SRS_KICK(-2, -1), SRS_KICK(1, 2)),
+        },
+    },
+    [PIECE_KICKS_O] = {
+        [PIECE_ROTATE_CW - 1]  = { [0 ... PIECE_ORIENT_COUNT - 1] = SRS_KICKS(1, SRS_KICK(0, 0)) },
+        [PIECE_ROTATE_180 - 1] = { [0 ... PIECE_ORIENT_COUNT - 1] = SRS_KICKS(1, SRS_KICK(0, 0)) },
+        [PIECE_ROTATE_CCW - 1] = { [0 ... PIECE_ORIENT_COUNT - 1] = SRS_KICKS(1, SRS_KICK(0, 0)) },
     },
 };
 
-static const Piece_Spec Piece_Spec_J = (Piece_Spec){
-    .cols = 2,
-    .rows = 3,
-    .color = (Col_3f){0.15f, 0.15f, 0.6f},
-    .kind = PIECE_J,
-    .blocks = {
-        0, 1, 0, 0,
-        0, 1, 0, 0,
-        1, 1 ,0, 0,
-        0, 0 ,0, 0,
-    },
+#undef SRS_KICKS_180
+
+static const uint8_t piece_kick_set_by_kind[PIECE_KIND_COUNT] = {
+    [PIECE_T] = PIECE_KICKS_JLSTZ,
+    [PIECE_L] = PIECE_KICKS_JLSTZ,
+    [PIECE_S] = PIECE_KICKS_JLSTZ,
+    [PIECE_O] = PIECE_KICKS_O,
+    [PIECE_I] = PIECE_KICKS_I,
+    [PIECE_J] = PIECE_KICKS_JLSTZ,
+    [PIECE_Z] = PIECE_KICKS_JLSTZ,
 };
 
-static const Piece_Spec Piece_Spec_Z = (Piece_Spec){
-    .cols = 2,
-    .rows = 3,
-    .color = (Col_3f){0.6f, 0.15f, 0.15f},
-    .kind = PIECE_Z,
-    .blocks = {
-        0, 1, 0, 0,
-        1, 1, 0, 0,
-        1, 0 ,0, 0,
-        0, 0 ,0, 0,
-    },
+/*
+ * The SRS state of each kind's UP frame, in quarter turns clockwise from
+ * SRS's spawn state. L, J, S and Z are upright in UP, where SRS spawns
+ * them flat: L's UP is SRS's R, J's is L.
+ */
+static const uint8_t piece_srs_state_of_up[PIECE_KIND_COUNT] = {
+    [PIECE_T] = 0,
+    [PIECE_L] = 1,
+    [PIECE_S] = 1,
+    [PIECE_O] = 0,
+    [PIECE_I] = 0,
+    [PIECE_J] = 3,
+    [PIECE_Z] = 1,
 };
 
-static inline const Piece_Spec *piece_spec_get_by_kind(Piece_Kind kind)
+static inline const Piece_Kick_List *piece_kicks_get(Piece_Kind kind, Piece_Orient from, Piece_Rotation rot)
+{
+    if ((unsigned)kind >= PIECE_KIND_COUNT) kind = PIECE_T;
+    int state = (from + piece_srs_state_of_up[kind]) & (PIECE_ORIENT_COUNT - 1);
+    return &piece_kicks[piece_kick_set_by_kind[kind]][rot - 1][state];
+}
+
+/*
+ * Rotates `p` on a row-mask board, trying each kick in turn. On success
+ * `out` gets the rotated piece at the first offset that fits.
+ */
+static inline bool piece_try_rotate(const uint16_t *board, int cols, int rows, const Piece *p, Piece_Rotation rot, Piece *out)
 {
-    switch (kind)
+    Piece_Orient to = (Piece_Orient)((p->orient + rot) & (PIECE_ORIENT_COUNT - 1));
+    const Piece_Kick_List *kicks = piece_kicks_get(p->kind, p->orient, rot);
+    for (int i = 0; i < kicks->count; i++)
     {
-        case PIECE_T: return &Piece_Spec_T;
-        case PIECE_L: return &Piece_Spec_L;
-        case PIECE_S: return &Piece_Spec_S;
-        case PIECE_O: return &Piece_Spec_O;
-        case PIECE_I: return &Piece_Spec_I;
-        case PIECE_J: return &Piece_Spec_J;
-        case PIECE_Z: return &Piece_Spec_Z;
-        default: return &Piece_Spec_T;
+        int x = p->x + kicks->tests[i].x;
+        int y = p->y + kicks->tests[i].y;
+        if (piece_fits(board, cols, rows, p->kind, to, x, y))
+        {
+            *out = *p;
+            out->x = x;
+            out->y = y;
+            out->orient = to;
+            return true;
+        }
     }
+    return false;
+}
+
+// --------------------------------------------------------------------
+
+typedef struct {
+    Col_3f inner;
+    Col_3f border;
+} Block_Colors;
+
+// Everything draw needs per kind, so nothing is computed per block.
+typedef struct {
+    Block_Colors normal;
+    Block_Colors game_over;
+} Piece_Colors;
+
+#define PIECE_COLORS(r, g, b) {                                                                                \
+    .normal    = {{(r), (g), (b)}, {(r) * 0.8f, (g) * 0.8f, (b) * 0.8f}},                                        \
+    .game_over = {{(r) * 0.4f, (g) * 0.4f, (b) * 0.4f}, {(r) * 0.4f * 0.8f, (g) * 0.4f * 0.8f, (b) * 0.4f * 0.8f}}, \
+}
+
+static const Piece_Colors piece_colors[PIECE_KIND_COUNT + 1] = {
+    [PIECE_T] = PIECE_COLORS(0.6f, 0.1f, 0.6f),
+    [PIECE_L] = PIECE_COLORS(0.7f, 0.4f, 0.1f),
+    [PIECE_S] = PIECE_COLORS(0.25f, 0.75f, 0.2f),
+    [PIECE_O] = PIECE_COLORS(0.75f, 0.75f, 0.1f),
+    [PIECE_I] = PIECE_COLORS(0.4f, 0.4f, 0.7f),
+    [PIECE_J] = PIECE_COLORS(0.15f, 0.15f, 0.6f),
+    [PIECE_Z] = PIECE_COLORS(0.6f, 0.15f, 0.15f),
+    [PIECE_GARBAGE] = PIECE_COLORS(0.45f, 0.45f, 0.45f),
+};
+
+static inline const Piece_Colors *piece_colors_get_by_kind(Piece_Kind kind)
+{
+    if ((unsigned)kind > PIECE_GARBAGE) return &piece_colors[PIECE_T];
+    return &piece_colors[kind];
 }
 
+// One letter per kind for text formats (puzzles, perft's --pieces), '#' for garbage.
+static const char piece_letters[] = "TLSOIJZ#";
+
+static inline char piece_kind_letter(Piece_Kind kind)
+{
+    if ((unsigned)kind > PIECE_GARBAGE) return '?';
+    return piece_letters[kind];
+}
 
+// PIECE_KIND_COUNT if `c` doesn't name a piece.
+static inline Piece_Kind piece_kind_from_letter(char c)
+{
+    for (int kind = 0; kind < PIECE_KIND_COUNT; kind++)
+    {
+        if (piece_letters[kind] == c) return (Piece_Kind)kind;
+    }
+    return PIECE_KIND_COUNT;
+}
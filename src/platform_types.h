@@ -75,3 +75,8 @@ typedef struct {
     float fps_instant;
 } Platform_Timing;
 
+// From on_frame_schedule, for hosts that can sleep between frames.
+typedef struct {
+    bool drew;              // The last on_frame drew; if not, the image from before it is still current.
+    float wait;             // Seconds until on_frame is next needed: 0 right away, negative only after an event.
+} Platform_Frame_Schedule;
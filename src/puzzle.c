@@ -0,0 +1,477 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tetris.h"
+#include "puzzle.h"
+
+/*
+ * Loads a puzzle (format in puzzle.h) into `p`, and its board into `s`,
+ * which is (re)started at the board's size with the first piece in play.
+ * `s` must be zeroed or a game from initialize_game_with_seed.
+ */
+bool puzzle_load(Game_State *s, Puzzle *p, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        fprintf(stderr, "Puzzle: couldn't open %s\n", path);
+        return false;
+    }
+
+    char board[MOVEGEN_MAX_ROWS][64];
+    int board_rows = 0, cols = 0, version = 0;
+    bool ok = true, in_board = false;
+    char line[256], goal[16] = "";
+    memset(p, 0, sizeof(*p));
+
+    while (ok && fgets(line, sizeof(line), f))
+    {
+        size_t len = strcspn(line, "\r\n");
+        line[len] = 0;
+        if (in_board)
+        {
+            if (len == 0) continue;
+            ok = board_rows < MOVEGEN_MAX_ROWS && len >= 4 && len <= 16 && (cols == 0 || (int)len == cols);
+            if (ok)
+            {
+                cols = (int)len;
+                memcpy(board[board_rows++], line, len + 1);
+            }
+            continue;
+        }
+
+        char pieces[PUZZLE_MAX_PIECES + 2];
+        if (len == 0 || line[0] == '#') continue;
+        else if (sscanf(line, " tetris-puzzle %d", &version) == 1) ok = version == PUZZLE_FILE_VERSION;
+        else if (sscanf(line, " goal %15s %d", goal, &p->goal_lines) == 2)
+        {
+            ok = p->goal_lines >= 1;
+            if      (!strcmp(goal, "clear")) p->goal = PUZZLE_GOAL_CLEAR;
+            else if (!strcmp(goal, "lines")) p->goal = PUZZLE_GOAL_LINES;
+            else ok = false;
+        }
+        else if (sscanf(line, " pieces %33s", pieces) == 1)
+        {
+            p->piece_count = 0;
+            for (const char *c = pieces; ok && *c; c++)
+            {
+                Piece_Kind kind = piece_kind_from_letter(*c);
+                ok = kind != PIECE_KIND_COUNT && p->piece_count < PUZZLE_MAX_PIECES;
+                if (ok) p->pieces[p->piece_count++] = kind;
+            }
+        }
+        else if (!strcmp(line, "board")) in_board = true;
+        else ok = false;
+    }
+    fclose(f);
+
+    if (!ok || version != PUZZLE_FILE_VERSION || !goal[0] || p->piece_count == 0)
+    {
+        fprintf(stderr, "Puzzle: malformed puzzle %s\n", path);
+        return false;
+    }
+
+    int rows = board_rows > TETRIS_ROWS ? board_rows : TETRIS_ROWS;
+    if (cols == 0) cols = TETRIS_COLS;
+    if (p->goal == PUZZLE_GOAL_CLEAR && p->goal_lines > rows)
+    {
+        fprintf(stderr, "Puzzle: %s clears %d rows of a %d row board\n", path, p->goal_lines, rows);
+        return false;
+    }
+
+    s->tetris_cols = cols;
+    s->tetris_rows = rows;
+    initialize_game_with_seed(s, 1);
+
+    int preset_id = s->piece_id_seed++;
+    for (int i = 0; i < board_rows; i++)
+    {
+        int y = rows - board_rows + i;
+        for (int x = 0; x < cols; x++)
+        {
+            char c = board[i][x];
+            Piece_Kind kind = piece_kind_from_letter(c);
+            Block *b = get_block_at(s, x, y);
+            if (c == '#') *b = (Block){.piece_id = GARBAGE_PIECE_ID, .piece_kind = PIECE_GARBAGE};
+            else if (kind != PIECE_KIND_COUNT) *b = (Block){.piece_id = preset_id, .piece_kind = kind};
+            else if (c != '.')
+            {
+                fprintf(stderr, "Puzzle: unexpected '%c' in the board of %s\n", c, path);
+                return false;
+            }
+        }
+    }
+    rebuild_row_masks(s);
+
+    const uint16_t full = (uint16_t)((1u << cols) - 1);
+    for (int y = 0; y < rows; y++)
+    {
+        bool above_goal = p->goal == PUZZLE_GOAL_CLEAR && y < rows - p->goal_lines;
+        if (s->row_masks[y] == full || (above_goal && s->row_masks[y]))
+        {
+            fprintf(stderr, "Puzzle: row %d of %s is %s\n", rows - y, path, above_goal ? "above the clear" : "already full");
+            return false;
+        }
+    }
+
+    Piece first = {.id = s->piece_id_seed++, .x = 3, .y = 0, .kind = p->pieces[0]};
+    if (!set_current_piece(s, first))
+    {
+        fprintf(stderr, "Puzzle: the first piece of %s doesn't fit\n", path);
+        return false;
+    }
+    s->stats.piece_inputs = 0;
+    s->stats.spawn_x = first.x;
+    s->stats.spawn_orient = first.orient;
+    return true;
+}
+
+// --------------------------------------------------------------------
+
+#define PUZZLE_SEEN_BITS 20
+
+typedef struct {
+    uint16_t rows[MOVEGEN_MAX_ROWS];
+    int next;           // Pieces placed so far.
+    int cleared;
+    int filled;         // Cells.
+} Puzzle_Node;
+
+typedef struct {
+    Puzzle_Node node;
+    Puzzle_Move moves[PUZZLE_MAX_PIECES];  // The placements that led to `node`, then the rest once solved.
+} Puzzle_Task;
+
+typedef struct {
+    const Puzzle *puzzle;
+    int cols, rows;
+
+    Puzzle_Task *tasks;
+    int task_count;
+    _Atomic int next_task;
+    _Atomic int solved_task;    // Lowest task solved so far, INT_MAX until then.
+
+    // Hashes of states with no solution below them. Lossy: a slot keeps whichever state wrote last.
+    _Atomic uint64_t *seen;
+    _Atomic uint64_t nodes;
+} Puzzle_Search;
+
+static inline uint64_t puzzle_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Never 0, which marks an empty slot.
+static uint64_t puzzle_hash(const Puzzle_Node *n, int rows)
+{
+    uint64_t h = puzzle_mix(((uint64_t)n->next << 32) | (uint64_t)n->cleared);
+    for (int y = 0; y < rows; y += 4)
+    {
+        uint64_t chunk = 0;
+        for (int k = 0; k < 4 && y + k < rows; k++) chunk |= (uint64_t)n->rows[y + k] << (16 * k);
+        h = puzzle_mix(h ^ chunk);
+    }
+    return h | 1;
+}
+
+static bool puzzle_goal_met(const Puzzle_Search *search, const Puzzle_Node *n)
+{
+    if (search->puzzle->goal == PUZZLE_GOAL_CLEAR) return n->filled == 0 && n->next > 0;
+    return n->cleared >= search->puzzle->goal_lines;
+}
+
+// Lowest row a piece may reach into, which for a perfect clear drops as lines clear.
+static int puzzle_top_row(const Puzzle_Search *search, const Puzzle_Node *n)
+{
+    if (search->puzzle->goal == PUZZLE_GOAL_LINES) return 0;
+    return search->rows - (search->puzzle->goal_lines - n->cleared);
+}
+
+/*
+ * Whether the pieces left could still reach the goal, judged from counts
+ * alone.
+ *
+ * A perfect clear fills every empty cell under its ceiling, so those
+ * cells fix how many pieces it takes. Coloring columns alternately, a
+ * clear takes as many cells of each color on an even-width board, and
+ * each piece covers as many of each except: a standing I (4 of one
+ * color), an L or J (3 and 1) and a standing T (3 and 1). The imbalance
+ * of the empty cells has to be made up by those pieces.
+ *
+ * Clearing n more lines means filling n distinct rows, so at least as
+ * many cells as the n fullest rows are missing.
+ */
+static bool puzzle_viable(const Puzzle_Search *search, const Puzzle_Node *n)
+{
+    const Puzzle *p = search->puzzle;
+    const int cols = search->cols, rows = search->rows;
+    const uint32_t full = (1u << cols) - 1;
+    int pieces_left = p->piece_count - n->next;
+
+    if (p->goal == PUZZLE_GOAL_LINES)
+    {
+        int empty_rows[17] = {0};
+        for (int y = 0; y < rows; y++) empty_rows[cols - __builtin_popcount(n->rows[y])]++;
+        int need = p->goal_lines - n->cleared, cells = 0;
+        for (int empty = 0; empty <= cols && need > 0; empty++)
+        {
+            int take = empty_rows[empty] < need ? empty_rows[empty] : need;
+            cells += take * empty;
+            need -= take;
+        }
+        return cells <= 4 * pieces_left;
+    }
+
+    int top = puzzle_top_row(search, n);
+    int empty = cols * (rows - top) - n->filled;
+    if (empty <= 0 || empty % 4 != 0 || empty / 4 > pieces_left) return false;
+
+    // A column filled up to the ceiling walls off each side: nothing crosses it, and every row
+    // clears on both sides at once, so each side has to fill on its own.
+    uint32_t walls = full;
+    for (int y = top; y < rows; y++) walls &= n->rows[y];
+    for (uint32_t open = walls ? full & ~walls : 0; open;)
+    {
+        uint32_t run = open & ~(open + (open & -open));
+        int cells = 0;
+        for (int y = top; y < rows; y++) cells += __builtin_popcount(~(uint32_t)n->rows[y] & run);
+        if (cells % 4 != 0) return false;
+        open &= ~run;
+    }
+
+    if (cols % 2 != 0) return true;
+
+    const uint32_t even_cols = 0x5555u & full;
+    int imbalance = 0;
+    for (int y = top; y < rows; y++)
+    {
+        uint32_t open = ~(uint32_t)n->rows[y] & full;
+        imbalance += __builtin_popcount(open & even_cols) - __builtin_popcount(open & ~even_cols);
+    }
+    if (imbalance < 0) imbalance = -imbalance;
+
+    int i_pieces = 0, t_pieces = 0, lj_pieces = 0;
+    for (int i = n->next; i < n->next + empty / 4; i++)
+    {
+        Piece_Kind kind = p->pieces[i];
+        i_pieces += kind == PIECE_I;
+        t_pieces += kind == PIECE_T;
+        lj_pieces += kind == PIECE_L || kind == PIECE_J;
+    }
+    if (imbalance > 4 * i_pieces + 2 * (t_pieces + lj_pieces)) return false;
+    // Without a T to adjust by 2, L and J fix the imbalance modulo 4.
+    return t_pieces > 0 || (imbalance - 2 * lj_pieces) % 4 == 0;
+}
+
+// Locks the next piece at (x, y) and clears any full rows.
+static void puzzle_place(const Puzzle_Search *search, Puzzle_Node *n, Piece_Kind kind, int o, int x, int y)
+{
+    const Piece_Spec *spec = piece_spec_get_by_kind(kind);
+    for (int row = 0; row < PIECE_MAX_ROWS; row++)
+    {
+        unsigned int bits = piece_spec_get_row(spec, (Piece_Orient)o, row);
+        if (bits) n->rows[y + row] |= (uint16_t)(bits << x);
+    }
+    n->filled += 4;
+    n->next++;
+
+    const uint16_t full = (uint16_t)((1u << search->cols) - 1);
+    int dst = search->rows - 1;
+    for (int src = search->rows - 1; src >= 0; src--)
+    {
+        if (n->rows[src] != full) n->rows[dst--] = n->rows[src];
+        else
+        {
+            n->cleared++;
+            n->filled -= search->cols;
+        }
+    }
+    while (dst >= 0) n->rows[dst--] = 0;
+}
+
+// Calls `visit` on each placement of the next piece within the ceiling, lowest rows first. Stops early on a nonzero return.
+typedef int Puzzle_Visit_Fn(void *ctx, const Puzzle_Node *child, const Puzzle_Move *move);
+
+static int puzzle_for_each_child(const Puzzle_Search *search, const Puzzle_Node *n, Puzzle_Visit_Fn *visit, void *ctx)
+{
+    Piece spawn = {.x = 3, .y = 0, .kind = search->puzzle->pieces[n->next]};
+    if (!piece_fits(n->rows, search->cols, search->rows, spawn.kind, spawn.orient, spawn.x, spawn.y)) return 0;
+
+    Movegen_Locks locks;
+    movegen_locks(n->rows, search->cols, search->rows, &spawn, &locks);
+    int top = puzzle_top_row(search, n);
+    for (int y = search->rows - 1; y >= top; y--)
+    {
+        for (int o = 0; o < PIECE_ORIENT_COUNT; o++)
+        {
+            for (uint32_t xs = locks.at[o][y]; xs; xs &= xs - 1)
+            {
+                Puzzle_Move move = {.kind = spawn.kind, .orient = (Piece_Orient)o, .x = __builtin_ctz(xs), .y = y};
+                Puzzle_Node child = *n;
+                puzzle_place(search, &child, spawn.kind, o, move.x, move.y);
+                int result = visit(ctx, &child, &move);
+                if (result) return result;
+            }
+        }
+    }
+    return 0;
+}
+
+// --------------------------------------------------------------------
+
+typedef struct {
+    Puzzle_Search *search;
+    int task;
+    Puzzle_Move *path;
+    uint64_t nodes;
+} Puzzle_Worker;
+
+static int puzzle_dfs(Puzzle_Worker *w, const Puzzle_Node *n);
+
+static int puzzle_dfs_visit(void *ctx, const Puzzle_Node *child, const Puzzle_Move *move)
+{
+    Puzzle_Worker *w = ctx;
+    w->path[child->next - 1] = *move;
+    return puzzle_dfs(w, child);
+}
+
+// 1 if `n` leads to the goal (with the way there in w->path), 0 if not, -1 if a lower task has been solved meanwhile.
+static int puzzle_dfs(Puzzle_Worker *w, const Puzzle_Node *n)
+{
+    Puzzle_Search *search = w->search;
+    w->nodes++;
+    if (puzzle_goal_met(search, n)) return 1;
+    if (n->next == search->puzzle->piece_count || !puzzle_viable(search, n)) return 0;
+    if (atomic_load_explicit(&search->solved_task, memory_order_relaxed) < w->task) return -1;
+
+    uint64_t hash = puzzle_hash(n, search->rows);
+    _Atomic uint64_t *slot = &search->seen[hash & ((1u << PUZZLE_SEEN_BITS) - 1)];
+    if (atomic_load_explicit(slot, memory_order_relaxed) == hash) return 0;
+
+    int result = puzzle_for_each_child(search, n, puzzle_dfs_visit, w);
+    if (result == 0) atomic_store_explicit(slot, hash, memory_order_relaxed);
+    return result;
+}
+
+typedef struct {
+    Puzzle_Search *search;
+    int levels;
+    Puzzle_Move path[PUZZLE_MAX_PIECES];
+} Puzzle_Split;
+
+static int puzzle_split(Puzzle_Split *split, const Puzzle_Node *n);
+
+static int puzzle_split_visit(void *ctx, const Puzzle_Node *child, const Puzzle_Move *move)
+{
+    Puzzle_Split *split = ctx;
+    split->path[child->next - 1] = *move;
+    return puzzle_split(split, child);
+}
+
+// Tasks are the positions `levels` pieces in, or fewer where the search ends early, in the order the search would meet them.
+static int puzzle_split(Puzzle_Split *split, const Puzzle_Node *n)
+{
+    Puzzle_Search *search = split->search;
+    bool leaf = n->next == split->levels || n->next == search->puzzle->piece_count || puzzle_goal_met(search, n);
+    if (!leaf)
+    {
+        if (!puzzle_viable(search, n)) return 0;
+        return puzzle_for_each_child(search, n, puzzle_split_visit, split);
+    }
+
+    if (search->task_count % 256 == 0)
+    {
+        Puzzle_Task *grown = mem_alloc(sizeof(Puzzle_Task) * (size_t)(search->task_count + 256));
+        if (search->task_count) memcpy(grown, search->tasks, sizeof(Puzzle_Task) * (size_t)search->task_count);
+        mem_free(search->tasks);
+        search->tasks = grown;
+    }
+    Puzzle_Task *task = &search->tasks[search->task_count++];
+    task->node = *n;
+    memcpy(task->moves, split->path, sizeof(Puzzle_Move) * (size_t)n->next);
+    return 0;
+}
+
+static void *puzzle_worker_main(void *arg)
+{
+    Puzzle_Search *search = arg;
+    uint64_t nodes = 0;
+    for (;;)
+    {
+        int i = atomic_fetch_add_explicit(&search->next_task, 1, memory_order_relaxed);
+        if (i >= search->task_count || i > atomic_load(&search->solved_task)) break;
+
+        Puzzle_Worker w = {.search = search, .task = i, .path = search->tasks[i].moves};
+        if (puzzle_dfs(&w, &search->tasks[i].node) == 1)
+        {
+            int solved = atomic_load(&search->solved_task);
+            while (i < solved && !atomic_compare_exchange_weak(&search->solved_task, &solved, i)) {}
+        }
+        nodes += w.nodes;
+    }
+    atomic_fetch_add_explicit(&search->nodes, nodes, memory_order_relaxed);
+    return NULL;
+}
+
+/*
+ * Searches for a way to play the puzzle's pieces from the board in `s`.
+ * The first few placements are shared out between `threads` threads; the
+ * answer is the first one in search order whatever the thread count.
+ */
+bool puzzle_solve(const Game_State *s, const Puzzle *p, int threads, Puzzle_Solution *out)
+{
+    Puzzle_Search search = {.puzzle = p, .cols = s->tetris_cols, .rows = s->tetris_rows, .solved_task = INT_MAX};
+    Puzzle_Node root = {0};
+    memcpy(root.rows, s->row_masks, sizeof(uint16_t) * (size_t)s->tetris_rows);
+    for (int y = 0; y < s->tetris_rows; y++) root.filled += __builtin_popcount(root.rows[y]);
+
+    memset(out, 0, sizeof(*out));
+    search.seen = mem_calloc((size_t)1 << PUZZLE_SEEN_BITS, sizeof(*search.seen));
+    if (!search.seen)
+    {
+        fprintf(stderr, "Puzzle: couldn't allocate the search table\n");
+        return false;
+    }
+
+    // Tasks start after the first placement, or the first two when there are threads to balance.
+    Puzzle_Split split = {.search = &search, .levels = threads > 1 ? 2 : 1};
+    puzzle_split(&split, &root);
+
+    if (threads <= 1) puzzle_worker_main(&search);
+    else
+    {
+        pthread_t ids[256];
+        if (threads > 256) threads = 256;
+        for (int i = 0; i < threads; i++) pthread_create(&ids[i], NULL, puzzle_worker_main, &search);
+        for (int i = 0; i < threads; i++) pthread_join(ids[i], NULL);
+    }
+
+    int solved = atomic_load(&search.solved_task);
+    out->nodes = atomic_load(&search.nodes);
+    if (solved != INT_MAX)
+    {
+        // The path is only written up to where the goal was met, so play it back to find its length.
+        out->solved = true;
+        memcpy(out->moves, search.tasks[solved].moves, sizeof(out->moves));
+        Puzzle_Node replay = root;
+        while (!puzzle_goal_met(&search, &replay))
+        {
+            const Puzzle_Move *m = &out->moves[replay.next];
+            puzzle_place(&search, &replay, m->kind, m->orient, m->x, m->y);
+        }
+        out->move_count = replay.next;
+    }
+
+    mem_free(search.tasks);
+    mem_free((void *)search.seen);
+    return out->solved;
+}
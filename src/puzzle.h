@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "common.h"
+#include "pieces.h"
+#include "movegen.h"
+
+/*
+ * Puzzles: a partly filled board, the pieces that will come, and a goal,
+ * either a perfect clear within the bottom N rows or N lines cleared.
+ *
+ * Text format, '#' starting a comment line:
+ *   tetris-puzzle 1
+ *   pieces ILJOTSZIL
+ *   goal clear 4        (or: goal lines 2)
+ *   board
+ *   ##....####
+ *   ###...####
+ * Board lines run top to bottom and sit on the floor; their width sets
+ * the board's. '.' is empty, '#' garbage, a piece letter a cell of that
+ * piece. The first piece spawns as the game's current piece.
+ *
+ * The solver is a depth-first search over movegen placements, so every
+ * answer can be played with the engine's own moves. It prunes on cell
+ * counts and, for perfect clears, on column parity, and remembers states
+ * it has already failed from in a table shared by all threads.
+ */
+
+#define PUZZLE_FILE_VERSION 1
+#define PUZZLE_MAX_PIECES 32
+
+typedef enum {
+    PUZZLE_GOAL_CLEAR,  // Empty board, never stacking above `goal_lines` rows.
+    PUZZLE_GOAL_LINES,  // `goal_lines` lines cleared.
+} Puzzle_Goal;
+
+typedef struct {
+    Piece_Kind pieces[PUZZLE_MAX_PIECES];
+    int piece_count;
+    Puzzle_Goal goal;
+    int goal_lines;
+} Puzzle;
+
+typedef struct {
+    Piece_Kind kind;
+    Piece_Orient orient;
+    int x, y;
+} Puzzle_Move;
+
+typedef struct {
+    bool solved;
+    Puzzle_Move moves[PUZZLE_MAX_PIECES];
+    int move_count;
+    uint64_t nodes;     // Positions searched, over all threads.
+} Puzzle_Solution;
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "pieces.h"
+
+/*
+ * Redraw scheduling. A frame is drawn only when something on screen may
+ * have changed since the last one: the piece moved, a piece locked, the
+ * host sent an event, the scene was reloaded, particles are in flight
+ * (particles.h). In between, on_frame still steps the simulation, which
+ * costs next to nothing, and the previous image stays up.
+ *
+ * on_frame_schedule tells the host whether the last on_frame drew and how
+ * long it may sleep before the simulation has something to do again: the
+ * next timer due (gravity, lock delay, auto-shift) or queued input. A
+ * finished game waits for input alone. Leaving a frame undrawn needs an
+ * image that survives it: the live scene's FBO does, and so does a host
+ * that asks for the schedule, since it then doesn't swap undrawn frames.
+ */
+
+// Longest sleep on a running game, kept under SIM_MAX_TICKS_PER_ADVANCE so waking late never drops ticks.
+#define REDRAW_MAX_WAIT 0.2f
+// How often to come back while particles fly, or while the bot plays: its moves arrive through a mailbox, not a timer.
+#define REDRAW_POLL_WAIT (1.0f / 60.0f)
+#define REDRAW_STATS_PERIOD 5.0f
+
+// What the last drawn frame showed, beyond the board itself, which only changes when a piece locks.
+typedef struct {
+    Piece piece;
+    int pieces;
+    bool is_game_over;
+    int particles;          // Live ones, so the frame after the last one fades is drawn too.
+} Redraw_Key;
+
+typedef struct {
+    bool dirty;             // Draw the next frame whatever the key says.
+    bool always;            // --redraw always: draw every frame, for comparison.
+    bool host_schedules;    // The host asked for the schedule, so it won't show undrawn frames.
+    bool drew;              // The last on_frame drew.
+    bool waiting_for_event; // The host was told nothing happens until an event.
+    Redraw_Key key;
+
+    // --redraw-stats: counted over REDRAW_STATS_PERIOD and then printed.
+    bool stats;
+    float stats_start;
+    int frames, frames_drawn;
+    double frame_cpu, draw_cpu, process_cpu;    // Seconds of CPU time.
+} Redraw_State;
+
+static inline bool redraw_key_equal(const Redraw_Key *a, const Redraw_Key *b)
+{
+    return a->piece.id == b->piece.id && a->piece.kind == b->piece.kind && a->piece.orient == b->piece.orient &&
+        a->piece.x == b->piece.x && a->piece.y == b->piece.y && a->pieces == b->pieces &&
+        a->is_game_over == b->is_game_over && a->particles == b->particles;
+}
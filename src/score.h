@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+
+/*
+ * Guideline scoring and per-game statistics. Everything here is a plain
+ * counter bumped on the lock and drop paths; nothing is recomputed per
+ * frame, and rates like pieces per second are derived only when reported.
+ */
+
+#define SCORE_LINES_PER_LEVEL 10
+#define SCORE_MAX_CLEAR 4
+
+typedef enum {
+    SPIN_NONE,
+    SPIN_T_MINI,
+    SPIN_T,
+    SPIN_KIND_COUNT
+} Spin_Kind;
+
+// Points per lock before the level multiplier, by spin and lines cleared.
+static const int score_clear_points[SPIN_KIND_COUNT][SCORE_MAX_CLEAR + 1] = {
+    [SPIN_NONE]   = {0, 100, 300, 500, 800},
+    [SPIN_T_MINI] = {100, 200, 400, 400, 400},
+    [SPIN_T]      = {400, 800, 1200, 1600, 1600},
+};
+
+#define SCORE_COMBO_POINTS 50
+#define SCORE_SOFT_DROP_POINTS 1
+#define SCORE_HARD_DROP_POINTS 2
+
+typedef struct {
+    uint64_t score;
+    int level;
+    int lines;
+    int pieces;
+    int clears[SCORE_MAX_CLEAR];    // Singles, doubles, triples, tetrises.
+    int tspins, tspin_minis;
+    int back_to_backs;
+    bool back_to_back;              // The last clear was a tetris or a T-spin.
+    int combo;                      // Clearing locks in a row, minus one; -1 after a lock that cleared nothing.
+    int max_combo;
+    int finesse_faults;
+    int max_height;
+
+    // The piece in play: how it spawned and how many presses it's taken since.
+    int piece_inputs;
+    int spawn_x;
+    int spawn_orient;
+} Game_Stats;
+
+static inline void game_stats_reset(Game_Stats *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->level = 1;
+    st->combo = -1;
+}
+
+static inline void game_stats_add_drop(Game_Stats *st, int cells, bool hard)
+{
+    st->score += (uint64_t)(cells * (hard ? SCORE_HARD_DROP_POINTS : SCORE_SOFT_DROP_POINTS));
+}
+
+// Scores one lock at the current level, then levels up if it earned one.
+static inline void game_stats_on_lock(Game_Stats *st, int cleared, Spin_Kind spin)
+{
+    if (cleared > SCORE_MAX_CLEAR) cleared = SCORE_MAX_CLEAR;
+    int points = score_clear_points[spin][cleared];
+
+    st->pieces++;
+    if (spin == SPIN_T) st->tspins++;
+    else if (spin == SPIN_T_MINI) st->tspin_minis++;
+
+    if (cleared > 0)
+    {
+        bool difficult = cleared == SCORE_MAX_CLEAR || spin != SPIN_NONE;
+        if (difficult && st->back_to_back)
+        {
+            points += points / 2;
+            st->back_to_backs++;
+        }
+        st->back_to_back = difficult;
+
+        st->combo++;
+        if (st->combo > st->max_combo) st->max_combo = st->combo;
+        points += SCORE_COMBO_POINTS * st->combo;
+
+        st->clears[cleared - 1]++;
+        st->lines += cleared;
+    }
+    else
+    {
+        st->combo = -1;
+    }
+
+    st->score += (uint64_t)points * (uint64_t)st->level;
+    st->level = 1 + st->lines / SCORE_LINES_PER_LEVEL;
+}
+
+static inline float game_stats_pieces_per_second(const Game_Stats *st, uint64_t ticks, int tick_hz)
+{
+    return ticks ? (float)st->pieces * (float)tick_hz / (float)ticks : 0.0f;
+}
@@ -0,0 +1,399 @@
+/*
+ * Authoritative game server: one game per connection, all stepped on a
+ * single 240 Hz clock from an epoll loop, speaking the protocol in net.h.
+ *
+ *   bin/server [--port N] [--max-sessions N] [--seed N]
+ *   bin/server --loopback [--sessions N] [--seconds N] [--seed N]
+ *
+ * --loopback runs in-process clients against the same server code with no
+ * sockets, as fast as it can, mirrors every board from the deltas and
+ * checks the mirrors against the server's games. Exits non-zero on any
+ * mismatch. It works on any platform; the network mode needs Linux.
+ */
+
+#define TETRIS_HEADLESS
+#define _GNU_SOURCE // accept4
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+#include "tetris.h"
+#include "net.h"
+
+#include "tetris_core.c"
+#include "sim.c"
+#include "net.c"
+
+static double server_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// --------------------------------------------------------------------
+
+typedef struct {
+    Net_View view;
+    uint64_t rng;
+    int next_input_tick;
+    int held_input;     // Released on the client's next turn; -1 when nothing is held.
+} Loopback_Client;
+
+static bool loopback_view_matches(const Net_View *v, Net_Session *sess)
+{
+    Game_State *g = &sess->game;
+    if (v->is_game_over != g->is_game_over) return false;
+    if (memcmp(&v->piece, &g->current_piece, sizeof(Piece)) != 0) return false;
+    for (int row = 0; row < g->tetris_rows; row++)
+    {
+        if (v->row_masks[row] != g->row_masks[row]) return false;
+        for (int col = 0; col < g->tetris_cols; col++)
+        {
+            if (!(g->row_masks[row] & (1u << col))) continue;
+            if (v->kinds[row][col] != (g->blocks[row * g->tetris_cols + col].piece_kind & 0xF)) return false;
+        }
+    }
+    return true;
+}
+
+// Random key presses, held for a few ticks; restarts when topped out.
+static void loopback_client_act(Net_Server *srv, int session, Loopback_Client *c, int tick)
+{
+    uint8_t frame[16];
+    int len = 0;
+
+    if (c->view.is_game_over)
+    {
+        len = net_write_restart(frame);
+        net_server_receive(srv, session, frame, len);
+        return;
+    }
+    if (tick < c->next_input_tick) return;
+
+    if (c->held_input >= 0)
+    {
+        len = net_write_input(frame, (Sim_Input)c->held_input, false);
+        c->held_input = -1;
+    }
+    else
+    {
+        static const Sim_Input inputs[] = {
+            SIM_INPUT_LEFT, SIM_INPUT_RIGHT, SIM_INPUT_ROTATE_CW, SIM_INPUT_ROTATE_CCW,
+            SIM_INPUT_ROTATE_180, SIM_INPUT_SOFT_DROP, SIM_INPUT_HARD_DROP,
+        };
+        c->held_input = inputs[rng_next(&c->rng) % (sizeof(inputs) / sizeof(inputs[0]))];
+        len = net_write_input(frame, (Sim_Input)c->held_input, true);
+    }
+    net_server_receive(srv, session, frame, len);
+    c->next_input_tick = tick + 1 + (int)(rng_next(&c->rng) % 60);
+}
+
+static int server_run_loopback(int session_count, int seconds, uint64_t seed)
+{
+    Net_Server srv;
+    if (!net_server_init(&srv, session_count, seed)) return 1;
+
+    Loopback_Client *clients = calloc((size_t)session_count, sizeof(clients[0]));
+    int *sessions = malloc(sizeof(sessions[0]) * (size_t)session_count);
+    for (int i = 0; i < session_count; i++)
+    {
+        sessions[i] = net_server_open_session(&srv, -1);
+        clients[i].rng = seed + (uint64_t)i;
+        clients[i].held_input = -1;
+
+        uint8_t frame[16];
+        int len = net_write_hello(frame, rng_next(&clients[i].rng));
+        net_server_receive(&srv, sessions[i], frame, len);
+    }
+
+    // Joins and restarts from here on reuse what the sessions already hold.
+    long alloc_mark = mem_alloc_count();
+
+    long mismatches = 0, dropped = 0, frames_bad = 0;
+    int ticks = seconds * SIM_TICK_HZ;
+    double start = server_now();
+    for (int tick = 0; tick < ticks; tick++)
+    {
+        for (int i = 0; i < session_count; i++) loopback_client_act(&srv, sessions[i], &clients[i], tick);
+
+        net_server_tick(&srv);
+
+        for (int i = 0; i < session_count; i++)
+        {
+            Net_Session *sess = &srv.sessions[sessions[i]];
+            if (sess->dropped) { dropped++; continue; }
+            int used = net_view_receive(&clients[i].view, sess->out, sess->out_len);
+            if (used < 0) { frames_bad++; used = sess->out_len; }
+            net_session_consume_output(sess, used);
+        }
+
+        // Checking every board every tick would dominate the run.
+        if (tick % SIM_TICK_HZ == SIM_TICK_HZ - 1 || tick == ticks - 1)
+        {
+            for (int i = 0; i < session_count; i++)
+            {
+                if (!loopback_view_matches(&clients[i].view, &srv.sessions[sessions[i]])) mismatches++;
+            }
+        }
+    }
+    double elapsed = server_now() - start;
+    MEM_ASSERT_NO_ALLOCS_SINCE(alloc_mark);
+
+    size_t board_bytes = game_arena_size(TETRIS_COLS, TETRIS_ROWS);
+    printf("%d sessions, %d ticks (%ds of game time) in %.2fs: %.0f session-ticks/s, %.1fx real time\n",
+        session_count, ticks, seconds, elapsed, (double)session_count * ticks / elapsed, (double)seconds / elapsed);
+    printf("%.1f bytes/s in, %.1f bytes/s out per session; %zu bytes per session (%zu session + %zu board)\n",
+        (double)srv.bytes_in / session_count / seconds, (double)srv.bytes_out / session_count / seconds,
+        sizeof(Net_Session) + board_bytes, sizeof(Net_Session), board_bytes);
+    printf("%ld view mismatches, %ld bad frames, %ld dropped\n", mismatches, frames_bad, dropped);
+
+    free(sessions);
+    free(clients);
+    net_server_free(&srv);
+    return (mismatches || frames_bad || dropped) ? 1 : 0;
+}
+
+// --------------------------------------------------------------------
+
+#ifdef __linux__
+
+#define SERVER_EVENT_LISTEN 0
+#define SERVER_EVENT_TIMER 1
+#define SERVER_EVENT_SESSION 2
+#define SERVER_MAX_EVENTS 256
+
+static volatile sig_atomic_t server_running = 1;
+
+static void server_on_signal(int sig)
+{
+    server_running = 0;
+}
+
+typedef struct {
+    Net_Server srv;
+    int epoll_fd;
+    bool *want_write;
+} Server_Loop;
+
+static void server_close(Server_Loop *l, int i)
+{
+    Net_Session *sess = &l->srv.sessions[i];
+    if (!sess->open) return;
+    epoll_ctl(l->epoll_fd, EPOLL_CTL_DEL, sess->fd, NULL);
+    close(sess->fd);
+    l->want_write[i] = false;
+    net_server_close_session(&l->srv, i);
+}
+
+static void server_watch(Server_Loop *l, int i, bool want_write)
+{
+    if (l->want_write[i] == want_write) return;
+    struct epoll_event ev = {.events = EPOLLIN | (want_write ? EPOLLOUT : 0), .data.u64 = SERVER_EVENT_SESSION + (uint64_t)i};
+    epoll_ctl(l->epoll_fd, EPOLL_CTL_MOD, l->srv.sessions[i].fd, &ev);
+    l->want_write[i] = want_write;
+}
+
+// Writes as much pending output as the socket takes; waits for EPOLLOUT for the rest.
+static void server_flush(Server_Loop *l, int i)
+{
+    Net_Session *sess = &l->srv.sessions[i];
+    while (sess->out_len > 0)
+    {
+        ssize_t n = send(sess->fd, sess->out, (size_t)sess->out_len, MSG_NOSIGNAL);
+        if (n > 0) { net_session_consume_output(sess, (int)n); continue; }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        server_close(l, i);
+        return;
+    }
+    server_watch(l, i, sess->out_len > 0);
+}
+
+static void server_accept(Server_Loop *l, int listen_fd)
+{
+    for (;;)
+    {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        int i = net_server_open_session(&l->srv, fd);
+        if (i < 0)
+        {
+            close(fd);
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct epoll_event ev = {.events = EPOLLIN, .data.u64 = SERVER_EVENT_SESSION + (uint64_t)i};
+        epoll_ctl(l->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+static void server_read(Server_Loop *l, int i)
+{
+    uint8_t buf[1024];
+    for (;;)
+    {
+        ssize_t n = recv(l->srv.sessions[i].fd, buf, sizeof(buf), 0);
+        if (n > 0)
+        {
+            if (!net_server_receive(&l->srv, i, buf, (int)n)) { server_close(l, i); return; }
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        server_close(l, i);
+        return;
+    }
+}
+
+static int server_run_network(int port, int max_sessions, uint64_t seed)
+{
+    Server_Loop l = {0};
+    if (!net_server_init(&l.srv, max_sessions, seed)) return 1;
+    l.want_write = calloc((size_t)max_sessions, sizeof(l.want_write[0]));
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons((uint16_t)port), .sin_addr.s_addr = htonl(INADDR_ANY)};
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 128) < 0)
+    {
+        fprintf(stderr, "Server: couldn't listen on port %d: %s\n", port, strerror(errno));
+        return 1;
+    }
+
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct itimerspec period = {
+        .it_interval = {.tv_nsec = 1000000000L / SIM_TICK_HZ},
+        .it_value = {.tv_nsec = 1000000000L / SIM_TICK_HZ},
+    };
+    timerfd_settime(timer_fd, 0, &period, NULL);
+
+    l.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event listen_ev = {.events = EPOLLIN, .data.u64 = SERVER_EVENT_LISTEN};
+    struct epoll_event timer_ev = {.events = EPOLLIN, .data.u64 = SERVER_EVENT_TIMER};
+    epoll_ctl(l.epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_ev);
+    epoll_ctl(l.epoll_fd, EPOLL_CTL_ADD, timer_fd, &timer_ev);
+
+    signal(SIGINT, server_on_signal);
+    signal(SIGTERM, server_on_signal);
+    printf("Server: listening on port %d, up to %d sessions\n", port, max_sessions);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    while (server_running)
+    {
+        int n = epoll_wait(l.epoll_fd, events, SERVER_MAX_EVENTS, -1);
+        if (n < 0 && errno != EINTR) break;
+
+        for (int e = 0; e < n; e++)
+        {
+            uint64_t id = events[e].data.u64;
+            if (id == SERVER_EVENT_LISTEN)
+            {
+                server_accept(&l, listen_fd);
+            }
+            else if (id == SERVER_EVENT_TIMER)
+            {
+                uint64_t expirations = 0;
+                if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) continue;
+                // Same catch-up limit as the front end: a long stall is dropped.
+                if (expirations > SIM_MAX_TICKS_PER_ADVANCE) expirations = SIM_MAX_TICKS_PER_ADVANCE;
+                for (uint64_t t = 0; t < expirations; t++) net_server_tick(&l.srv);
+
+                for (int i = 0; i < l.srv.session_cap; i++)
+                {
+                    Net_Session *sess = &l.srv.sessions[i];
+                    if (!sess->open) continue;
+                    if (sess->dropped) server_close(&l, i);
+                    else if (sess->out_len > 0 && !l.want_write[i]) server_flush(&l, i);
+                }
+            }
+            else
+            {
+                int i = (int)(id - SERVER_EVENT_SESSION);
+                if (!l.srv.sessions[i].open) continue;
+                if (events[e].events & (EPOLLHUP | EPOLLERR)) { server_close(&l, i); continue; }
+                if (events[e].events & EPOLLIN) server_read(&l, i);
+                if (l.srv.sessions[i].open && (events[e].events & EPOLLOUT)) server_flush(&l, i);
+            }
+        }
+    }
+
+    printf("Server: shutting down, %d sessions open\n", l.srv.session_count);
+    for (int i = 0; i < l.srv.session_cap; i++) server_close(&l, i);
+    close(timer_fd);
+    close(listen_fd);
+    close(l.epoll_fd);
+    free(l.want_write);
+    net_server_free(&l.srv);
+    return 0;
+}
+
+#endif
+
+// --------------------------------------------------------------------
+
+static void server_usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [--port N] [--max-sessions N] [--seed N]\n"
+        "       %s --loopback [--sessions N] [--seconds N] [--seed N]\n", argv0, argv0);
+}
+
+int main(int argc, char **argv)
+{
+    bool loopback = false;
+    int port = 7777;
+    int max_sessions = 4096;
+    int sessions = 1000;
+    int seconds = 60;
+    uint64_t seed = 0;
+    bool seed_set = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "--loopback")) { loopback = true; continue; }
+
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!val) { server_usage(argv[0]); return 1; }
+
+        if      (!strcmp(arg, "--port"))         port = atoi(val);
+        else if (!strcmp(arg, "--max-sessions")) max_sessions = atoi(val);
+        else if (!strcmp(arg, "--sessions"))     sessions = atoi(val);
+        else if (!strcmp(arg, "--seconds"))      seconds = atoi(val);
+        else if (!strcmp(arg, "--seed"))         { seed = strtoull(val, NULL, 10); seed_set = true; }
+        else { server_usage(argv[0]); return 1; }
+        i++;
+    }
+
+    // Loopback runs are reproducible by default; live servers deal fresh games.
+    if (!seed_set) seed = loopback ? 1 : (uint64_t)time(NULL);
+
+    if (loopback)
+    {
+        if (sessions < 1 || seconds < 1) { server_usage(argv[0]); return 1; }
+        return server_run_loopback(sessions, seconds, seed);
+    }
+
+#ifdef __linux__
+    if (max_sessions < 1) { server_usage(argv[0]); return 1; }
+    return server_run_network(port, max_sessions, seed);
+#else
+    fprintf(stderr, "Server: network mode needs epoll (Linux); --loopback works here\n");
+    return 1;
+#endif
+}
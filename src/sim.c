@@ -0,0 +1,207 @@
+#include <stdio.h>
+
+#include "tetris.h"
+#include "sim.h"
+#include "trace.h"
+
+static bool sim_piece_is_grounded(Game_State *s)
+{
+    const Piece *p = &s->current_piece;
+    return !check_piece_collision_fast(s, p, p->x, p->y + 1, p->orient);
+}
+
+static void sim_start_lock_delay(Game_State *s)
+{
+    Sim_State *sim = &s->sim;
+    if (!timer_wheel_is_active(&sim->wheel, SIM_TIMER_LOCK))
+    {
+        timer_wheel_schedule(&sim->wheel, SIM_TIMER_LOCK, sim->tick + (uint64_t)sim->config.lock_delay_ticks);
+    }
+}
+
+// A successful shift or rotation restarts lock delay, a limited number of times per piece.
+static void sim_on_piece_moved(Game_State *s)
+{
+    Sim_State *sim = &s->sim;
+    if (!timer_wheel_is_active(&sim->wheel, SIM_TIMER_LOCK)) return;
+
+    if (!sim_piece_is_grounded(s))
+    {
+        // Slid off a ledge: gravity takes over again.
+        timer_wheel_cancel(&sim->wheel, SIM_TIMER_LOCK);
+    }
+    else if (sim->lock_resets < sim->config.max_lock_resets)
+    {
+        sim->lock_resets++;
+        timer_wheel_schedule(&sim->wheel, SIM_TIMER_LOCK, sim->tick + (uint64_t)sim->config.lock_delay_ticks);
+    }
+}
+
+static bool sim_shift(Game_State *s, int dir)
+{
+    if (!slide_current_piece(s, dir)) return false;
+    sim_on_piece_moved(s);
+    return true;
+}
+
+static int sim_gravity_period(const Game_State *s)
+{
+    const Sim_State *sim = &s->sim;
+    return sim->held[SIM_INPUT_SOFT_DROP] ? sim->config.soft_drop_ticks : sim_gravity_ticks(&sim->config, s->stats.level);
+}
+
+static void sim_lock(Game_State *s)
+{
+    Sim_State *sim = &s->sim;
+    lock_current_piece(s);
+    timer_wheel_cancel(&sim->wheel, SIM_TIMER_LOCK);
+    sim->lock_resets = 0;
+    timer_wheel_schedule(&sim->wheel, SIM_TIMER_GRAVITY, sim->tick + (uint64_t)sim_gravity_period(s));
+}
+
+static void sim_apply_input(Game_State *s, const Sim_Input_Event *e)
+{
+    Sim_State *sim = &s->sim;
+    sim->held[e->input] = e->down;
+    if (e->down && e->input != SIM_INPUT_SOFT_DROP && e->input != SIM_INPUT_HARD_DROP) s->stats.piece_inputs++;
+
+    switch (e->input)
+    {
+        case SIM_INPUT_LEFT:
+        case SIM_INPUT_RIGHT:
+        {
+            int dir = (e->input == SIM_INPUT_RIGHT) ? +1 : -1;
+            if (e->down)
+            {
+                sim->shift_dir = dir;
+                sim_shift(s, dir);
+                timer_wheel_cancel(&sim->wheel, SIM_TIMER_ARR);
+                timer_wheel_schedule(&sim->wheel, SIM_TIMER_DAS, sim->tick + (uint64_t)sim->config.das_ticks);
+            }
+            else if (sim->shift_dir == dir)
+            {
+                // Falling back to the other direction, if it's still held, charges DAS afresh.
+                int other = (e->input == SIM_INPUT_RIGHT) ? SIM_INPUT_LEFT : SIM_INPUT_RIGHT;
+                timer_wheel_cancel(&sim->wheel, SIM_TIMER_ARR);
+                if (sim->held[other])
+                {
+                    sim->shift_dir = -dir;
+                    timer_wheel_schedule(&sim->wheel, SIM_TIMER_DAS, sim->tick + (uint64_t)sim->config.das_ticks);
+                }
+                else
+                {
+                    sim->shift_dir = 0;
+                    timer_wheel_cancel(&sim->wheel, SIM_TIMER_DAS);
+                }
+            }
+        } break;
+        case SIM_INPUT_SOFT_DROP:
+        {
+            // Pressing drops on this very tick; releasing waits out a full normal period.
+            uint64_t next = e->down ? sim->tick : sim->tick + (uint64_t)sim_gravity_ticks(&sim->config, s->stats.level);
+            timer_wheel_schedule(&sim->wheel, SIM_TIMER_GRAVITY, next);
+        } break;
+        case SIM_INPUT_HARD_DROP:
+        {
+            if (!e->down) break;
+            int cells = 0;
+            while (move_current_piece_down(s)) cells++;
+            game_stats_add_drop(&s->stats, cells, true);
+            sim_lock(s);
+        } break;
+        case SIM_INPUT_ROTATE_CW:
+        case SIM_INPUT_ROTATE_CCW:
+        case SIM_INPUT_ROTATE_180:
+        {
+            Piece_Rotation rot = (e->input == SIM_INPUT_ROTATE_CW)  ? PIECE_ROTATE_CW :
+                                 (e->input == SIM_INPUT_ROTATE_CCW) ? PIECE_ROTATE_CCW : PIECE_ROTATE_180;
+            if (e->down && rotate_current_piece(s, rot)) sim_on_piece_moved(s);
+        } break;
+        default: break;
+    }
+}
+
+static void sim_fire_timer(Game_State *s, int timer)
+{
+    Sim_State *sim = &s->sim;
+    switch (timer)
+    {
+        case SIM_TIMER_DAS:
+        {
+            if (sim->shift_dir == 0) break;
+            if (sim->config.arr_ticks == 0)
+            {
+                while (sim_shift(s, sim->shift_dir)) {}
+            }
+            else
+            {
+                sim_shift(s, sim->shift_dir);
+                timer_wheel_schedule(&sim->wheel, SIM_TIMER_ARR, sim->tick + (uint64_t)sim->config.arr_ticks);
+            }
+        } break;
+        case SIM_TIMER_ARR:
+        {
+            if (sim->shift_dir == 0) break;
+            sim_shift(s, sim->shift_dir);
+            timer_wheel_schedule(&sim->wheel, SIM_TIMER_ARR, sim->tick + (uint64_t)sim->config.arr_ticks);
+        } break;
+        case SIM_TIMER_GRAVITY:
+        {
+            trace_begin("gravity");
+            if (move_current_piece_down(s) && sim->held[SIM_INPUT_SOFT_DROP]) game_stats_add_drop(&s->stats, 1, false);
+            if (sim_piece_is_grounded(s)) sim_start_lock_delay(s);
+            timer_wheel_schedule(&sim->wheel, SIM_TIMER_GRAVITY, sim->tick + (uint64_t)sim_gravity_period(s));
+            trace_end("gravity");
+        } break;
+        case SIM_TIMER_LOCK:
+        {
+            // Moved off the ground since the timer started: nothing to lock yet.
+            if (sim_piece_is_grounded(s)) sim_lock(s);
+        } break;
+        default: break;
+    }
+}
+
+// --------------------------------------------------------------------
+
+// One fixed tick: pending inputs first, then whatever timers are due, in id order.
+void sim_step(Game_State *s)
+{
+    Sim_State *sim = &s->sim;
+    if (s->is_game_over) return;
+
+    while (sim->queue_count > 0 && sim->queue[sim->queue_head].tick <= sim->tick && !s->is_game_over)
+    {
+        sim_apply_input(s, &sim->queue[sim->queue_head]);
+        sim->queue_head = (sim->queue_head + 1) % SIM_INPUT_QUEUE;
+        sim->queue_count--;
+    }
+
+    unsigned int fired = timer_wheel_expire(&sim->wheel, sim->tick);
+    for (int timer = 0; timer < SIM_TIMER_COUNT && !s->is_game_over; timer++)
+    {
+        if (fired & (1u << timer)) sim_fire_timer(s, timer);
+    }
+
+    sim->tick++;
+}
+
+// Runs as many ticks as `dt` seconds cover. A long stall is dropped rather than caught up.
+void sim_advance(Game_State *s, float dt)
+{
+    Sim_State *sim = &s->sim;
+    const float tick_dt = 1.0f / SIM_TICK_HZ;
+
+    sim->time_accum += dt;
+    int steps = 0;
+    while (sim->time_accum >= tick_dt)
+    {
+        if (steps++ == SIM_MAX_TICKS_PER_ADVANCE)
+        {
+            sim->time_accum = 0.0f;
+            break;
+        }
+        sim_step(s);
+        sim->time_accum -= tick_dt;
+    }
+}
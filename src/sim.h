@@ -0,0 +1,237 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+
+/*
+ * Fixed-step simulation clock. Everything time-based (gravity, lock delay,
+ * delayed auto shift, auto repeat) is counted in ticks and driven by a
+ * timer wheel, so a game is fully determined by its seed and the
+ * (tick, input) sequence, however fast it's stepped.
+ */
+
+#define SIM_TICK_HZ 240
+#define SIM_TICKS(seconds) ((int)((seconds) * SIM_TICK_HZ + 0.5f))
+#define SIM_MAX_TICKS_PER_ADVANCE SIM_TICKS(0.25f)
+
+#define TIMER_WHEEL_SLOTS 256
+#define TIMER_WHEEL_MAX_TIMERS 8
+#define TIMER_NONE -1
+
+typedef struct {
+    uint64_t expires;
+    int8_t next, prev;
+    bool active;
+} Timer_Node;
+
+// Single-level wheel; timers further out than one turn just sit through extra laps.
+typedef struct {
+    int8_t slot_head[TIMER_WHEEL_SLOTS];
+    Timer_Node timers[TIMER_WHEEL_MAX_TIMERS];
+} Timer_Wheel;
+
+// Lower ids fire first when several expire on the same tick: input before gravity before lock.
+typedef enum {
+    SIM_TIMER_DAS,
+    SIM_TIMER_ARR,
+    SIM_TIMER_GRAVITY,
+    SIM_TIMER_LOCK,
+    SIM_TIMER_COUNT
+} Sim_Timer;
+
+typedef enum {
+    SIM_INPUT_LEFT,
+    SIM_INPUT_RIGHT,
+    SIM_INPUT_SOFT_DROP,
+    SIM_INPUT_HARD_DROP,
+    SIM_INPUT_ROTATE_CW,
+    SIM_INPUT_ROTATE_CCW,
+    SIM_INPUT_ROTATE_180,
+    SIM_INPUT_COUNT
+} Sim_Input;
+
+typedef struct {
+    uint64_t tick;
+    uint8_t input;
+    bool down;
+} Sim_Input_Event;
+
+typedef struct {
+    int gravity_ticks;      // 0: follow sim_level_gravity_ticks.
+    int soft_drop_ticks;
+    int das_ticks;
+    int arr_ticks;          // 0: shift straight to the wall once DAS charges.
+    int lock_delay_ticks;
+    int max_lock_resets;
+} Sim_Config;
+
+#define SIM_INPUT_QUEUE 64
+
+typedef struct {
+    Sim_Config config;
+
+    uint64_t tick;
+    float time_accum;
+    Timer_Wheel wheel;
+
+    Sim_Input_Event queue[SIM_INPUT_QUEUE];
+    int queue_head, queue_count;
+
+    bool held[SIM_INPUT_COUNT];
+    int shift_dir;
+    int lock_resets;
+} Sim_State;
+
+static inline Sim_Config sim_config_default()
+{
+    Sim_Config c = {
+        .soft_drop_ticks = SIM_TICKS(0.01f),
+        .das_ticks = SIM_TICKS(0.167f),
+        .arr_ticks = SIM_TICKS(0.033f),
+        .lock_delay_ticks = SIM_TICKS(0.5f),
+        .max_lock_resets = 15,
+    };
+    if (c.soft_drop_ticks < 1) c.soft_drop_ticks = 1;
+    return c;
+}
+
+/*
+ * Ticks per row at each level, from the guideline curve
+ * (0.8 - (level - 1) * 0.007) ^ (level - 1) seconds. It bottoms out at a
+ * row a tick, which is already faster than a 20-row board needs.
+ */
+static const int16_t sim_level_gravity_ticks[] = {
+    240, 190, 148, 113, 85, 63, 46, 32, 23, 15,
+    10, 7, 4, 3, 2, 1,
+};
+#define SIM_LEVEL_COUNT ((int)(sizeof(sim_level_gravity_ticks) / sizeof(sim_level_gravity_ticks[0])))
+
+static inline int sim_gravity_ticks(const Sim_Config *config, int level)
+{
+    if (config->gravity_ticks > 0) return config->gravity_ticks;
+    if (level < 1) level = 1;
+    if (level > SIM_LEVEL_COUNT) level = SIM_LEVEL_COUNT;
+    return sim_level_gravity_ticks[level - 1];
+}
+
+// --------------------------------------------------------------------
+
+static inline void timer_wheel_init(Timer_Wheel *w)
+{
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) w->slot_head[i] = TIMER_NONE;
+    for (int i = 0; i < TIMER_WHEEL_MAX_TIMERS; i++) w->timers[i] = (Timer_Node){.next = TIMER_NONE, .prev = TIMER_NONE};
+}
+
+static inline void timer_wheel_cancel(Timer_Wheel *w, int id)
+{
+    Timer_Node *t = &w->timers[id];
+    if (!t->active) return;
+
+    if (t->prev != TIMER_NONE) w->timers[t->prev].next = t->next;
+    else w->slot_head[t->expires & (TIMER_WHEEL_SLOTS - 1)] = t->next;
+    if (t->next != TIMER_NONE) w->timers[t->next].prev = t->prev;
+
+    t->active = false;
+    t->next = t->prev = TIMER_NONE;
+}
+
+// (Re)arms timer `id` to fire on tick `expires`.
+static inline void timer_wheel_schedule(Timer_Wheel *w, int id, uint64_t expires)
+{
+    timer_wheel_cancel(w, id);
+
+    Timer_Node *t = &w->timers[id];
+    int slot = (int)(expires & (TIMER_WHEEL_SLOTS - 1));
+    t->expires = expires;
+    t->active = true;
+    t->prev = TIMER_NONE;
+    t->next = w->slot_head[slot];
+    if (t->next != TIMER_NONE) w->timers[t->next].prev = (int8_t)id;
+    w->slot_head[slot] = (int8_t)id;
+}
+
+static inline bool timer_wheel_is_active(const Timer_Wheel *w, int id)
+{
+    return w->timers[id].active;
+}
+
+// Pops every timer due on `now`. Returns them as a bitmask of ids, so callers handle them in id order.
+static inline unsigned int timer_wheel_expire(Timer_Wheel *w, uint64_t now)
+{
+    unsigned int fired = 0;
+    int id = w->slot_head[now & (TIMER_WHEEL_SLOTS - 1)];
+    while (id != TIMER_NONE)
+    {
+        int next = w->timers[id].next;
+        if (w->timers[id].expires == now)
+        {
+            timer_wheel_cancel(w, id);
+            fired |= 1u << id;
+        }
+        id = next;
+    }
+    return fired;
+}
+
+// --------------------------------------------------------------------
+
+// Back to tick 0 with nothing held or pending. A zeroed config is filled with the defaults.
+static inline void sim_reset(Sim_State *sim, int level)
+{
+    Sim_Config config = sim->config.lock_delay_ticks > 0 ? sim->config : sim_config_default();
+    memset(sim, 0, sizeof(*sim));
+    sim->config = config;
+    timer_wheel_init(&sim->wheel);
+    timer_wheel_schedule(&sim->wheel, SIM_TIMER_GRAVITY, (uint64_t)sim_gravity_ticks(&config, level));
+}
+
+/*
+ * Queues an input for the tick it happens on, which may be ahead of the
+ * current one; ticks must not go backwards. The queue holds only
+ * SIM_INPUT_QUEUE events, so a replay feeds its recording in as room
+ * frees up (see difftest --replay). False when full.
+ */
+static inline bool sim_queue_input_at(Sim_State *sim, uint64_t tick, Sim_Input input, bool down)
+{
+    if (sim->queue_count == SIM_INPUT_QUEUE) return false;
+
+    int i = (sim->queue_head + sim->queue_count) % SIM_INPUT_QUEUE;
+    sim->queue[i] = (Sim_Input_Event){.tick = tick, .input = (uint8_t)input, .down = down};
+    sim->queue_count++;
+    return true;
+}
+
+static inline bool sim_queue_input(Sim_State *sim, Sim_Input input, bool down)
+{
+    return sim_queue_input_at(sim, sim->tick, input, down);
+}
+
+static inline bool sim_has_pending_input(const Sim_State *sim)
+{
+    return sim->queue_count > 0;
+}
+
+// The first tick anything is due on: queued input or the soonest timer. False if nothing is.
+static inline bool sim_next_event_tick(const Sim_State *sim, uint64_t *out_tick)
+{
+    bool any = false;
+    uint64_t next = 0;
+    if (sim->queue_count > 0)
+    {
+        next = sim->queue[sim->queue_head].tick;
+        any = true;
+    }
+    for (int id = 0; id < SIM_TIMER_COUNT; id++)
+    {
+        const Timer_Node *t = &sim->wheel.timers[id];
+        if (t->active && (!any || t->expires < next))
+        {
+            next = t->expires;
+            any = true;
+        }
+    }
+    if (any) *out_tick = next < sim->tick ? sim->tick : next;
+    return any;
+}
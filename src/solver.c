@@ -0,0 +1,231 @@
+/*
+ * Solves a puzzle file (format in puzzle.h): a perfect clear or a line
+ * count from a given board with a known piece sequence.
+ *
+ *   bin/solver PUZZLE [--threads N] [--repeat N] [--boards]
+ *
+ * Prints the placements, each steered from the spawn to where it locks
+ * with the engine's own moves, checking them on the way. --repeat times
+ * that many solves and reports the best, for benchmarking; --boards
+ * prints the board after every placement.
+ * Exits 0 if solved, 2 if the puzzle has no solution.
+ */
+
+#define TETRIS_HEADLESS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tetris.h"
+#include "puzzle.h"
+
+#include "tetris_core.c"
+#include "movegen.c"
+#include "puzzle.c"
+
+static double solver_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Rows from the highest filled one down; the board's top is left out when empty.
+static void solver_print_board(Game_State *s)
+{
+    int top = 0;
+    while (top < s->tetris_rows - 1 && !s->row_masks[top]) top++;
+    for (int y = top; y < s->tetris_rows; y++)
+    {
+        printf("    ");
+        for (int x = 0; x < s->tetris_cols; x++)
+        {
+            const Block *b = get_block_at(s, x, y);
+            putchar(b->piece_id > 0 ? piece_kind_letter(b->piece_kind) : '.');
+        }
+        putchar('\n');
+    }
+}
+
+// The engine's moves: slides, a soft drop and the three turns.
+#define SOLVER_MOVE_COUNT 6
+#define SOLVER_MAX_MOVES 256
+
+static bool solver_move(Game_State *s, int move)
+{
+    switch (move)
+    {
+        case 0: return slide_current_piece(s, -1);
+        case 1: return slide_current_piece(s, +1);
+        case 2: return move_current_piece_down(s);
+        case 3: return rotate_current_piece(s, PIECE_ROTATE_CW);
+        case 4: return rotate_current_piece(s, PIECE_ROTATE_180);
+        default: return rotate_current_piece(s, PIECE_ROTATE_CCW);
+    }
+}
+
+static int solver_pose_index(const Piece *p)
+{
+    return ((int)p->orient * MOVEGEN_MAX_ROWS + p->y) * 16 + p->x;
+}
+
+/*
+ * The fewest engine moves that take the piece in play to `target`,
+ * breadth first. Returns how many, or -1 if it can't get there. Leaves
+ * the piece where it was.
+ */
+static int solver_find_moves(Game_State *s, const Piece *target, uint8_t moves[SOLVER_MAX_MOVES])
+{
+    enum { POSES = PIECE_ORIENT_COUNT * MOVEGEN_MAX_ROWS * 16 };
+    static Piece queue[POSES];
+    static int parent[POSES];
+    static uint8_t via[POSES];
+    static bool seen[POSES];
+    memset(seen, 0, sizeof(seen));
+
+    const Piece spawn = s->current_piece;
+    int head = 0, tail = 0, found = -1;
+    queue[tail++] = spawn;
+    seen[solver_pose_index(&spawn)] = true;
+    parent[solver_pose_index(&spawn)] = -1;
+    while (head < tail && found < 0)
+    {
+        const Piece at = queue[head++];
+        if (at.orient == target->orient && at.x == target->x && at.y == target->y)
+        {
+            found = solver_pose_index(&at);
+            break;
+        }
+        for (int move = 0; move < SOLVER_MOVE_COUNT; move++)
+        {
+            s->current_piece = at;
+            if (!solver_move(s, move)) continue;
+            int to = solver_pose_index(&s->current_piece);
+            if (seen[to]) continue;
+            seen[to] = true;
+            parent[to] = solver_pose_index(&at);
+            via[to] = (uint8_t)move;
+            queue[tail++] = s->current_piece;
+        }
+    }
+    s->current_piece = spawn;
+    if (found < 0) return -1;
+
+    int count = 0;
+    for (int i = found; parent[i] >= 0; i = parent[i]) count++;
+    if (count > SOLVER_MAX_MOVES) return -1;
+    int n = count;
+    for (int i = found; parent[i] >= 0; i = parent[i]) moves[--n] = via[i];
+    return count;
+}
+
+/*
+ * Plays the solution: each piece is moved from the spawn to its placement
+ * with the engine's moves, must rest there, and is locked. Checks that it
+ * all ends where the solver said.
+ */
+static bool solver_replay(Game_State *s, const Puzzle *p, const Puzzle_Solution *solution, bool boards)
+{
+    static const char *orient_names[PIECE_ORIENT_COUNT] = {"up", "right", "down", "left"};
+    int lines = 0;
+    for (int i = 0; i < solution->move_count; i++)
+    {
+        const Puzzle_Move *m = &solution->moves[i];
+        const Piece target = {.kind = m->kind, .orient = m->orient, .x = m->x, .y = m->y};
+        uint8_t moves[SOLVER_MAX_MOVES];
+        int move_count = s->current_piece.kind == m->kind ? solver_find_moves(s, &target, moves) : -1;
+        if (move_count < 0)
+        {
+            fprintf(stderr, "Solver: placement %d can't be reached from the spawn\n", i + 1);
+            return false;
+        }
+        for (int k = 0; k < move_count; k++) solver_move(s, moves[k]);
+        if (move_current_piece_down(s))
+        {
+            fprintf(stderr, "Solver: placement %d doesn't rest on anything\n", i + 1);
+            return false;
+        }
+
+        int cleared = lock_current_piece(s);
+        lines += cleared;
+        printf("%3d. %c %-5s x=%d y=%d  %2d moves", i + 1, piece_kind_letter(m->kind), orient_names[m->orient], m->x, m->y, move_count);
+        if (cleared) printf("  %d line%s", cleared, cleared == 1 ? "" : "s");
+        putchar('\n');
+        if (boards) solver_print_board(s);
+
+        // lock_current_piece spawned a random piece; the puzzle says what comes next.
+        if (i + 1 < p->piece_count)
+        {
+            Piece next = {.id = s->current_piece.id, .x = 3, .y = 0, .kind = p->pieces[i + 1]};
+            s->is_game_over = !set_current_piece(s, next);
+        }
+    }
+
+    bool empty = true;
+    for (int y = 0; y < s->tetris_rows; y++) empty = empty && !s->row_masks[y];
+    if (p->goal == PUZZLE_GOAL_CLEAR ? !empty : lines < p->goal_lines)
+    {
+        fprintf(stderr, "Solver: the engine ends with %d lines%s\n", lines, empty ? "" : " and blocks left");
+        return false;
+    }
+    return true;
+}
+
+static void solver_usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s PUZZLE [--threads N] [--repeat N] [--boards]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *path = NULL;
+    int threads = cpus > 0 ? (int)cpus : 1;
+    int repeat = 1;
+    bool boards = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if      (!strcmp(arg, "--boards"))        boards = true;
+        else if (!strcmp(arg, "--threads") && val) threads = atoi(argv[++i]);
+        else if (!strcmp(arg, "--repeat") && val)  repeat = atoi(argv[++i]);
+        else if (arg[0] != '-' && !path)          path = arg;
+        else { solver_usage(argv[0]); return 1; }
+    }
+    if (!path || threads < 1 || repeat < 1)
+    {
+        solver_usage(argv[0]);
+        return 1;
+    }
+
+    Game_State s = {0};
+    Puzzle p;
+    if (!puzzle_load(&s, &p, path)) return 1;
+
+    printf("%s: %d pieces, %s %d on a %dx%d board\n", path, p.piece_count,
+        p.goal == PUZZLE_GOAL_CLEAR ? "perfect clear in" : "lines", p.goal_lines, s.tetris_cols, s.tetris_rows);
+    solver_print_board(&s);
+
+    Puzzle_Solution solution;
+    double best = 0.0;
+    for (int i = 0; i < repeat; i++)
+    {
+        double start = solver_now();
+        puzzle_solve(&s, &p, threads, &solution);
+        double elapsed = solver_now() - start;
+        if (i == 0 || elapsed < best) best = elapsed;
+    }
+
+    printf("%s in %.3f ms on %d threads, %llu positions\n", solution.solved ? "solved" : "no solution",
+        best * 1e3, threads, (unsigned long long)solution.nodes);
+    bool ok = !solution.solved || solver_replay(&s, &p, &solution, boards);
+
+    free_game(&s);
+    if (!ok) return 1;
+    return solution.solved ? 0 : 2;
+}
@@ -1,14 +1,19 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "tetris.h"
 #include "common.h"
 #include "gl_glue.h"
 #include "lib.h"
 #include "pieces.h"
+#include "trace.h"
 
+// Both programs are submitted before either is waited on, so the driver can build them side by side.
 void create_shaders(Game_State *s)
 {
+    trace_begin("create_shaders");
     if (s->prog) glDeleteProgram(s->prog);
+    if (s->sprite_prog) glDeleteProgram(s->sprite_prog);
 
     const char *vs_src =
         "#version 330 core\n"
@@ -29,13 +34,100 @@ void create_shaders(Game_State *s)
         "  FragColor = vec4(Color, 1.0);\n"
         "}\n";
 
-    s->prog = gl_create_shader_program(vs_src, fs_src);
+    const char *sprite_vs_src =
+        "#version 330 core\n"
+        "layout(location = 0) in vec2 aPos;\n"
+        "layout(location = 1) in vec2 aUV;\n"
+        "layout(location = 2) in vec3 aColor;\n"
+        "out vec2 UV;\n"
+        "out vec3 Color;\n"
+        "uniform mat4 u_mvp;\n"
+        "void main() {"
+        "  gl_Position = u_mvp * vec4(aPos, 0.0, 1.0);\n"
+        "  UV = aUV;\n"
+        "  Color = aColor;\n"
+        "}\n";
+
+    const char *sprite_fs_src =
+        "#version 330 core\n"
+        "in vec2 UV;\n"
+        "in vec3 Color;\n"
+        "out vec4 FragColor;\n"
+        "uniform sampler2D u_atlas;\n"
+        "void main() {\n"
+        "  FragColor = vec4(Color, 1.0) * texture(u_atlas, UV);\n"
+        "}\n";
+
+    Gl_Program_Build block_build, sprite_build;
+    gl_program_submit(&block_build, vs_src, fs_src);
+    gl_program_submit(&sprite_build, sprite_vs_src, sprite_fs_src);
+    s->prog = gl_program_finish(&block_build);
+    s->sprite_prog = gl_program_finish(&sprite_build);
+    trace_end("create_shaders");
 }
 
 void create_vert_buffer(Game_State *s)
 {
     if (s->vb) vert_buffer_free(s->vb);
-    s->vb = vert_buffer_make();
+    s->vb = vert_buffer_make(VERT_MAX, INDEX_MAX);
+
+    if (s->particle_vb) vert_buffer_free(s->particle_vb);
+    s->particle_vb = vert_buffer_make(4 * PARTICLE_DRAW_MAX, 6 * PARTICLE_DRAW_MAX);
+
+    if (s->sb) sprite_buffer_free(s->sb);
+    s->sb = sprite_buffer_make();
+}
+
+// Starts empty: effects in flight aren't worth carrying over a reload.
+void create_particles(Game_State *s)
+{
+    particle_pool_free(s->particles);
+    s->particles = particle_pool_make();
+}
+
+/*
+ * Effects for the locks since the last call, from the core's lock reports:
+ * a puff from each cell of the piece, then a burst from every block of each
+ * line it cleared. Locks that have already left the ring get none.
+ */
+void emit_lock_particles(Game_State *s)
+{
+    if (s->lock_count - s->locks_emitted > LOCK_REPORT_RING) s->locks_emitted = s->lock_count - LOCK_REPORT_RING;
+    for (; s->locks_emitted != s->lock_count; s->locks_emitted++)
+    {
+        if (!s->particles) continue;
+        const Lock_Report *r = &s->locks[s->locks_emitted % LOCK_REPORT_RING];
+
+        const Piece *piece = &r->piece;
+        const Piece_Spec *spec = piece_spec_get_by_kind(piece->kind);
+        Col_3f color = piece_colors_get_by_kind(piece->kind)->normal.border;
+        for (int col = 0; col < PIECE_MAX_COLS; col++)
+        {
+            for (int row = 0; row < PIECE_MAX_ROWS; row++)
+            {
+                if (piece_spec_get_block_state_at(spec, piece->orient, col, row))
+                {
+                    particles_emit_cell(s->particles, piece->x + col, piece->y + row, color,
+                        PARTICLE_LOCK_COUNT, PARTICLE_LOCK_SPEED, PARTICLE_LOCK_LIFETIME);
+                }
+            }
+        }
+
+        for (int i = 0; i < r->cleared; i++)
+        {
+            for (int col = 0; col < s->tetris_cols; col++)
+            {
+                particles_emit_cell(s->particles, col, r->rows[i], piece_colors_get_by_kind((Piece_Kind)r->kinds[i][col])->normal.inner,
+                    PARTICLE_CLEAR_COUNT, PARTICLE_CLEAR_SPEED, PARTICLE_CLEAR_LIFETIME);
+            }
+        }
+    }
+}
+
+void load_block_atlas(Game_State *s)
+{
+    if (s->block_atlas.texture_id) gl_delete_texture(&s->block_atlas);
+    s->block_atlas = gl_load_texture(BLOCK_ATLAS_PATH, GL_LINEAR);
 }
 
 // --------------------------------------------------------------------
@@ -53,6 +145,10 @@ static const float content_y = outer_rect_padding + content_padding;
 
 static const float block_padding = 2.0f;
 
+// Atlas tiles are laid out left to right, each one is greyscale and tinted by the piece color.
+static const int block_atlas_tile_count = 2;
+static const int block_atlas_tile = 1;
+
 void draw_canvas_bg(Game_State *s)
 {
     const Rect inner_rect = {
@@ -74,13 +170,27 @@ void draw_canvas_bg(Game_State *s)
     vb_add_rect(s->vb, inner_rect, inner_color);
 }
 
-void draw_block(Game_State *s, float x, float y, Col_3f col)
+void draw_block(Game_State *s, float x, float y, const Block_Colors *colors)
 {
+    if (s->textured_blocks && s->block_atlas.texture_id)
+    {
+        const Rect rect = {
+            .x = x, .y = y,
+            .w = tile_dim, .h = tile_dim
+        };
+        const float tile_u = 1.0f / block_atlas_tile_count;
+        const Rect uv = {
+            .x = block_atlas_tile * tile_u, .y = 0.0f,
+            .w = tile_u, .h = 1.0f
+        };
+        sb_add_sprite(s->sb, rect, uv, colors->inner);
+        return;
+    }
+
     const Rect outer_rect = {
         .x = x, .y = y,
         .w = tile_dim, .h = tile_dim
     };
-    const Col_3f outer_color = {col.r * 0.8f, col.g * 0.8f, col.b * 0.8f};
 
     const Rect inner_rect = {
         .x = x + block_padding,
@@ -88,16 +198,16 @@ void draw_block(Game_State *s, float x, float y, Col_3f col)
         .w = outer_rect.w - 2 * block_padding,
         .h = outer_rect.h - 2 * block_padding
     };
-    const Col_3f inner_color = col;
 
-    vb_add_rect(s->vb, outer_rect, outer_color);
-    vb_add_rect(s->vb, inner_rect, inner_color);
+    vb_add_rect(s->vb, outer_rect, colors->border);
+    vb_add_rect(s->vb, inner_rect, colors->inner);
 }
 
 void draw_current_piece(Game_State *s)
 {
     const Piece *piece = &s->current_piece;
     const Piece_Spec *spec = piece_spec_get_by_kind(piece->kind);
+    const Block_Colors *colors = &piece_colors_get_by_kind(piece->kind)->normal;
 
     for (int col = 0; col < PIECE_MAX_COLS; col++)
     {
@@ -109,15 +219,70 @@ void draw_current_piece(Game_State *s)
                 int block_y = piece->y + row;
                 float x = content_x + block_x * tile_dim;
                 float y = content_y + block_y * tile_dim;
-                draw_block(s, x, y, spec->color);
+                draw_block(s, x, y, colors);
             }
         }
     }
 }
 
+static const float particle_size = 6.0f;
+
+/*
+ * A square per live particle, shrinking as it fades, drawn over the board
+ * from the particles' own buffer. Past PARTICLE_DRAW_MAX the newest wait.
+ */
+void draw_particles(Game_State *s)
+{
+    const Particle_Pool *p = s->particles;
+    if (!p || p->count == 0) return;
+
+    trace_begin("draw_particles");
+    vert_buffer_clear(s->particle_vb);
+    int added;
+    Vert *v = vert_buffer_add_quads(s->particle_vb, p->count, &added);
+    for (int i = 0; i < added; i++, v += 4)
+    {
+        float size = particle_size * p->life[i];
+        float x_min = content_x + p->x[i] * tile_dim - 0.5f * size;
+        float y_min = content_y + p->y[i] * tile_dim - 0.5f * size;
+        float x_max = x_min + size;
+        float y_max = y_min + size;
+        Col_3f color = {p->r[i], p->g[i], p->b[i]};
+        v[0] = (Vert){x_min, y_min, color};
+        v[1] = (Vert){x_max, y_min, color};
+        v[2] = (Vert){x_max, y_max, color};
+        v[3] = (Vert){x_min, y_max, color};
+    }
+    vert_buffer_draw_call(s->particle_vb);
+    trace_end("draw_particles");
+}
+
+// Strip under the board: progress to the next level, with a pip per level reached.
+void draw_stats_overlay(Game_State *s)
+{
+    const float strip_y = content_h + 2 * content_padding + 2 * outer_rect_padding + 2.0f;
+    const float strip_h = 6.0f;
+    const Rect track = {.x = content_x, .y = strip_y, .w = content_w, .h = strip_h};
+    vb_add_rect(s->vb, track, (Col_3f){0.15f, 0.15f, 0.16f});
+
+    int into_level = s->stats.lines % SCORE_LINES_PER_LEVEL;
+    Rect fill = track;
+    fill.w = content_w * (float)into_level / SCORE_LINES_PER_LEVEL;
+    vb_add_rect(s->vb, fill, (Col_3f){0.4f, 0.6f, 0.3f});
+
+    const float pip = 4.0f;
+    for (int level = 1; level < s->stats.level && level * 2 * pip < content_w; level++)
+    {
+        const Rect r = {.x = content_x + (level - 1) * 2 * pip, .y = strip_y + strip_h + 2.0f, .w = pip, .h = pip};
+        vb_add_rect(s->vb, r, (Col_3f){0.75f, 0.75f, 0.1f});
+    }
+}
+
 void draw(Game_State *s)
 {
+    trace_begin("build_geometry");
     vert_buffer_clear(s->vb);
+    sprite_buffer_clear(s->sb);
 
     draw_canvas_bg(s);
     for (int row = 0; row < s->tetris_rows; row++)
@@ -127,168 +292,261 @@ void draw(Game_State *s)
             Block *b = get_block_at(s, col, row);
             if (b->piece_id > 0)
             {
-                Col_3f color = piece_spec_get_by_kind(b->piece_kind)->color;
+                const Piece_Colors *colors = piece_colors_get_by_kind(b->piece_kind);
                 float x = content_x + col * tile_dim;
                 float y = content_y + row * tile_dim;
-                if (s->is_game_over) color = (Col_3f){color.r * 0.4f, color.g * 0.4f, color.b * 0.4f};
-                draw_block(s, x, y, color);
+                draw_block(s, x, y, s->is_game_over ? &colors->game_over : &colors->normal);
             }
         }
     }
 
     if (!s->is_game_over) draw_current_piece(s);
+    draw_stats_overlay(s);
+    trace_end("build_geometry");
 
     vert_buffer_draw_call(s->vb);
-}
-
-// ---------------------------------------------------------------
-
-void commit_piece(Game_State *s, const Piece *piece)
-{
-    const Piece_Spec *spec = piece_spec_get_by_kind(piece->kind);
+    draw_particles(s);
 
-    for (int col = 0; col < PIECE_MAX_COLS; col++)
+    if (s->sb->index_count > 0)
     {
-        for (int row = 0; row < PIECE_MAX_ROWS; row++)
-        {
-            if (piece_spec_get_block_state_at(spec, piece->orient, col, row))
-            {
-                Block *b = get_block_at(s, piece->x + col, piece->y + row);
-                b->piece_kind = piece->kind;
-                b->piece_id = piece->id;
-            }
-        }
+        glUseProgram(s->sprite_prog);
+        glUniformMatrix4fv(glGetUniformLocation(s->sprite_prog, "u_mvp"), 1, GL_FALSE, s->proj.m);
+        glUniform1i(glGetUniformLocation(s->sprite_prog, "u_atlas"), 0);
+        sprite_buffer_draw_call(s->sb, &s->block_atlas);
+        glUseProgram(s->prog);
     }
 }
 
-bool check_piece_collision(Game_State *s, const Piece *piece, int new_x, int new_y, Piece_Orient new_orient)
+void render_frame(Game_State *s)
 {
-    const Piece_Spec *spec = piece_spec_get_by_kind(piece->kind);
-    for (int col = 0; col < PIECE_MAX_COLS; col++)
-    {
-        for (int row = 0; row < PIECE_MAX_ROWS; row++)
-        {
-            if (piece_spec_get_block_state_at(spec, new_orient, col, row))
-            {
-                Block *b = get_block_at(s, new_x + col, new_y + row);
-                if (!b || b->piece_id > 0) return false;
-            }
-        }
-    }
-    return true;
-}
+    glBindFramebuffer(GL_FRAMEBUFFER, s->fbo);
+    glViewport(0, 0, (GLsizei)s->w, (GLsizei)s->h);
 
-bool set_current_piece(Game_State *s, Piece p)
-{
-    if (check_piece_collision(s, &p, p.x, p.y, p.orient))
-    {
-        s->current_piece = p;
-        return true;
-    }
-    return false;
+    glClearColor(0.1f, 0.2f, 0.1f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glUseProgram(s->prog);
+    s->proj = mat4_proj_ortho(0, s->w, s->h, 0, -1, 1);
+
+    glUniformMatrix4fv(glGetUniformLocation(s->prog, "u_mvp"), 1, GL_FALSE, s->proj.m);
+
+    draw(s);
 }
 
-bool generate_new_piece(Game_State *s)
+void print_game_stats(Game_State *s)
 {
-    Piece p = {
-        .id = s->piece_id_seed++,
-        .x = 3, .y = 0,
-        .kind = (Piece_Kind)(rand() % PIECE_KIND_COUNT),
-        .orient = (Piece_Orient)(rand() % PIECE_ORIENT_COUNT)
-    };
-
-    return set_current_piece(s, p);
+    const Game_Stats *st = &s->stats;
+    printf("Game over: score %llu, level %d, %d lines in %d pieces (%.2f PPS)\n",
+        (unsigned long long)st->score, st->level, st->lines, st->pieces,
+        game_stats_pieces_per_second(st, s->sim.tick, SIM_TICK_HZ));
+    printf("  %d/%d/%d/%d singles/doubles/triples/tetrises, %d T-spins (+%d mini), %d back-to-back, best combo %d\n",
+        st->clears[0], st->clears[1], st->clears[2], st->clears[3], st->tspins, st->tspin_minis,
+        st->back_to_backs, st->max_combo > 0 ? st->max_combo : 0);
+    printf("  %d finesse faults, max height %d\n", st->finesse_faults, st->max_height);
 }
 
-bool move_current_piece_down(Game_State *s)
+void toggle_capture(Game_State *s, int px_w, int px_h)
 {
-    int new_y = s->current_piece.y + 1;
-    if (check_piece_collision(s, &s->current_piece, s->current_piece.x, new_y, s->current_piece.orient))
+    if (s->is_capturing)
     {
-        s->current_piece.y = new_y;
-        return true;
+        capture_end(&s->capture);
+        s->is_capturing = false;
+        printf("Capture: wrote %d frames to %s\n", s->capture.frames_written, CAPTURE_DIR);
     }
     else
     {
-        return false;
+        s->is_capturing = capture_begin(&s->capture, CAPTURE_FORMAT_PNG, CAPTURE_DIR, px_w, px_h);
     }
 }
 
-bool rotate_current_piece(Game_State *s)
+// --------------------------------------------------------------------
+
+/*
+ * Fields carried over when the layout changes under a hot reload.
+ * Append only: an entry's position in this list is its identity across builds,
+ * so removed fields stay behind as RETIRED placeholders that never match.
+ * LAYOUT(field, type) follows a pointer field and records the size of what it
+ * points to; when that differs between the builds, the pointer is dropped
+ * rather than handed to code that would misread it. GL objects and buffers
+ * are carried only so the create_* functions can free them before making new
+ * ones, and the simulation clock isn't, it restarts on any layout change.
+ */
+#define GAME_STATE_PRESERVED_FIELDS(X, RETIRED, LAYOUT) \
+    X(window)                           \
+    X(w)                                \
+    X(h)                                \
+    X(is_live_scene)                    \
+    X(fbo)                              \
+    X(blocks)                           \
+    X(tetris_cols)                      \
+    X(tetris_rows)                      \
+    X(piece_id_seed)                    \
+    X(rng_state)                        \
+    X(current_piece)                    \
+    RETIRED(move_timer)                 \
+    RETIRED(move_period)                \
+    X(is_game_over)                     \
+    X(textured_blocks)                  \
+    X(row_masks)                        \
+    X(arena)                            \
+    X(stats)                            \
+    X(nn)                               \
+    X(ai)                               \
+    X(prog)                             \
+    X(sprite_prog)                      \
+    X(block_atlas)                      \
+    X(vb)                               \
+    LAYOUT(vb, Vert_Buffer)             \
+    X(sb)                               \
+    LAYOUT(sb, Sprite_Buffer)           \
+    X(particles)                        \
+    LAYOUT(particles, Particle_Pool)    \
+    X(trace_stop)                       \
+    X(trace_path)                       \
+    X(trace_reloads)                    \
+    X(particle_vb)                      \
+    LAYOUT(particle_vb, Vert_Buffer)
+
+// A LAYOUT entry's offset: it describes a type, not a place in Game_State.
+#define GAME_STATE_LAYOUT_ENTRY UINT32_MAX
+
+#define GAME_STATE_FIELD_ID(name) GAME_STATE_FIELD_##name,
+#define GAME_STATE_LAYOUT_ID(name, type) GAME_STATE_LAYOUT_##name,
+enum { GAME_STATE_PRESERVED_FIELDS(GAME_STATE_FIELD_ID, GAME_STATE_FIELD_ID, GAME_STATE_LAYOUT_ID) GAME_STATE_FIELD_COUNT };
+#undef GAME_STATE_LAYOUT_ID
+#undef GAME_STATE_FIELD_ID
+
+_Static_assert(GAME_STATE_FIELD_COUNT <= GAME_STATE_MAX_FIELDS, "Raise GAME_STATE_MAX_FIELDS");
+
+void game_state_write_header(Game_State *s)
 {
-    Piece_Orient new_o = s->current_piece.orient + 1;
-    if (new_o >= PIECE_ORIENT_COUNT) new_o = PIECE_ORIENT_UP;
-    if (check_piece_collision(s, &s->current_piece, s->current_piece.x, s->current_piece.y, new_o))
-    {
-        s->current_piece.orient = new_o;
-        return true;
-    }
-    return false;
+    Game_State_Header *h = &s->header;
+    h->magic = GAME_STATE_MAGIC;
+    h->version = GAME_STATE_VERSION;
+    h->size = sizeof(Game_State);
+    h->block_size = sizeof(Block);
+    h->piece_size = sizeof(Piece);
+    h->field_count = GAME_STATE_FIELD_COUNT;
+
+#define GAME_STATE_FIELD_RECORD(name) \
+    h->fields[GAME_STATE_FIELD_##name] = (Game_State_Field){offsetof(Game_State, name), sizeof(s->name)};
+#define GAME_STATE_FIELD_RETIRED(name) \
+    h->fields[GAME_STATE_FIELD_##name] = (Game_State_Field){0, 0};
+#define GAME_STATE_LAYOUT_RECORD(name, type) \
+    h->fields[GAME_STATE_LAYOUT_##name] = (Game_State_Field){GAME_STATE_LAYOUT_ENTRY, sizeof(type)};
+    GAME_STATE_PRESERVED_FIELDS(GAME_STATE_FIELD_RECORD, GAME_STATE_FIELD_RETIRED, GAME_STATE_LAYOUT_RECORD)
+#undef GAME_STATE_LAYOUT_RECORD
+#undef GAME_STATE_FIELD_RETIRED
+#undef GAME_STATE_FIELD_RECORD
 }
 
-bool slide_current_piece(Game_State *s, int dir)
+bool game_state_is_current(const Game_State *s)
 {
-    int new_x = s->current_piece.x + dir;
-    if (check_piece_collision(s, &s->current_piece, new_x, s->current_piece.y, s->current_piece.orient))
-    {
-        s->current_piece.x = new_x;
-        return true;
-    }
-    return false;
+    return s->header.magic == GAME_STATE_MAGIC &&
+           s->header.version == GAME_STATE_VERSION &&
+           s->header.size == sizeof(Game_State);
 }
 
-int find_full_line(Game_State *s)
+/*
+ * The host allocated the state for the build that first ran it, so a layout
+ * that has grown past the old size can't be migrated in place: writing it
+ * would run off the end of the host's memory.
+ */
+bool game_state_fits(const Game_State *s)
 {
-    for (int row = s->tetris_rows - 1; row >= 0; row--)
-    {
-        bool full_line = true;
-        for (int col = 0; col < s->tetris_cols; col++)
-        {
-            Block *b = get_block_at(s, col, row);
-            if (b->piece_id == 0)
-            {
-                full_line = false;
-                break;
-            }
-        }
-        if (full_line) return row;
-    }
-    return -1;
+    return s->header.magic == GAME_STATE_MAGIC && s->header.size >= sizeof(Game_State);
 }
 
-void delete_line(Game_State *s, int line)
+// Where another build's state keeps field `id`, if it recorded it with this size.
+void *game_state_old_field(const Game_State *s, int id, size_t size)
 {
-    for (int row = line; row >= 0; row--)
+    const Game_State_Header *h = &s->header;
+    if (h->magic != GAME_STATE_MAGIC || id >= (int)h->field_count || h->field_count > GAME_STATE_MAX_FIELDS) return NULL;
+    const Game_State_Field *f = &h->fields[id];
+    if (f->size != size || f->offset == GAME_STATE_LAYOUT_ENTRY || f->offset + f->size > h->size) return NULL;
+    return (unsigned char *)s + f->offset;
+}
+
+/*
+ * Rebuilds the state in the current layout from one written by another build.
+ * The state must fit (game_state_fits). Returns false if nothing could be
+ * recovered.
+ */
+bool game_state_migrate(Game_State *s)
+{
+    const Game_State_Header old = s->header;
+    if (old.magic != GAME_STATE_MAGIC || old.size < sizeof(Game_State) || old.field_count > GAME_STATE_MAX_FIELDS) return false;
+
+    unsigned char *old_bytes = mem_alloc(old.size);
+    memcpy(old_bytes, s, old.size);
+
+    memset(s, 0, sizeof(*s));
+    game_state_write_header(s);
+
+    int carried = 0;
+    int shared = old.field_count < GAME_STATE_FIELD_COUNT ? (int)old.field_count : GAME_STATE_FIELD_COUNT;
+    for (int i = 0; i < shared; i++)
     {
-        for (int col = 0; col < s->tetris_cols; col++)
-        {
-            Block *this_b = get_block_at(s, col, row);
-            Block *prev_b = row > 0 ? get_block_at(s, col, row - 1) : &(Block){.piece_id = 0};
-            *this_b = *prev_b;
-        }
+        const Game_State_Field *from = &old.fields[i];
+        const Game_State_Field *to = &s->header.fields[i];
+        if (to->size == 0 || from->size != to->size) continue;
+        if (to->offset == GAME_STATE_LAYOUT_ENTRY || from->offset == GAME_STATE_LAYOUT_ENTRY) continue;
+        if (from->offset + from->size > old.size) continue;
+        memcpy((unsigned char *)s + to->offset, old_bytes + from->offset, to->size);
+        carried++;
+    }
+    mem_free(old_bytes);
+
+    // Pointers to things whose layout changed can't be freed by this build: leave them behind.
+#define GAME_STATE_LAYOUT_CHECK(name, type)                                                                  \
+    if (s->name && (GAME_STATE_LAYOUT_##name >= (int)old.field_count ||                                     \
+                    old.fields[GAME_STATE_LAYOUT_##name].size != sizeof(type)))                              \
+    {                                                                                                       \
+        fprintf(stderr, "Reload: " #type " changed layout, leaving the old one behind\n");                   \
+        s->name = NULL;                                                                                     \
+    }
+#define GAME_STATE_IGNORE(name)
+    GAME_STATE_PRESERVED_FIELDS(GAME_STATE_IGNORE, GAME_STATE_IGNORE, GAME_STATE_LAYOUT_CHECK)
+#undef GAME_STATE_IGNORE
+#undef GAME_STATE_LAYOUT_CHECK
+
+    // The board and piece are only usable if their own layouts are unchanged.
+    if (old.block_size != sizeof(Block) && s->blocks)
+    {
+        if (s->arena.base) free_game(s);
+        else mem_free(s->blocks);
+        s->blocks = NULL;
     }
+    if (!s->blocks && s->row_masks)
+    {
+        if (!s->arena.base) mem_free(s->row_masks);
+        s->row_masks = NULL;
+    }
+    if (old.piece_size != sizeof(Piece)) memset(&s->current_piece, 0, sizeof(s->current_piece));
+
+    printf("Reload: migrated Game_State v%u (%u bytes) to v%u (%zu bytes), %d fields kept\n",
+        old.version, old.size, GAME_STATE_VERSION, sizeof(Game_State), carried);
+    return true;
 }
 
-void check_lines(Game_State *s)
+// Moves a board from a build without arenas into a fresh one.
+void game_state_adopt_board(Game_State *s)
 {
-    int line = find_full_line(s);
-    while (line >= 0)
+    Block *old_blocks = s->blocks;
+    uint16_t *old_row_masks = s->row_masks;
+
+    size_t arena_size = game_arena_size(s->tetris_cols, s->tetris_rows);
+    if (!arena_init(&s->arena, arena_size))
     {
-        delete_line(s, line);
-        line = find_full_line(s);
+        fprintf(stderr, "Reload: couldn't allocate %zu bytes for the board\n", arena_size);
+        abort();
     }
-}
+    game_arena_layout(s);
 
-// -----------------------------------------------
+    memcpy(s->blocks, old_blocks, sizeof(Block) * (size_t)(s->tetris_cols * s->tetris_rows));
+    if (old_row_masks) memcpy(s->row_masks, old_row_masks, sizeof(uint16_t) * (size_t)s->tetris_rows);
+    else rebuild_row_masks(s);
 
-void initialize_game(Game_State *s)
-{
-    if (s->blocks) free(s->blocks);
-    s->blocks = calloc(1, s->tetris_cols * s->tetris_rows * sizeof(s->blocks[0]));
-    s->piece_id_seed = 1;
-    srand(time(NULL));
-    generate_new_piece(s);
-    s->move_period = MOVE_PERIOD;
-    s->move_timer = 0.0f;
-    s->is_game_over = false;
+    mem_free(old_blocks);
+    mem_free(old_row_masks);
 }
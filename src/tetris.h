@@ -1,35 +1,127 @@
 #pragma once
 
-#include <GLFW/glfw3.h>
+#ifndef TETRIS_HEADLESS
+#include "gl_glue.h"
+#include "capture.h"
+#include "redraw.h"
+#include "particles.h"
+
+// Only the pointer is stored, so front ends without GLFW (offscreen) can still build.
+typedef struct GLFWwindow GLFWwindow;
+#endif
 
 #include "common.h"
+#include "mem.h"
 #include "platform_types.h"
 #include "pieces.h"
+#include "sim.h"
+#include "score.h"
+#include "ai.h"
 
 #define TETRIS_COLS 10
 #define TETRIS_ROWS 20
-#define MOVE_PERIOD 0.5f
-#define MOVE_PERIOD_FAST 0.01f
+_Static_assert(TETRIS_COLS <= 16, "Row masks are 16 bits wide");
+#define BLOCK_ATLAS_PATH "assets/blocks.png"
+#define CAPTURE_DIR "captures"
 
 typedef struct {
     int piece_id;
     Piece_Kind piece_kind;
 } Block;
 
+#define GARBAGE_PIECE_ID INT32_MAX
+
+/*
+ * What a lock did, kept for the front end's effects: the piece, and each
+ * line it cleared with the kinds of the blocks that went. The core keeps
+ * the last LOCK_REPORT_RING of them and never looks at them again.
+ */
+#define LOCK_REPORT_LINES 4     // No piece spans more rows than this.
+#define LOCK_REPORT_RING 4
+
+typedef struct {
+    Piece piece;
+    int cleared;
+    int8_t rows[LOCK_REPORT_LINES];             // Where each cleared line was when it went.
+    uint8_t kinds[LOCK_REPORT_LINES][16];       // Its blocks' Piece_Kinds; row masks cap the board at 16 columns.
+} Lock_Report;
+
+/*
+ * Bump GAME_STATE_VERSION whenever Game_State, or anything it points to,
+ * changes layout. On hot reload a mismatch triggers a field-by-field
+ * migration driven by the offsets the previous build recorded here.
+ * The header itself must never change and always comes first.
+ */
+#define GAME_STATE_MAGIC 0x53525454u
+#define GAME_STATE_VERSION 13
+#define GAME_STATE_MAX_FIELDS 48
+
+typedef struct {
+    uint32_t offset;
+    uint32_t size;
+} Game_State_Field;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t block_size;
+    uint32_t piece_size;
+    uint32_t field_count;
+    Game_State_Field fields[GAME_STATE_MAX_FIELDS];
+} Game_State_Header;
+
 typedef struct {
+    Game_State_Header header;
+
+#ifndef TETRIS_HEADLESS
     GLFWwindow *window;
     float w, h;
+    bool is_live_scene;
+    GLuint fbo;
 
     GLuint prog;
     Vert_Buffer *vb;
+    Vert_Buffer *particle_vb;
+    Mat_4 proj;
+
+    GLuint sprite_prog;
+    Sprite_Buffer *sb;
+    Texture block_atlas;
+    bool textured_blocks;
+    Particle_Pool *particles;    // Line-clear and lock effects, from the core's lock reports; drawn with the blocks.
+    uint32_t locks_emitted;     // lock_count as of the last emit_lock_particles.
+
+    Frame_Capture capture;
+    bool is_capturing;
+
+    Redraw_State redraw;
 
+    // --trace. Recording lives in the statics of the build that started it, so
+    // a reload ends it through that build's trace_stop and goes on in a new file.
+    void (*trace_stop)(void);
+    char trace_path[256];
+    int trace_reloads;
+#endif
+
+    Arena arena;            // Owns blocks and row_masks; see initialize_game_with_seed.
     Block *blocks;
+    uint16_t *row_masks;    // Mirrors blocks, one bit per occupied cell (see pieces.h).
     int tetris_cols, tetris_rows;
 
     int piece_id_seed;
+    uint64_t rng_state;
 
     Piece current_piece;
-    float move_timer;
-    float move_period;
+    bool last_move_rotated;     // For T-spins: the piece's last successful move was a turn.
     bool is_game_over;
+
+    Sim_State sim;
+    Game_Stats stats;
+
+    Lock_Report locks[LOCK_REPORT_RING];
+    uint32_t lock_count;    // Locks so far; the newest is locks[(lock_count - 1) % LOCK_REPORT_RING].
+
+    Ai_Worker *ai;
+    struct Nn_Model *nn;    // Loaded with --nn; when set, the bot plays with it (see nn.h).
 } Game_State;
@@ -0,0 +1,452 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tetris.h"
+#include "common.h"
+#include "mem.h"
+#include "pieces.h"
+#include "trace.h"
+
+Block *get_block_at(Game_State *s, int x, int y)
+{
+    if (x < 0 || x >= s->tetris_cols ||
+        y < 0 || y >= s->tetris_rows)
+    {
+        return NULL;
+    }
+
+    return &s->blocks[s->tetris_cols * y + x];
+}
+
+// ---------------------------------------------------------------
+
+void commit_piece(Game_State *s, const Piece *piece)
+{
+    trace_begin("commit_piece");
+    const Piece_Spec *spec = piece_spec_get_by_kind(piece->kind);
+
+    for (int col = 0; col < PIECE_MAX_COLS; col++)
+    {
+        for (int row = 0; row < PIECE_MAX_ROWS; row++)
+        {
+            if (piece_spec_get_block_state_at(spec, piece->orient, col, row))
+            {
+                Block *b = get_block_at(s, piece->x + col, piece->y + row);
+                b->piece_kind = piece->kind;
+                b->piece_id = piece->id;
+                s->row_masks[piece->y + row] |= (uint16_t)(1u << (piece->x + col));
+            }
+        }
+    }
+    trace_end("commit_piece");
+}
+
+// Reference test against the Block array. The engine uses the row-mask version below.
+bool check_piece_collision(Game_State *s, const Piece *piece, int new_x, int new_y, Piece_Orient new_orient)
+{
+    const Piece_Spec *spec = piece_spec_get_by_kind(piece->kind);
+    for (int col = 0; col < PIECE_MAX_COLS; col++)
+    {
+        for (int row = 0; row < PIECE_MAX_ROWS; row++)
+        {
+            if (piece_spec_get_block_state_at(spec, new_orient, col, row))
+            {
+                Block *b = get_block_at(s, new_x + col, new_y + row);
+                if (!b || b->piece_id > 0) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Same contract as check_piece_collision, on s->row_masks.
+bool check_piece_collision_fast(Game_State *s, const Piece *piece, int new_x, int new_y, Piece_Orient new_orient)
+{
+    return piece_fits(s->row_masks, s->tetris_cols, s->tetris_rows, piece->kind, new_orient, new_x, new_y);
+}
+
+// Recomputes s->row_masks from the Block array.
+void rebuild_row_masks(Game_State *s)
+{
+    for (int row = 0; row < s->tetris_rows; row++)
+    {
+        uint16_t mask = 0;
+        for (int col = 0; col < s->tetris_cols; col++)
+        {
+            if (get_block_at(s, col, row)->piece_id > 0) mask |= (uint16_t)(1u << col);
+        }
+        s->row_masks[row] = mask;
+    }
+}
+
+bool set_current_piece(Game_State *s, Piece p)
+{
+    if (check_piece_collision_fast(s, &p, p.x, p.y, p.orient))
+    {
+        s->current_piece = p;
+        s->last_move_rotated = false;
+        return true;
+    }
+    return false;
+}
+
+bool generate_new_piece(Game_State *s)
+{
+    trace_instant("generate_new_piece", NULL, 0);
+    Piece p = {
+        .id = s->piece_id_seed++,
+        .x = 3, .y = 0,
+        .kind = (Piece_Kind)(rng_next(&s->rng_state) % PIECE_KIND_COUNT),
+        .orient = (Piece_Orient)(rng_next(&s->rng_state) % PIECE_ORIENT_COUNT)
+    };
+
+    if (!set_current_piece(s, p)) return false;
+    s->stats.piece_inputs = 0;
+    s->stats.spawn_x = p.x;
+    s->stats.spawn_orient = p.orient;
+    return true;
+}
+
+bool move_current_piece_down(Game_State *s)
+{
+    int new_y = s->current_piece.y + 1;
+    if (check_piece_collision_fast(s, &s->current_piece, s->current_piece.x, new_y, s->current_piece.orient))
+    {
+        s->current_piece.y = new_y;
+        s->last_move_rotated = false;
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// Turns the piece, trying the SRS kicks for its kind until one fits.
+bool rotate_current_piece(Game_State *s, Piece_Rotation rot)
+{
+    if (!piece_try_rotate(s->row_masks, s->tetris_cols, s->tetris_rows, &s->current_piece, rot, &s->current_piece)) return false;
+    s->last_move_rotated = true;
+    return true;
+}
+
+bool slide_current_piece(Game_State *s, int dir)
+{
+    int new_x = s->current_piece.x + dir;
+    if (check_piece_collision_fast(s, &s->current_piece, new_x, s->current_piece.y, s->current_piece.orient))
+    {
+        s->current_piece.x = new_x;
+        s->last_move_rotated = false;
+        return true;
+    }
+    return false;
+}
+
+int find_full_line(Game_State *s)
+{
+    for (int row = s->tetris_rows - 1; row >= 0; row--)
+    {
+        bool full_line = true;
+        for (int col = 0; col < s->tetris_cols; col++)
+        {
+            Block *b = get_block_at(s, col, row);
+            if (b->piece_id == 0)
+            {
+                full_line = false;
+                break;
+            }
+        }
+        if (full_line) return row;
+    }
+    return -1;
+}
+
+void delete_line(Game_State *s, int line)
+{
+    for (int row = line; row >= 0; row--)
+    {
+        for (int col = 0; col < s->tetris_cols; col++)
+        {
+            Block *this_b = get_block_at(s, col, row);
+            Block *prev_b = row > 0 ? get_block_at(s, col, row - 1) : &(Block){.piece_id = 0};
+            *this_b = *prev_b;
+        }
+    }
+
+    memmove(&s->row_masks[1], &s->row_masks[0], sizeof(s->row_masks[0]) * line);
+    s->row_masks[0] = 0;
+}
+
+/*
+ * Pushes the whole board up by `count` rows in a single move and fills the
+ * bottom with garbage open at `hole_col`. Returns false if that pushed
+ * blocks out of the top or into the current piece.
+ */
+bool insert_garbage_rows(Game_State *s, int count, int hole_col)
+{
+    int cols = s->tetris_cols;
+    int rows = s->tetris_rows;
+    if (count <= 0) return true;
+    if (count > rows) count = rows;
+
+    bool spilled = false;
+    for (int row = 0; row < count; row++)
+    {
+        if (s->row_masks[row]) spilled = true;
+    }
+
+    memmove(&s->blocks[0], &s->blocks[count * cols], sizeof(s->blocks[0]) * (size_t)((rows - count) * cols));
+    memmove(&s->row_masks[0], &s->row_masks[count], sizeof(s->row_masks[0]) * (size_t)(rows - count));
+
+    const Block garbage = {.piece_id = GARBAGE_PIECE_ID, .piece_kind = PIECE_GARBAGE};
+    const uint16_t garbage_mask = (uint16_t)(((1u << cols) - 1) & ~(1u << hole_col));
+    for (int row = rows - count; row < rows; row++)
+    {
+        Block *line = &s->blocks[row * cols];
+        for (int col = 0; col < cols; col++) line[col] = garbage;
+        line[hole_col] = (Block){0};
+        s->row_masks[row] = garbage_mask;
+    }
+
+    const Piece *p = &s->current_piece;
+    return !spilled && check_piece_collision_fast(s, p, p->x, p->y, p->orient);
+}
+
+// Clears every full line, noting each in `report` (if any) before it goes.
+static int clear_full_lines(Game_State *s, Lock_Report *report)
+{
+    int cleared = 0;
+    int line = find_full_line(s);
+    while (line >= 0)
+    {
+        if (report && report->cleared < LOCK_REPORT_LINES)
+        {
+            int i = report->cleared++;
+            report->rows[i] = (int8_t)line;
+            for (int col = 0; col < s->tetris_cols; col++) report->kinds[i][col] = (uint8_t)get_block_at(s, col, line)->piece_kind;
+        }
+        delete_line(s, line);
+        cleared++;
+        line = find_full_line(s);
+    }
+    if (cleared) trace_instant("line_clear", "lines", cleared);
+    return cleared;
+}
+
+int check_lines(Game_State *s)
+{
+    return clear_full_lines(s, NULL);
+}
+
+// -----------------------------------------------
+
+// Solid for T-spin purposes: walls and floor count, the space above the board doesn't.
+static bool is_cell_solid(Game_State *s, int x, int y)
+{
+    if (x < 0 || x >= s->tetris_cols || y >= s->tetris_rows) return true;
+    if (y < 0) return false;
+    return (s->row_masks[y] >> x) & 1;
+}
+
+// Where the T's centre sits in its frame, and which way its nub points.
+static const struct {
+    int8_t cx, cy;
+    int8_t fx, fy;
+} t_spin_frames[PIECE_ORIENT_COUNT] = {
+    [PIECE_ORIENT_UP]    = {1, 1, 0, -1},
+    [PIECE_ORIENT_RIGHT] = {0, 1, 1, 0},
+    [PIECE_ORIENT_DOWN]  = {1, 0, 0, 1},
+    [PIECE_ORIENT_LEFT]  = {1, 1, -1, 0},
+};
+
+/*
+ * Three-corner rule: a T that got to where it locks by turning, with at
+ * least three of the corners around its centre filled. Unless both corners
+ * on the side it points at are among them, it's a mini.
+ */
+Spin_Kind detect_spin(Game_State *s)
+{
+    const Piece *p = &s->current_piece;
+    if (p->kind != PIECE_T || !s->last_move_rotated) return SPIN_NONE;
+
+    int cx = p->x + t_spin_frames[p->orient].cx;
+    int cy = p->y + t_spin_frames[p->orient].cy;
+    int fx = t_spin_frames[p->orient].fx;
+    int fy = t_spin_frames[p->orient].fy;
+
+    int corners = 0, front = 0;
+    for (int dy = -1; dy <= 1; dy += 2)
+    {
+        for (int dx = -1; dx <= 1; dx += 2)
+        {
+            if (!is_cell_solid(s, cx + dx, cy + dy)) continue;
+            corners++;
+            if (dx == fx || dy == fy) front++;
+        }
+    }
+
+    if (corners < 3) return SPIN_NONE;
+    return front == 2 ? SPIN_T : SPIN_T_MINI;
+}
+
+// An empty board tall enough for any kick from FINESSE_Y.
+static const uint16_t finesse_board[2 * PIECE_MAX_ROWS];
+#define FINESSE_Y (PIECE_MAX_ROWS / 2)
+
+/*
+ * Fewest presses that take a piece from its spawn column and orientation to
+ * `to_x`, `to_o` on an empty board, counting a tap, a shift held to the
+ * wall and a turn as one press each. -1 if it can't get there.
+ */
+int finesse_min_inputs(int cols, Piece_Kind kind, int from_x, Piece_Orient from_o, int to_x, Piece_Orient to_o)
+{
+    int dist[PIECE_ORIENT_COUNT][16];
+    int queue[PIECE_ORIENT_COUNT * 16];
+    int head = 0, tail = 0;
+    memset(dist, -1, sizeof(dist));
+
+    if (from_x < 0 || from_x >= cols) return -1;
+    dist[from_o][from_x] = 0;
+    queue[tail++] = from_o * 16 + from_x;
+
+    while (head < tail)
+    {
+        int o = queue[head] / 16, x = queue[head] % 16;
+        head++;
+        if (o == (int)to_o && x == to_x) return dist[o][x];
+
+        int next[7][2];
+        int next_count = 0;
+        for (int dir = -1; dir <= 1; dir += 2)
+        {
+            if (piece_fits(finesse_board, cols, 2 * PIECE_MAX_ROWS, kind, (Piece_Orient)o, x + dir, FINESSE_Y))
+            {
+                next[next_count][0] = o;
+                next[next_count][1] = x + dir;
+                next_count++;
+
+                int wall = x + dir;
+                while (piece_fits(finesse_board, cols, 2 * PIECE_MAX_ROWS, kind, (Piece_Orient)o, wall + dir, FINESSE_Y)) wall += dir;
+                next[next_count][0] = o;
+                next[next_count][1] = wall;
+                next_count++;
+            }
+        }
+        for (int rot = PIECE_ROTATE_CW; rot <= PIECE_ROTATE_CCW; rot++)
+        {
+            Piece p = {.kind = kind, .x = x, .y = FINESSE_Y, .orient = (Piece_Orient)o}, turned;
+            if (piece_try_rotate(finesse_board, cols, 2 * PIECE_MAX_ROWS, &p, (Piece_Rotation)rot, &turned))
+            {
+                next[next_count][0] = turned.orient;
+                next[next_count][1] = turned.x;
+                next_count++;
+            }
+        }
+
+        for (int i = 0; i < next_count; i++)
+        {
+            int no = next[i][0], nx = next[i][1];
+            if (nx < 0 || nx >= cols || dist[no][nx] >= 0) continue;
+            dist[no][nx] = dist[o][x] + 1;
+            queue[tail++] = no * 16 + nx;
+        }
+    }
+    return -1;
+}
+
+// Height and finesse bookkeeping for a piece that's just been committed.
+static void record_piece_stats(Game_State *s)
+{
+    const Piece *p = &s->current_piece;
+    Game_Stats *st = &s->stats;
+
+    unsigned int mask = piece_spec_get_mask(piece_spec_get_by_kind(p->kind), p->orient);
+    int top = p->y + __builtin_ctz(mask) / PIECE_MAX_COLS;
+    if (s->tetris_rows - top > st->max_height) st->max_height = s->tetris_rows - top;
+
+    // Pieces placed without any presses (the headless AI) have nothing to judge.
+    if (st->piece_inputs > 0)
+    {
+        int best = finesse_min_inputs(s->tetris_cols, p->kind, st->spawn_x, (Piece_Orient)st->spawn_orient, p->x, p->orient);
+        if (best >= 0 && st->piece_inputs > best) st->finesse_faults++;
+    }
+}
+
+/*
+ * Commits the current piece, scores it, clears lines and spawns the next
+ * one. Returns lines cleared; what went is left in the next lock report.
+ */
+int lock_current_piece(Game_State *s)
+{
+    Lock_Report *report = &s->locks[s->lock_count++ % LOCK_REPORT_RING];
+    report->piece = s->current_piece;
+    report->cleared = 0;
+
+    Spin_Kind spin = detect_spin(s);
+    commit_piece(s, &s->current_piece);
+    record_piece_stats(s);
+    int cleared = clear_full_lines(s, report);
+    game_stats_on_lock(&s->stats, cleared, spin);
+    if (!generate_new_piece(s))
+    {
+        s->is_game_over = true;
+    }
+    return cleared;
+}
+
+// -----------------------------------------------
+
+// Everything a game owns, sized from its board. Anything per-game added later goes here too.
+size_t game_arena_size(int cols, int rows)
+{
+    return arena_align_up(sizeof(Block) * (size_t)(cols * rows), 64) +
+           arena_align_up(sizeof(uint16_t) * (size_t)rows, 64);
+}
+
+// Carves the (zeroed) board out of the game's arena, discarding whatever was there.
+void game_arena_layout(Game_State *s)
+{
+    arena_reset(&s->arena);
+    s->blocks = arena_push(&s->arena, sizeof(Block) * (size_t)(s->tetris_cols * s->tetris_rows), 64);
+    s->row_masks = arena_push(&s->arena, sizeof(uint16_t) * (size_t)s->tetris_rows, 64);
+}
+
+/*
+ * Starts a game. The arena is allocated on the first call (or if the board
+ * size changed) and reset in place after that, so restarts don't allocate.
+ */
+void initialize_game_with_seed(Game_State *s, uint64_t seed)
+{
+    size_t arena_size = game_arena_size(s->tetris_cols, s->tetris_rows);
+    if (s->arena.size != arena_size)
+    {
+        arena_release(&s->arena);
+        if (!arena_init(&s->arena, arena_size))
+        {
+            fprintf(stderr, "Game: couldn't allocate %zu bytes for the board\n", arena_size);
+            abort();
+        }
+    }
+
+    game_arena_layout(s);
+    s->piece_id_seed = 1;
+    s->rng_state = seed;
+    game_stats_reset(&s->stats);
+    generate_new_piece(s);
+    sim_reset(&s->sim, s->stats.level);
+    s->is_game_over = false;
+}
+
+void initialize_game(Game_State *s)
+{
+    initialize_game_with_seed(s, (uint64_t)time(NULL));
+}
+
+void free_game(Game_State *s)
+{
+    arena_release(&s->arena);
+    s->blocks = NULL;
+    s->row_masks = NULL;
+}
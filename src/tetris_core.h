@@ -0,0 +1,105 @@
+#pragma once
+
+/*
+ * Public API of the headless core library (libtetris_core.a).
+ * In-tree tools include the .c files directly instead; this is for
+ * code that links against the library.
+ */
+
+#ifndef TETRIS_HEADLESS
+#define TETRIS_HEADLESS
+#endif
+
+#include "tetris.h"
+#include "ai.h"
+#include "nn.h"
+#include "dataset.h"
+#include "versus.h"
+#include "lockstep.h"
+#include "movegen.h"
+#include "puzzle.h"
+#include "trace.h"
+
+// tetris_core.c
+Block *get_block_at(Game_State *s, int x, int y);
+void commit_piece(Game_State *s, const Piece *piece);
+bool check_piece_collision(Game_State *s, const Piece *piece, int new_x, int new_y, Piece_Orient new_orient);
+bool check_piece_collision_fast(Game_State *s, const Piece *piece, int new_x, int new_y, Piece_Orient new_orient);
+void rebuild_row_masks(Game_State *s);
+bool set_current_piece(Game_State *s, Piece p);
+bool generate_new_piece(Game_State *s);
+bool move_current_piece_down(Game_State *s);
+bool rotate_current_piece(Game_State *s, Piece_Rotation rot);
+bool slide_current_piece(Game_State *s, int dir);
+int find_full_line(Game_State *s);
+void delete_line(Game_State *s, int line);
+bool insert_garbage_rows(Game_State *s, int count, int hole_col);
+int check_lines(Game_State *s);
+Spin_Kind detect_spin(Game_State *s);
+int finesse_min_inputs(int cols, Piece_Kind kind, int from_x, Piece_Orient from_o, int to_x, Piece_Orient to_o);
+int lock_current_piece(Game_State *s);
+size_t game_arena_size(int cols, int rows);
+void game_arena_layout(Game_State *s);
+void initialize_game_with_seed(Game_State *s, uint64_t seed);
+void initialize_game(Game_State *s);
+void free_game(Game_State *s);
+
+// sim.c
+void sim_step(Game_State *s);
+void sim_advance(Game_State *s, float dt);
+
+// ai.c
+void ai_snapshot_from_state(Game_State *s, Ai_Snapshot *snap);
+int ai_enumerate_placements(const Ai_Snapshot *snap, Ai_Candidate out[AI_MAX_CANDIDATES]);
+bool ai_find_best_placement(const Ai_Snapshot *snap, const Ai_Weights *weights, Ai_Placement *out);
+Ai_Worker *ai_worker_start(Ai_Weights weights, const Nn_Model *nn);
+void ai_worker_stop(Ai_Worker *ai);
+void ai_drive(Ai_Worker *ai, Game_State *s);
+int ai_play_placement(Game_State *s, const Ai_Placement *placement);
+int ai_play_step(Game_State *s, const Ai_Weights *weights);
+int ai_nn_batch_add(Nn_Batch *b, const Ai_Snapshot *snap, const Ai_Candidate *c);
+bool ai_find_best_placement_nn(const Nn_Model *m, Nn_Batch *b, const Ai_Snapshot *snap, Ai_Placement *out);
+int ai_play_step_nn(Game_State *s, const Nn_Model *m, Nn_Batch *b);
+
+// nn.c
+Nn_Model *nn_model_load(const char *path);
+bool nn_model_save(const Nn_Model *m, const char *path);
+Nn_Model *nn_model_from_weights(const Ai_Weights *weights);
+void nn_model_free(Nn_Model *m);
+bool nn_batch_init(Nn_Batch *b, int capacity);
+void nn_batch_free(Nn_Batch *b);
+const float *nn_forward(const Nn_Model *m, Nn_Batch *b);
+
+// versus.c
+void versus_match_init(Versus_Match *m, uint64_t seed);
+void versus_match_free(Versus_Match *m);
+void versus_settle(Versus_Match *m, const int cleared[VERSUS_PLAYERS]);
+Versus_Result versus_match_step(Versus_Match *m, const Ai_Weights weights[VERSUS_PLAYERS]);
+Versus_Result versus_match_play(Versus_Match *m, const Ai_Weights weights[VERSUS_PLAYERS], int max_pieces);
+
+// dataset.c
+void dataset_record_from_state(Game_State *s, Dataset_Record *r);
+bool dataset_writer_open(Dataset_Writer *w, const char *path, int cols, int rows);
+bool dataset_writer_append(Dataset_Writer *w, const Dataset_Record *records, int count);
+bool dataset_writer_close(Dataset_Writer *w);
+void dataset_writer_discard(Dataset_Writer *w);
+bool dataset_reader_open(Dataset_Reader *r, const char *path);
+void dataset_reader_close(Dataset_Reader *r);
+
+// lockstep.c
+bool lockstep_init(Lockstep_Engine *L, int count, int cols, int rows);
+void lockstep_free(Lockstep_Engine *L);
+void lockstep_start(Lockstep_Engine *L, int g, uint64_t seed, uint64_t policy_seed);
+void lockstep_step(Lockstep_Engine *L);
+int lockstep_playing_count(const Lockstep_Engine *L);
+
+// movegen.c
+int movegen_locks(const uint16_t *board, int cols, int rows, const Piece *spawn, Movegen_Locks *out);
+
+// puzzle.c
+bool puzzle_load(Game_State *s, Puzzle *p, const char *path);
+bool puzzle_solve(const Game_State *s, const Puzzle *p, int threads, Puzzle_Solution *out);
+
+// trace.c
+bool trace_start(const char *path);
+void trace_stop();
@@ -0,0 +1,149 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+#define TRACE_FLUSH_MS 5
+
+typedef struct {
+    FILE *file;
+    pthread_t flusher;
+    _Atomic bool stopping;
+    bool wrote_event;
+
+    // Cycle counter to wall time, refined at every flush as the span between samples grows.
+    uint64_t start_ticks;
+    double start_ns;
+    double ns_per_tick;
+} Trace_Writer;
+
+static Trace_Writer trace_writer;
+
+static double trace_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void trace_calibrate(Trace_Writer *w)
+{
+    double elapsed_ns = trace_now_ns() - w->start_ns;
+    uint64_t elapsed_ticks = trace_ticks() - w->start_ticks;
+    if (elapsed_ns > 1e6 && elapsed_ticks > 0) w->ns_per_tick = elapsed_ns / (double)elapsed_ticks;
+}
+
+static void trace_write_event(Trace_Writer *w, const Trace_Ring *r, const Trace_Event *e)
+{
+    double us = (double)(int64_t)(e->ticks - w->start_ticks) * w->ns_per_tick * 1e-3;
+    fprintf(w->file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+        w->wrote_event ? ",\n" : "", e->name, e->phase, us, r->tid);
+    if (e->phase == 'i') fputs(",\"s\":\"t\"", w->file);
+    if (e->arg_name) fprintf(w->file, ",\"args\":{\"%s\":%d}", e->arg_name, e->arg);
+    fputc('}', w->file);
+    w->wrote_event = true;
+}
+
+// Writes out everything recorded so far and hands the space back to the threads.
+static void trace_drain(Trace_Writer *w)
+{
+    trace_calibrate(w);
+    for (Trace_Ring *r = atomic_load(&trace_rings); r; r = r->next)
+    {
+        uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        for (; tail != head; tail++) trace_write_event(w, r, &r->events[tail & (TRACE_RING_EVENTS - 1)]);
+        atomic_store_explicit(&r->tail, tail, memory_order_release);
+    }
+}
+
+static void *trace_flusher_main(void *arg)
+{
+    Trace_Writer *w = arg;
+    const struct timespec interval = {.tv_nsec = TRACE_FLUSH_MS * 1000000L};
+    for (;;)
+    {
+        bool stopping = atomic_load(&w->stopping);
+        trace_drain(w);
+        if (stopping) break;
+        nanosleep(&interval, NULL);
+    }
+    return NULL;
+}
+
+/*
+ * Starts recording to `path`, replacing it, with the calling thread
+ * named "main". Other threads join with their first event.
+ */
+bool trace_start(const char *path)
+{
+    Trace_Writer *w = &trace_writer;
+    if (w->file) return false;
+
+    w->file = fopen(path, "w");
+    if (!w->file)
+    {
+        fprintf(stderr, "Trace: couldn't write %s\n", path);
+        return false;
+    }
+    fputs("[\n", w->file);
+    w->wrote_event = false;
+    atomic_store(&w->stopping, false);
+
+    // Anything a thread squeezed in after the last trace stopped is stale.
+    for (Trace_Ring *r = atomic_load(&trace_rings); r; r = r->next)
+    {
+        atomic_store(&r->tail, atomic_load(&r->head));
+        atomic_store(&r->dropped, 0);
+    }
+
+    // A first guess at the counter's rate, good until the first flush has a longer span to go on.
+    w->start_ns = trace_now_ns();
+    w->start_ticks = trace_ticks();
+    w->ns_per_tick = 1.0;
+#if defined(__x86_64__) || defined(__i386__)
+    const struct timespec pause = {.tv_nsec = 2000000L};
+    nanosleep(&pause, NULL);
+    w->ns_per_tick = (trace_now_ns() - w->start_ns) / (double)(trace_ticks() - w->start_ticks);
+#endif
+
+    if (pthread_create(&w->flusher, NULL, trace_flusher_main, w) != 0)
+    {
+        fprintf(stderr, "Trace: couldn't start the flusher thread\n");
+        fclose(w->file);
+        w->file = NULL;
+        return false;
+    }
+
+    atomic_store(&trace_enabled, true);
+    trace_ring_for_thread();
+    trace_thread_name("main");
+    return true;
+}
+
+// Stops recording, writes out what's left and closes the file.
+void trace_stop()
+{
+    Trace_Writer *w = &trace_writer;
+    if (!w->file) return;
+
+    atomic_store(&trace_enabled, false);
+    atomic_store(&w->stopping, true);
+    pthread_join(w->flusher, NULL);
+
+    uint64_t dropped = 0;
+    for (Trace_Ring *r = atomic_load(&trace_rings); r; r = r->next)
+    {
+        fprintf(w->file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            w->wrote_event ? ",\n" : "", r->tid, r->thread_name[0] ? r->thread_name : "thread");
+        w->wrote_event = true;
+        dropped += atomic_load(&r->dropped);
+    }
+    fputs("\n]\n", w->file);
+    fclose(w->file);
+    w->file = NULL;
+
+    if (dropped) fprintf(stderr, "Trace: dropped %llu events that came faster than they could be written\n", (unsigned long long)dropped);
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "mem.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ * Opt-in event tracing to Chrome/Perfetto trace JSON (load the file in
+ * chrome://tracing or ui.perfetto.dev).
+ *
+ *   trace_start("run.json");
+ *   trace_begin("commit_piece");  ...  trace_end("commit_piece");
+ *   trace_instant("lines", "count", cleared);
+ *   trace_stop();
+ *
+ * Each thread records into its own ring of fixed-size events: a check of
+ * the enabled flag, a timestamp from the cycle counter and four stores,
+ * with no locks or allocation after a thread's first event. A thread in
+ * trace.c drains the rings to the file every few milliseconds. When a
+ * ring is full, events are dropped and counted rather than waited on.
+ *
+ * Names must be string literals (or otherwise outlive the trace): only
+ * the pointer is recorded. Rings stay on the list for the life of the
+ * process, as the flusher walks it without locks, but a thread's ring goes
+ * back for reuse when the thread exits, so restarting a worker (the bot,
+ * say) doesn't cost another ring each time.
+ */
+
+#define TRACE_RING_EVENTS (1 << 16)
+#define TRACE_NAME_MAX 32
+
+typedef struct {
+    uint64_t ticks;
+    const char *name;
+    const char *arg_name;   // NULL for none.
+    int32_t arg;
+    char phase;             // 'B', 'E' or 'i', as in the trace format.
+} Trace_Event;
+
+typedef struct Trace_Ring {
+    _Atomic uint32_t head;      // Written by the recording thread only.
+    _Atomic uint32_t tail;      // Written by the flusher only.
+    uint32_t cached_tail;       // The recording thread's last look at `tail`.
+    _Atomic uint64_t dropped;
+    _Atomic bool in_use;        // Some live thread records into it.
+    int tid;                    // Kept when the ring is reused: its events go on the same track.
+    char thread_name[TRACE_NAME_MAX];
+    struct Trace_Ring *next;
+    Trace_Event events[TRACE_RING_EVENTS];
+} Trace_Ring;
+
+static _Atomic bool trace_enabled;
+static _Atomic(Trace_Ring *) trace_rings;   // Every thread's ring, newest first.
+static _Atomic int trace_ring_count;
+static _Thread_local Trace_Ring *trace_thread_ring;
+static pthread_key_t trace_ring_key;       // Hands a thread's ring back when it exits.
+static pthread_once_t trace_ring_key_once = PTHREAD_ONCE_INIT;
+
+static inline uint64_t trace_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static void trace_ring_release(void *ring)
+{
+    atomic_store_explicit(&((Trace_Ring *)ring)->in_use, false, memory_order_release);
+}
+
+static void trace_ring_key_make()
+{
+    pthread_key_create(&trace_ring_key, trace_ring_release);
+}
+
+// The calling thread's ring, taken on its first event: one an exited thread left, or a new one.
+static inline Trace_Ring *trace_ring_for_thread()
+{
+    if (trace_thread_ring) return trace_thread_ring;
+
+    Trace_Ring *r = atomic_load(&trace_rings);
+    for (; r; r = r->next)
+    {
+        bool idle = false;
+        if (atomic_compare_exchange_strong(&r->in_use, &idle, true)) break;
+    }
+
+    if (!r)
+    {
+        r = mem_calloc(1, sizeof(*r));
+        if (!r) return NULL;
+        atomic_init(&r->in_use, true);
+        r->tid = atomic_fetch_add(&trace_ring_count, 1) + 1;
+        r->next = atomic_load(&trace_rings);
+        while (!atomic_compare_exchange_weak(&trace_rings, &r->next, r)) {}
+    }
+
+    pthread_once(&trace_ring_key_once, trace_ring_key_make);
+    pthread_setspecific(trace_ring_key, r);
+    trace_thread_ring = r;
+    return r;
+}
+
+// Names the calling thread in the trace; a no-op while tracing is off.
+static inline void trace_thread_name(const char *name)
+{
+    if (!atomic_load_explicit(&trace_enabled, memory_order_relaxed)) return;
+    Trace_Ring *r = trace_ring_for_thread();
+    if (!r) return;
+    size_t i = 0;
+    for (; name[i] && i + 1 < TRACE_NAME_MAX; i++) r->thread_name[i] = name[i];
+    r->thread_name[i] = 0;
+}
+
+static inline void trace_record(char phase, const char *name, const char *arg_name, int32_t arg)
+{
+    if (!atomic_load_explicit(&trace_enabled, memory_order_relaxed)) return;
+    Trace_Ring *r = trace_thread_ring ? trace_thread_ring : trace_ring_for_thread();
+    if (!r) return;
+
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (head - r->cached_tail == TRACE_RING_EVENTS)
+    {
+        r->cached_tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        if (head - r->cached_tail == TRACE_RING_EVENTS)
+        {
+            atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+            return;
+        }
+    }
+
+    Trace_Event *e = &r->events[head & (TRACE_RING_EVENTS - 1)];
+    e->ticks = trace_ticks();
+    e->name = name;
+    e->arg_name = arg_name;
+    e->arg = arg;
+    e->phase = phase;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+static inline void trace_begin(const char *name)
+{
+    trace_record('B', name, NULL, 0);
+}
+
+static inline void trace_end(const char *name)
+{
+    trace_record('E', name, NULL, 0);
+}
+
+// A point in time, with one named integer shown alongside it (arg_name may be NULL).
+static inline void trace_instant(const char *name, const char *arg_name, int32_t arg)
+{
+    trace_record('i', name, arg_name, arg);
+}
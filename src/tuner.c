@@ -0,0 +1,443 @@
+/*
+ * Offline evolution of Ai_Weights on the headless core.
+ *
+ * Runs a (mu/mu_w, lambda) evolution strategy with a diagonal covariance
+ * (separable CMA, minus the evolution paths). Each candidate plays the same
+ * fixed set of seeds, spread over all cores. State is checkpointed after
+ * every generation and picked back up on the next run, seed set included.
+ *
+ *   bin/tuner [--population N] [--generations N] [--seeds N] [--max-pieces N]
+ *             [--threads N] [--seed N] [--checkpoint path]
+ */
+
+#define TETRIS_HEADLESS
+
+#include <math.h>
+#include <pthread.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tetris.h"
+#include "ai.h"
+
+#include "tetris_core.c"
+#include "nn.c"
+#include "ai.c"
+
+#define TUNER_MAX_POPULATION 256
+#define TUNER_MAX_SEEDS 1024
+#define TUNER_CHECKPOINT_VERSION 2
+
+typedef struct {
+    int population;
+    int generations;
+    int seed_count;
+    int max_pieces;
+    int threads;
+    uint64_t base_seed;
+    const char *checkpoint_path;
+} Tuner_Config;
+
+typedef struct {
+    int generation;
+    uint64_t rng_state;
+
+    // The seed set every candidate plays, so fitness stays comparable across a resume.
+    uint64_t base_seed;
+    int seed_count;
+
+    float mean[AI_FEATURE_COUNT];
+    float sigma[AI_FEATURE_COUNT];
+
+    float best_fitness;
+    Ai_Weights best;
+
+    int population;
+    Ai_Weights candidates[TUNER_MAX_POPULATION];
+    float fitness[TUNER_MAX_POPULATION];
+} Tuner_State;
+
+typedef struct {
+    const Tuner_Config *config;
+    Tuner_State *state;
+    const uint64_t *seeds;
+
+    _Atomic int next_item;
+    _Atomic long games;
+    _Atomic long placements;
+    int *lines;
+} Tuner_Batch;
+
+static double tuner_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static float tuner_gaussian(uint64_t *rng)
+{
+    // Box-Muller, one sample per call is plenty here.
+    double u1 = ((double)(rng_next(rng) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    double u2 = (double)(rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+    return (float)(sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2));
+}
+
+static void tuner_normalize(float *v, float *scale_too)
+{
+    float len = 0.0f;
+    for (int i = 0; i < AI_FEATURE_COUNT; i++) len += v[i] * v[i];
+    len = sqrtf(len);
+    if (len == 0.0f) return;
+    for (int i = 0; i < AI_FEATURE_COUNT; i++)
+    {
+        v[i] /= len;
+        if (scale_too) scale_too[i] /= len;
+    }
+}
+
+// --------------------------------------------------------------------
+
+static int tuner_play_game(Game_State *s, const Ai_Weights *weights, uint64_t seed, int max_pieces, int *out_pieces)
+{
+    s->tetris_cols = TETRIS_COLS;
+    s->tetris_rows = TETRIS_ROWS;
+    initialize_game_with_seed(s, seed);
+
+    int lines = 0;
+    int pieces = 0;
+    while (!s->is_game_over && pieces < max_pieces)
+    {
+        int cleared = ai_play_step(s, weights);
+        if (cleared < 0) break;
+        lines += cleared;
+        pieces++;
+    }
+    *out_pieces = pieces;
+    return lines;
+}
+
+static void *tuner_worker(void *arg)
+{
+    Tuner_Batch *batch = arg;
+    const Tuner_Config *c = batch->config;
+    const int total = batch->state->population * c->seed_count;
+
+    Game_State s = {0};
+    for (;;)
+    {
+        int item = atomic_fetch_add_explicit(&batch->next_item, 1, memory_order_relaxed);
+        if (item >= total) break;
+
+        int candidate = item / c->seed_count;
+        int seed_index = item % c->seed_count;
+        int pieces = 0;
+        batch->lines[item] = tuner_play_game(&s, &batch->state->candidates[candidate], batch->seeds[seed_index], c->max_pieces, &pieces);
+
+        atomic_fetch_add_explicit(&batch->games, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&batch->placements, pieces, memory_order_relaxed);
+    }
+    free_game(&s);
+    return NULL;
+}
+
+static void tuner_evaluate(const Tuner_Config *c, Tuner_State *t, const uint64_t *seeds)
+{
+    Tuner_Batch batch = {
+        .config = c,
+        .state = t,
+        .seeds = seeds,
+        .lines = calloc((size_t)t->population * c->seed_count, sizeof(int)),
+    };
+
+    double start = tuner_now();
+
+    pthread_t threads[256];
+    int thread_count = c->threads < 256 ? c->threads : 256;
+    for (int i = 0; i < thread_count; i++) pthread_create(&threads[i], NULL, tuner_worker, &batch);
+    for (int i = 0; i < thread_count; i++) pthread_join(threads[i], NULL);
+
+    double elapsed = tuner_now() - start;
+
+    for (int i = 0; i < t->population; i++)
+    {
+        long sum = 0;
+        for (int j = 0; j < c->seed_count; j++) sum += batch.lines[i * c->seed_count + j];
+        t->fitness[i] = (float)sum / (float)c->seed_count;
+    }
+
+    long games = atomic_load(&batch.games);
+    long placements = atomic_load(&batch.placements);
+    printf("  %ld games, %ld placements in %.2fs: %.1f games/s, %.0f placements/s\n",
+        games, placements, elapsed, (double)games / elapsed, (double)placements / elapsed);
+
+    free(batch.lines);
+}
+
+static void tuner_sample(Tuner_State *t)
+{
+    for (int i = 0; i < t->population; i++)
+    {
+        for (int f = 0; f < AI_FEATURE_COUNT; f++)
+        {
+            t->candidates[i].w[f] = t->mean[f] + t->sigma[f] * tuner_gaussian(&t->rng_state);
+        }
+    }
+}
+
+static void tuner_update(Tuner_State *t)
+{
+    int order[TUNER_MAX_POPULATION];
+    for (int i = 0; i < t->population; i++) order[i] = i;
+    for (int i = 1; i < t->population; i++)
+    {
+        int k = order[i];
+        int j = i - 1;
+        while (j >= 0 && t->fitness[order[j]] < t->fitness[k])
+        {
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = k;
+    }
+
+    if (t->fitness[order[0]] > t->best_fitness)
+    {
+        t->best_fitness = t->fitness[order[0]];
+        t->best = t->candidates[order[0]];
+    }
+
+    int mu = t->population / 2;
+    if (mu < 1) mu = 1;
+    float rw[TUNER_MAX_POPULATION];
+    float rw_sum = 0.0f;
+    for (int i = 0; i < mu; i++)
+    {
+        rw[i] = logf((float)mu + 0.5f) - logf((float)i + 1.0f);
+        rw_sum += rw[i];
+    }
+
+    const float c_sigma = 0.3f;
+    float new_mean[AI_FEATURE_COUNT] = {0};
+    for (int i = 0; i < mu; i++)
+    {
+        for (int f = 0; f < AI_FEATURE_COUNT; f++) new_mean[f] += rw[i] / rw_sum * t->candidates[order[i]].w[f];
+    }
+    for (int f = 0; f < AI_FEATURE_COUNT; f++)
+    {
+        float var = 0.0f;
+        for (int i = 0; i < mu; i++)
+        {
+            float d = t->candidates[order[i]].w[f] - t->mean[f];
+            var += rw[i] / rw_sum * d * d;
+        }
+        t->sigma[f] = sqrtf((1.0f - c_sigma) * t->sigma[f] * t->sigma[f] + c_sigma * var);
+        if (t->sigma[f] < 1e-3f) t->sigma[f] = 1e-3f;
+    }
+
+    // Scores are linear in the weights, only the direction matters.
+    memcpy(t->mean, new_mean, sizeof(new_mean));
+    tuner_normalize(t->mean, t->sigma);
+}
+
+// --------------------------------------------------------------------
+
+static void tuner_write_floats(FILE *f, const float *v)
+{
+    for (int i = 0; i < AI_FEATURE_COUNT; i++) fprintf(f, " %.9g", v[i]);
+    fprintf(f, "\n");
+}
+
+static bool tuner_read_floats(FILE *f, float *v)
+{
+    for (int i = 0; i < AI_FEATURE_COUNT; i++)
+    {
+        if (fscanf(f, "%f", &v[i]) != 1) return false;
+    }
+    return true;
+}
+
+// Reports its own failures, naming the file and why.
+static bool tuner_save_checkpoint(const char *path, const Tuner_State *t)
+{
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *f = fopen(tmp_path, "w");
+    if (!f)
+    {
+        fprintf(stderr, "Couldn't write checkpoint %s: %s\n", tmp_path, strerror(errno));
+        return false;
+    }
+
+    fprintf(f, "tetris-tuner %d\n", TUNER_CHECKPOINT_VERSION);
+    fprintf(f, "features %d\n", AI_FEATURE_COUNT);
+    fprintf(f, "generation %d\n", t->generation);
+    fprintf(f, "rng %llu\n", (unsigned long long)t->rng_state);
+    fprintf(f, "seeds %llu %d\n", (unsigned long long)t->base_seed, t->seed_count);
+    fprintf(f, "mean"); tuner_write_floats(f, t->mean);
+    fprintf(f, "sigma"); tuner_write_floats(f, t->sigma);
+    fprintf(f, "best %.9g", t->best_fitness); tuner_write_floats(f, t->best.w);
+    fprintf(f, "population %d\n", t->population);
+    for (int i = 0; i < t->population; i++)
+    {
+        fprintf(f, "%.9g", t->fitness[i]);
+        tuner_write_floats(f, t->candidates[i].w);
+    }
+
+    bool ok = !ferror(f);
+    int write_errno = errno;
+    if (fclose(f) != 0 && ok)
+    {
+        ok = false;
+        write_errno = errno;
+    }
+    if (!ok)
+    {
+        fprintf(stderr, "Couldn't write checkpoint %s: %s\n", tmp_path, strerror(write_errno));
+        remove(tmp_path);
+        return false;
+    }
+
+    // Rename so an interrupted write never clobbers the previous checkpoint.
+    if (rename(tmp_path, path) != 0)
+    {
+        fprintf(stderr, "Couldn't move checkpoint %s to %s: %s\n", tmp_path, path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static bool tuner_load_checkpoint(const char *path, Tuner_State *t)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+
+    int version = 0, features = 0;
+    unsigned long long rng = 0, base_seed = 0;
+    bool ok =
+        fscanf(f, " tetris-tuner %d", &version) == 1 && version == TUNER_CHECKPOINT_VERSION &&
+        fscanf(f, " features %d", &features) == 1 && features == AI_FEATURE_COUNT &&
+        fscanf(f, " generation %d", &t->generation) == 1 &&
+        fscanf(f, " rng %llu", &rng) == 1 &&
+        fscanf(f, " seeds %llu %d", &base_seed, &t->seed_count) == 2 &&
+        t->seed_count > 0 && t->seed_count <= TUNER_MAX_SEEDS &&
+        fscanf(f, " mean") == 0 && tuner_read_floats(f, t->mean) &&
+        fscanf(f, " sigma") == 0 && tuner_read_floats(f, t->sigma) &&
+        fscanf(f, " best %f", &t->best_fitness) == 1 && tuner_read_floats(f, t->best.w) &&
+        fscanf(f, " population %d", &t->population) == 1 &&
+        t->population > 0 && t->population <= TUNER_MAX_POPULATION;
+
+    for (int i = 0; ok && i < t->population; i++)
+    {
+        ok = fscanf(f, "%f", &t->fitness[i]) == 1 && tuner_read_floats(f, t->candidates[i].w);
+    }
+
+    fclose(f);
+    t->rng_state = rng;
+    t->base_seed = base_seed;
+    if (!ok) fprintf(stderr, "Ignoring malformed checkpoint %s\n", path);
+    return ok;
+}
+
+// --------------------------------------------------------------------
+
+static void tuner_usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [--population N] [--generations N] [--seeds N] [--max-pieces N]\n"
+        "          [--threads N] [--seed N] [--checkpoint path]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    Tuner_Config c = {
+        .population = 32,
+        .generations = 50,
+        .seed_count = 16,
+        .max_pieces = 2000,
+        .threads = cpus > 0 ? (int)cpus : 1,
+        .base_seed = 1,
+        .checkpoint_path = "tuner.ckpt",
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (!val) { tuner_usage(argv[0]); return 1; }
+
+        if      (!strcmp(arg, "--population"))  c.population = atoi(val);
+        else if (!strcmp(arg, "--generations")) c.generations = atoi(val);
+        else if (!strcmp(arg, "--seeds"))       c.seed_count = atoi(val);
+        else if (!strcmp(arg, "--max-pieces"))  c.max_pieces = atoi(val);
+        else if (!strcmp(arg, "--threads"))     c.threads = atoi(val);
+        else if (!strcmp(arg, "--seed"))        c.base_seed = strtoull(val, NULL, 10);
+        else if (!strcmp(arg, "--checkpoint"))  c.checkpoint_path = val;
+        else { tuner_usage(argv[0]); return 1; }
+        i++;
+    }
+
+    if (c.population < 2 || c.population > TUNER_MAX_POPULATION ||
+        c.seed_count < 1 || c.seed_count > TUNER_MAX_SEEDS ||
+        c.threads < 1 || c.max_pieces < 1)
+    {
+        tuner_usage(argv[0]);
+        return 1;
+    }
+
+    static Tuner_State t;
+    if (tuner_load_checkpoint(c.checkpoint_path, &t))
+    {
+        printf("Resuming from %s at generation %d\n", c.checkpoint_path, t.generation + 1);
+        if (t.base_seed != c.base_seed || t.seed_count != c.seed_count)
+        {
+            printf("  playing its %d seeds from --seed %llu, not --seeds %d --seed %llu\n", t.seed_count,
+                (unsigned long long)t.base_seed, c.seed_count, (unsigned long long)c.base_seed);
+        }
+        c.base_seed = t.base_seed;
+        c.seed_count = t.seed_count;
+        t.generation++;
+        t.population = c.population;
+    }
+    else
+    {
+        Ai_Weights start = ai_default_weights();
+        memcpy(t.mean, start.w, sizeof(t.mean));
+        tuner_normalize(t.mean, NULL);
+        for (int f = 0; f < AI_FEATURE_COUNT; f++) t.sigma[f] = 0.2f;
+        t.rng_state = c.base_seed ^ 0xA5A5A5A5DEADBEEFull;
+        t.best_fitness = -1.0f;
+        t.population = c.population;
+        t.generation = 0;
+        t.base_seed = c.base_seed;
+        t.seed_count = c.seed_count;
+    }
+
+    // The seed set is fixed for the whole run so candidates are comparable across generations.
+    uint64_t seeds[TUNER_MAX_SEEDS];
+    uint64_t seed_rng = c.base_seed;
+    for (int i = 0; i < c.seed_count; i++) seeds[i] = rng_next(&seed_rng);
+
+    for (; t.generation < c.generations; t.generation++)
+    {
+        printf("Generation %d\n", t.generation);
+        tuner_sample(&t);
+        tuner_evaluate(&c, &t, seeds);
+        tuner_update(&t);
+
+        printf("  best so far %.1f lines:", t.best_fitness);
+        for (int f = 0; f < AI_FEATURE_COUNT; f++) printf(" %.4f", t.best.w[f]);
+        printf("\n");
+
+        // A run that can't checkpoint would lose everything it finds from here on.
+        if (!tuner_save_checkpoint(c.checkpoint_path, &t)) return 1;
+    }
+
+    return 0;
+}
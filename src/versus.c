@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "tetris.h"
+#include "versus.h"
+
+// Both boards draw from the same piece seed; garbage holes come from their own stream.
+void versus_match_init(Versus_Match *m, uint64_t seed)
+{
+    uint64_t piece_seed = rng_next(&seed);
+    for (int i = 0; i < VERSUS_PLAYERS; i++)
+    {
+        Game_State *s = &m->players[i];
+        s->tetris_cols = TETRIS_COLS;
+        s->tetris_rows = TETRIS_ROWS;
+        initialize_game_with_seed(s, piece_seed);
+        m->pending_garbage[i] = 0;
+        m->garbage_sent[i] = 0;
+        m->garbage_received[i] = 0;
+        m->lines[i] = 0;
+    }
+    for (int i = 0; i < VERSUS_PLAYERS; i++) m->garbage_rng[i] = rng_next(&seed);
+    m->pieces = 0;
+    m->result = VERSUS_RESULT_PLAYING;
+}
+
+void versus_match_free(Versus_Match *m)
+{
+    for (int i = 0; i < VERSUS_PLAYERS; i++)
+    {
+        free_game(&m->players[i]);
+    }
+}
+
+/*
+ * Settles a step once every player has placed: `cleared` is each player's
+ * lines, or VERSUS_NO_PIECE. Attacks are worked out from what was queued
+ * before the step, so neither player goes first.
+ */
+void versus_settle(Versus_Match *m, const int cleared[VERSUS_PLAYERS])
+{
+    int incoming[VERSUS_PLAYERS] = {0};
+    for (int i = 0; i < VERSUS_PLAYERS; i++)
+    {
+        if (cleared[i] <= 0) continue;
+        m->lines[i] += cleared[i];
+
+        int attack = versus_attack_for_lines(cleared[i]);
+        int cancelled = attack < m->pending_garbage[i] ? attack : m->pending_garbage[i];
+        m->pending_garbage[i] -= cancelled;
+        attack -= cancelled;
+        incoming[1 - i] += attack;
+        m->garbage_sent[i] += attack;
+    }
+
+    for (int i = 0; i < VERSUS_PLAYERS; i++)
+    {
+        Game_State *s = &m->players[i];
+        if (cleared[i] != 0 || m->pending_garbage[i] == 0 || s->is_game_over) continue;
+
+        int count = m->pending_garbage[i];
+        if (count > VERSUS_MAX_GARBAGE_PER_PIECE) count = VERSUS_MAX_GARBAGE_PER_PIECE;
+        m->pending_garbage[i] -= count;
+
+        int hole_col = (int)(rng_next(&m->garbage_rng[i]) % (uint64_t)s->tetris_cols);
+        if (insert_garbage_rows(s, count, hole_col)) m->garbage_received[i] += count;
+        else s->is_game_over = true;
+    }
+
+    for (int i = 0; i < VERSUS_PLAYERS; i++) m->pending_garbage[i] += incoming[i];
+}
+
+// Each bot places one piece, then the step is settled. Returns the result so far.
+Versus_Result versus_match_step(Versus_Match *m, const Ai_Weights weights[VERSUS_PLAYERS])
+{
+    if (m->result != VERSUS_RESULT_PLAYING) return m->result;
+
+    int cleared[VERSUS_PLAYERS];
+    for (int i = 0; i < VERSUS_PLAYERS; i++)
+    {
+        Game_State *s = &m->players[i];
+        cleared[i] = s->is_game_over ? VERSUS_NO_PIECE : ai_play_step(s, &weights[i]);
+        if (cleared[i] < 0) cleared[i] = VERSUS_NO_PIECE;
+    }
+    versus_settle(m, cleared);
+    m->pieces++;
+
+    bool out_0 = m->players[0].is_game_over;
+    bool out_1 = m->players[1].is_game_over;
+    if (out_0 && out_1) m->result = VERSUS_RESULT_DRAW;
+    else if (out_0)     m->result = VERSUS_RESULT_WIN_1;
+    else if (out_1)     m->result = VERSUS_RESULT_WIN_0;
+    return m->result;
+}
+
+// Plays until someone tops out or `max_pieces` each have been placed, which counts as a draw.
+Versus_Result versus_match_play(Versus_Match *m, const Ai_Weights weights[VERSUS_PLAYERS], int max_pieces)
+{
+    while (versus_match_step(m, weights) == VERSUS_RESULT_PLAYING)
+    {
+        if (m->pieces >= max_pieces)
+        {
+            m->result = VERSUS_RESULT_DRAW;
+            break;
+        }
+    }
+    return m->result;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "tetris.h"
+#include "ai.h"
+
+#define VERSUS_PLAYERS 2
+
+// Most garbage rows that enter a board after a single piece; the rest waits.
+#define VERSUS_MAX_GARBAGE_PER_PIECE 8
+
+typedef enum {
+    VERSUS_RESULT_PLAYING,
+    VERSUS_RESULT_WIN_0,
+    VERSUS_RESULT_WIN_1,
+    VERSUS_RESULT_DRAW,
+} Versus_Result;
+
+/*
+ * Two boards fed the same piece sequence. Both players place a piece, then
+ * the step is settled: clears send garbage to the other board, cancelling
+ * anything queued against the sender first, and rows queued before the
+ * step come in for a player whose piece cleared nothing. Each board takes
+ * its holes from its own stream, so the same play needn't mean the same
+ * board.
+ */
+typedef struct {
+    Game_State players[VERSUS_PLAYERS];
+    int pending_garbage[VERSUS_PLAYERS];
+    int garbage_sent[VERSUS_PLAYERS];       // Attack left after cancelling, whether or not it ever lands.
+    int garbage_received[VERSUS_PLAYERS];   // Rows that entered the board.
+    int lines[VERSUS_PLAYERS];
+    uint64_t garbage_rng[VERSUS_PLAYERS];
+    int pieces;
+    Versus_Result result;
+} Versus_Match;
+
+#define VERSUS_NO_PIECE -1  // For versus_settle: the player didn't place a piece this step.
+
+
+// Guideline attack table without combos or spins: single 0, double 1, triple 2, tetris 4.
+static inline int versus_attack_for_lines(int lines)
+{
+    static const int attack[] = {0, 0, 1, 2, 4};
+    if (lines < 0) return 0;
+    return lines < (int)(sizeof(attack) / sizeof(attack[0])) ? attack[lines] : 4;
+}